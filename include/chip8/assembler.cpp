@@ -0,0 +1,562 @@
+#include "assembler.h"
+
+static std::string asm_upper(const std::string &s) {
+    std::string r = s;
+    for (char &c : r)
+        if (c >= 'a' && c <= 'z') c -= 32;
+    return r;
+}
+
+static std::string asm_trim(const std::string &s) {
+    size_t b = 0, e = s.size();
+    while (b < e && (s[b] == ' ' || s[b] == '\t' || s[b] == '\r')) ++b;
+    while (e > b && (s[e - 1] == ' ' || s[e - 1] == '\t' || s[e - 1] == '\r')) --e;
+    return s.substr(b, e - b);
+}
+
+static bool asm_ident_start(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '.'; }
+static bool asm_ident_char(char c) { return asm_ident_start(c) || (c >= '0' && c <= '9'); }
+
+// "a, b ,c" -> {"a", "b", "c"}; an empty string gives no arguments
+static void asm_split_args(const std::string &s, std::vector<std::string> &args) {
+    args.clear();
+    if (asm_trim(s).empty()) return;
+    size_t start = 0;
+    for (size_t i = 0; i <= s.size(); ++i)
+        if (i == s.size() || s[i] == ',') {
+            args.push_back(asm_trim(s.substr(start, i - start)));
+            start = i + 1;
+        }
+}
+
+// whole-word replace of macro parameters, {name} works too for gluing
+static std::string asm_substitute(const std::string &line, const std::vector<std::string> &params,
+                                  const std::vector<std::string> &args, int unique) {
+    std::string out;
+    for (size_t i = 0; i < line.size();) {
+        if (line[i] == '\\' && i + 1 < line.size() && line[i + 1] == '@') {
+            out += std::to_string(unique);
+            i += 2;
+            continue;
+        }
+        bool braced = line[i] == '{';
+        size_t s = i + braced;
+        if (s < line.size() && asm_ident_start(line[s]) && (braced || i == 0 || !asm_ident_char(line[i - 1]))) {
+            size_t e = s;
+            while (e < line.size() && asm_ident_char(line[e])) ++e;
+            std::string word = line.substr(s, e - s);
+            size_t p = 0;
+            while (p < params.size() && params[p] != word) ++p;
+            if (p < params.size() && (!braced || (e < line.size() && line[e] == '}'))) {
+                out += args[p];
+                i = e + braced;
+                continue;
+            }
+            if (!braced) {
+                out += word;
+                i = e;
+                continue;
+            }
+        }
+        out += line[i++];
+    }
+    return out;
+}
+
+Chip8Assembler::Chip8Assembler(Chip8Variant variant) {
+    _initial_variant = _variant = variant;
+    _pc = CHIP8_PC_OFFSET;
+    _pass = 0;
+    _line = 0;
+    _expansions = 0;
+}
+
+void Chip8Assembler::_error(const std::string &message) {
+    if (_pass == 1) return; // the second pass reports everything with the final symbol table
+    _errors.push_back({_line, message});
+}
+
+bool Chip8Assembler::symbol(const std::string &name, int &value) const {
+    auto it = _symbols.find(name);
+    if (it == _symbols.end()) return false;
+    value = it->second;
+    return true;
+}
+
+bool Chip8Assembler::_expand(const std::vector<Line> &src, int depth) {
+    if (depth > ASM_MAX_MACRO_DEPTH) {
+        _error("macros nested too deep");
+        return false;
+    }
+    for (size_t i = 0; i < src.size(); ++i) {
+        _line = src[i].number;
+        std::string text = src[i].text;
+        size_t comment = text.find(';');
+        if (comment != std::string::npos) text.resize(comment);
+        text = asm_trim(text);
+        if (text.empty()) continue;
+
+        size_t label = 0;
+        while (label < text.size() && asm_ident_char(text[label])) ++label;
+        if (label > 0 && label < text.size() && text[label] == ':') { // own line, so a macro can follow
+            _lines.push_back({src[i].number, text.substr(0, label + 1)});
+            text = asm_trim(text.substr(label + 1));
+            if (text.empty()) continue;
+        }
+
+        size_t sp = 0;
+        while (sp < text.size() && text[sp] != ' ' && text[sp] != '\t') ++sp;
+        std::string head = asm_upper(text.substr(0, sp));
+
+        if (head == "MACRO") {
+            std::string rest = asm_trim(text.substr(sp));
+            size_t nsp = 0;
+            while (nsp < rest.size() && rest[nsp] != ' ' && rest[nsp] != '\t') ++nsp;
+            std::string name = rest.substr(0, nsp);
+            if (name.empty() || !asm_ident_start(name[0])) {
+                _error("MACRO needs a name");
+                return false;
+            }
+            Macro m;
+            asm_split_args(rest.substr(nsp), m.params);
+            size_t j = i + 1;
+            for (; j < src.size(); ++j) {
+                std::string t = asm_upper(asm_trim(src[j].text));
+                if (t.compare(0, 4, "ENDM") == 0 && (t.size() == 4 || t[4] == ' ' || t[4] == '\t' || t[4] == ';')) break;
+                m.body.push_back(src[j]);
+            }
+            if (j == src.size()) {
+                _error("MACRO " + name + " without ENDM");
+                return false;
+            }
+            _macros[asm_upper(name)] = std::move(m);
+            i = j;
+            continue;
+        }
+
+        auto it = _macros.find(head);
+        if (it == _macros.end()) {
+            _lines.push_back({src[i].number, text});
+            continue;
+        }
+        std::vector<std::string> args;
+        asm_split_args(text.substr(sp), args);
+        if (args.size() != it->second.params.size()) {
+            _error("macro " + head + " takes " + std::to_string(it->second.params.size()) + " arguments");
+            continue;
+        }
+        std::vector<Line> body = it->second.body; // the macro table may change while expanding
+        std::vector<std::string> params = it->second.params;
+        int unique = _expansions++;
+        for (Line &l : body) {
+            l.text = asm_substitute(l.text, params, args, unique);
+            l.number = src[i].number; // errors point at the use
+        }
+        if (!_expand(body, depth + 1)) return false;
+    }
+    return true;
+}
+
+bool Chip8Assembler::_eval(const std::string &expr, int &value) {
+    value = 0;
+    int sign = 1;
+    bool want_term = true;
+    size_t i = 0;
+    while (i < expr.size()) {
+        char c = expr[i];
+        if (c == ' ' || c == '\t') {
+            ++i;
+            continue;
+        }
+        if (!want_term) {
+            if (c != '+' && c != '-') return false;
+            sign = c == '-' ? -1 : 1;
+            want_term = true;
+            ++i;
+            continue;
+        }
+        if (c == '-') { // unary
+            sign = -sign;
+            ++i;
+            continue;
+        }
+
+        int term = 0;
+        if (c == '$' && (i + 1 == expr.size() || !isxdigit((unsigned char)expr[i + 1]))) {
+            term = _pc;
+            ++i;
+        } else if ((c >= '0' && c <= '9') || c == '$' || c == '%' || c == '#') {
+            int base = 10;
+            if (c == '$' || c == '#') {
+                base = 16;
+                ++i;
+            } else if (c == '%') {
+                base = 2;
+                ++i;
+            } else if (c == '0' && i + 1 < expr.size() && (expr[i + 1] == 'x' || expr[i + 1] == 'X')) {
+                base = 16;
+                i += 2;
+            } else if (c == '0' && i + 1 < expr.size() && (expr[i + 1] == 'b' || expr[i + 1] == 'B')) {
+                base = 2;
+                i += 2;
+            }
+            int digits = 0;
+            for (; i < expr.size(); ++i) {
+                char d = expr[i];
+                int v = d >= '0' && d <= '9' ? d - '0' : d >= 'a' && d <= 'f' ? d - 'a' + 10 : d >= 'A' && d <= 'F' ? d - 'A' + 10 : 99;
+                if (v >= base) break;
+                term = term * base + v;
+                if (term > 0xFFFFFF) return false;
+                ++digits;
+            }
+            if (digits == 0 || (i < expr.size() && asm_ident_char(expr[i]))) return false;
+        } else if (asm_ident_start(c)) {
+            size_t s = i;
+            while (i < expr.size() && asm_ident_char(expr[i])) ++i;
+            std::string name = expr.substr(s, i - s);
+            auto it = _symbols.find(name);
+            if (it != _symbols.end())
+                term = it->second;
+            else if (_pass == 2) {
+                _error("undefined symbol " + name);
+                return false;
+            } // first pass: forward reference, sized the same either way
+        } else
+            return false;
+
+        value += sign * term;
+        sign = 1;
+        want_term = false;
+    }
+    return !want_term;
+}
+
+bool Chip8Assembler::_operand(const std::string &text, Operand &op) {
+    std::string u = asm_upper(text);
+    op.value = 0;
+    if (u.size() == 2 && u[0] == 'V' && isxdigit((unsigned char)u[1])) {
+        op.kind = OP_V;
+        op.value = u[1] <= '9' ? u[1] - '0' : u[1] - 'A' + 10;
+        return true;
+    }
+    static const struct { const char *name; OperandKind kind; } fixed[] = {
+        {"I", OP_I}, {"[I]", OP_I_IND}, {"DT", OP_DT}, {"ST", OP_ST}, {"K", OP_K},
+        {"F", OP_F}, {"HF", OP_HF}, {"B", OP_B}, {"R", OP_R},
+    };
+    for (auto &f : fixed)
+        if (u == f.name) {
+            op.kind = f.kind;
+            return true;
+        }
+    op.kind = OP_VALUE;
+    std::string expr = text;
+    if (u.compare(0, 5, "LONG ") == 0) {
+        op.kind = OP_LONG;
+        expr = text.substr(5);
+    }
+    size_t errors = _errors.size();
+    if (!_eval(expr, op.value)) {
+        if (_errors.size() == errors) _error("bad operand '" + text + "'"); // unless _eval said why
+        return false;
+    }
+    return true;
+}
+
+void Chip8Assembler::_emit(uint16_t word) {
+    if (_pass == 2) {
+        _out.push_back(word >> 8);
+        _out.push_back(word & 0xFF);
+    }
+    _pc += 2;
+}
+
+bool Chip8Assembler::_need(Chip8Variant variant, const char *mnemonic) {
+    if (_variant >= variant) return true;
+    _error(std::string(mnemonic) + (variant == CHIP8_VARIANT_SCHIP ? " needs OPTION SCHIP" : " needs OPTION XOCHIP"));
+    return false;
+}
+
+void Chip8Assembler::_statement(const std::string &mnemonic, std::vector<std::string> &args) {
+    if (mnemonic == "DB" || mnemonic == "DW") {
+        bool word = mnemonic == "DW";
+        for (std::string &a : args) {
+            int v;
+            if (!_eval(a, v)) {
+                _error("bad value '" + a + "'");
+                v = 0;
+            } else if (v < (word ? -0x8000 : -0x80) || v > (word ? 0xFFFF : 0xFF))
+                _error("value '" + a + "' out of range");
+            if (_pass == 2) {
+                if (word) _out.push_back((v >> 8) & 0xFF);
+                _out.push_back(v & 0xFF);
+            }
+            _pc += word ? 2 : 1;
+        }
+        return;
+    }
+    if (mnemonic == "ORG") {
+        int addr;
+        if (args.size() != 1 || !_eval(args[0], addr)) {
+            _error("ORG needs an address");
+            return;
+        }
+        if (addr < _pc || addr > CHIP8_MEMORY_SIZE) {
+            _error("ORG can only move forward, inside memory");
+            return;
+        }
+        if (_pass == 2) _out.resize(_out.size() + addr - _pc, 0);
+        _pc = addr;
+        return;
+    }
+    if (mnemonic == "OPTION") {
+        std::string v = args.size() == 1 ? asm_upper(args[0]) : "";
+        if (v == "CHIP8") _variant = CHIP8_VARIANT_CHIP8;
+        else if (v == "SCHIP") _variant = CHIP8_VARIANT_SCHIP;
+        else if (v == "XOCHIP") _variant = CHIP8_VARIANT_XOCHIP;
+        else _error("OPTION is CHIP8, SCHIP or XOCHIP");
+        return;
+    }
+
+    std::vector<Operand> ops(args.size());
+    for (size_t i = 0; i < args.size(); ++i)
+        if (!_operand(args[i], ops[i])) {
+            _pc += mnemonic == "LD" && asm_upper(args[i]).compare(0, 5, "LONG ") == 0 ? 4 : 2;
+            return;
+        }
+    _instruction(mnemonic, ops);
+}
+
+void Chip8Assembler::_instruction(const std::string &m, const std::vector<Operand> &ops) {
+    size_t n = ops.size();
+    auto is = [&](size_t i, OperandKind k) { return i < n && ops[i].kind == k; };
+    auto x = [&](size_t i) { return ops[i].value << 8; };
+    auto y = [&](size_t i) { return ops[i].value << 4; };
+    auto range = [&](size_t i, int lo, int hi, const char *what) {
+        int v = ops[i].value;
+        if (v < lo || v > hi) _error(std::string(what) + " out of range");
+        return v;
+    };
+    auto byte = [&](size_t i) { return range(i, -0x80, 0xFF, "byte") & 0xFF; };
+    auto addr = [&](size_t i) { return range(i, 0, 0xFFF, "address"); };
+    auto nibble = [&](size_t i) { return range(i, 0, 0xF, "nibble"); };
+    int before = _pc;
+    size_t errors = _errors.size();
+
+    if (n == 0) {
+        if (m == "CLS") _emit(0x00E0);
+        else if (m == "RET") _emit(0x00EE);
+        else if (m == "SCR" && _need(CHIP8_VARIANT_SCHIP, "SCR")) _emit(0x00FB);
+        else if (m == "SCL" && _need(CHIP8_VARIANT_SCHIP, "SCL")) _emit(0x00FC);
+        else if (m == "EXIT" && _need(CHIP8_VARIANT_SCHIP, "EXIT")) _emit(0x00FD);
+        else if (m == "LOW" && _need(CHIP8_VARIANT_SCHIP, "LOW")) _emit(0x00FE);
+        else if (m == "HIGH" && _need(CHIP8_VARIANT_SCHIP, "HIGH")) _emit(0x00FF);
+        else if (m == "AUDIO" && _need(CHIP8_VARIANT_XOCHIP, "AUDIO")) _emit(0xF002);
+    } else if (n == 1) {
+        if (is(0, OP_VALUE)) {
+            if (m == "JP") _emit(0x1000 | addr(0));
+            else if (m == "CALL") _emit(0x2000 | addr(0));
+            else if (m == "SYS") _emit(addr(0));
+            else if (m == "SCD" && _need(CHIP8_VARIANT_SCHIP, "SCD")) _emit(0x00C0 | nibble(0));
+            else if (m == "SCU" && _need(CHIP8_VARIANT_XOCHIP, "SCU")) _emit(0x00D0 | nibble(0));
+            else if (m == "PLANE" && _need(CHIP8_VARIANT_XOCHIP, "PLANE")) _emit(0xF001 | nibble(0) << 8);
+        } else if (is(0, OP_V)) {
+            if (m == "SHR") _emit(0x8006 | x(0));
+            else if (m == "SHL") _emit(0x800E | x(0));
+            else if (m == "SKP") _emit(0xE09E | x(0));
+            else if (m == "SKNP") _emit(0xE0A1 | x(0));
+            else if (m == "PITCH" && _need(CHIP8_VARIANT_XOCHIP, "PITCH")) _emit(0xF03A | x(0));
+        }
+    } else if (n == 2) {
+        if (is(0, OP_V) && is(1, OP_VALUE)) {
+            if (m == "SE") _emit(0x3000 | x(0) | byte(1));
+            else if (m == "SNE") _emit(0x4000 | x(0) | byte(1));
+            else if (m == "LD") _emit(0x6000 | x(0) | byte(1));
+            else if (m == "ADD") _emit(0x7000 | x(0) | byte(1));
+            else if (m == "RND") _emit(0xC000 | x(0) | byte(1));
+            else if (m == "JP" && ops[0].value == 0) _emit(0xB000 | addr(1));
+        } else if (is(0, OP_V) && is(1, OP_V)) {
+            static const char *alu[] = {"LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN"};
+            for (int i = 0; i < 8; ++i)
+                if (m == alu[i]) _emit(0x8000 | x(0) | y(1) | i);
+            if (m == "SHL") _emit(0x800E | x(0) | y(1));
+            else if (m == "SE") _emit(0x5000 | x(0) | y(1));
+            else if (m == "SNE") _emit(0x9000 | x(0) | y(1));
+            else if (m == "SAVE" && _need(CHIP8_VARIANT_XOCHIP, "SAVE")) _emit(0x5002 | x(0) | y(1));
+            else if (m == "LOAD" && _need(CHIP8_VARIANT_XOCHIP, "LOAD")) _emit(0x5003 | x(0) | y(1));
+        } else if (m == "LD" && is(0, OP_I) && is(1, OP_VALUE)) {
+            _emit(0xA000 | addr(1));
+        } else if (m == "LD" && is(0, OP_I) && is(1, OP_LONG)) {
+            if (_need(CHIP8_VARIANT_XOCHIP, "LD I, LONG")) {
+                _emit(0xF000);
+                _emit(range(1, 0, 0xFFFF, "address"));
+            }
+        } else if (m == "LD" && is(0, OP_V)) {
+            if (is(1, OP_DT)) _emit(0xF007 | x(0));
+            else if (is(1, OP_K)) _emit(0xF00A | x(0));
+            else if (is(1, OP_I_IND)) _emit(0xF065 | x(0));
+            else if (is(1, OP_R) && _need(CHIP8_VARIANT_SCHIP, "LD Vx, R")) _emit(0xF085 | x(0));
+        } else if (m == "LD" && is(1, OP_V)) {
+            if (is(0, OP_DT)) _emit(0xF015 | x(1));
+            else if (is(0, OP_ST)) _emit(0xF018 | x(1));
+            else if (is(0, OP_F)) _emit(0xF029 | x(1));
+            else if (is(0, OP_B)) _emit(0xF033 | x(1));
+            else if (is(0, OP_I_IND)) _emit(0xF055 | x(1));
+            else if (is(0, OP_HF) && _need(CHIP8_VARIANT_SCHIP, "LD HF, Vx")) _emit(0xF030 | x(1));
+            else if (is(0, OP_R) && _need(CHIP8_VARIANT_SCHIP, "LD R, Vx")) _emit(0xF075 | x(1));
+        } else if (m == "ADD" && is(0, OP_I) && is(1, OP_V)) {
+            _emit(0xF01E | x(1));
+        }
+    } else if (n == 3 && m == "DRW" && is(0, OP_V) && is(1, OP_V) && is(2, OP_VALUE)) {
+        _emit(0xD000 | x(0) | y(1) | nibble(2)); // n = 0 draws nothing here, a 16x16 sprite on SCHIP
+    }
+
+    if (_pc == before) {
+        if (_errors.size() == errors) _error("unknown instruction or operands for " + m); // unless _need() said why
+        _pc += 2; // keep the layout stable so later labels stay put
+    }
+}
+
+bool Chip8Assembler::assemble(const std::string &source, std::vector<uint8_t> &rom) {
+    _errors.clear();
+    _symbols.clear();
+    _macros.clear();
+    _lines.clear();
+    _out.clear();
+    _expansions = 0;
+    _pass = 0;
+
+    std::vector<Line> src;
+    size_t start = 0;
+    for (int number = 1; start <= source.size(); ++number) {
+        size_t end = source.find('\n', start);
+        if (end == std::string::npos) end = source.size();
+        src.push_back({number, source.substr(start, end - start)});
+        start = end + 1;
+    }
+    _expand(src, 0);
+
+    std::vector<std::string> args;
+    for (_pass = 1; _pass <= 2; ++_pass) {
+        _pc = CHIP8_PC_OFFSET;
+        _variant = _initial_variant;
+        for (const Line &l : _lines) {
+            _line = l.number;
+            std::string text = l.text;
+
+            // label:   or   name EQU value   or   DEFINE name value
+            size_t i = 0;
+            while (i < text.size() && asm_ident_char(text[i])) ++i;
+            if (i > 0 && i < text.size() && text[i] == ':' && asm_ident_start(text[0])) {
+                std::string name = text.substr(0, i);
+                if (_pass == 1 && !_symbols.emplace(name, _pc).second)
+                    _errors.push_back({_line, "duplicate symbol " + name});
+                text = asm_trim(text.substr(i + 1));
+                if (text.empty()) continue;
+            }
+
+            size_t sp = 0;
+            while (sp < text.size() && text[sp] != ' ' && text[sp] != '\t') ++sp;
+            std::string mnemonic = asm_upper(text.substr(0, sp));
+            std::string rest = asm_trim(text.substr(sp));
+
+            std::string define_name, define_value;
+            if (mnemonic == "DEFINE") {
+                size_t nsp = 0;
+                while (nsp < rest.size() && rest[nsp] != ' ' && rest[nsp] != '\t') ++nsp;
+                define_name = rest.substr(0, nsp);
+                define_value = asm_trim(rest.substr(nsp));
+            } else if (asm_upper(rest.substr(0, 4)) == "EQU " || asm_upper(rest) == "EQU") {
+                define_name = text.substr(0, sp);
+                define_value = asm_trim(rest.substr(3));
+            }
+            if (!define_name.empty() || mnemonic == "DEFINE") {
+                int v;
+                if (define_name.empty() || !asm_ident_start(define_name[0]) || !_eval(define_value, v))
+                    _error("bad constant definition");
+                else if (_pass == 1 && !_symbols.emplace(define_name, v).second)
+                    _errors.push_back({_line, "duplicate symbol " + define_name});
+                else
+                    _symbols[define_name] = v; // second pass sees forward references resolved
+                continue;
+            }
+
+            asm_split_args(rest, args);
+            _statement(mnemonic, args);
+            if (_pc > CHIP8_MEMORY_SIZE) {
+                _error("program does not fit in memory");
+                break;
+            }
+        }
+    }
+    _pass = 0;
+    if (!_errors.empty()) {
+        std::stable_sort(_errors.begin(), _errors.end(), [](const AsmError &a, const AsmError &b) { return a.line < b.line; });
+        return false;
+    }
+    rom = _out;
+    return true;
+}
+
+bool Chip8Assembler::assemble_file(const char *path, std::vector<uint8_t> &rom) {
+    FILE *f = fopen(path, "rb");
+    if (f == nullptr) {
+        _errors.assign(1, {0, std::string("could not open ") + path});
+        return false;
+    }
+    std::string source;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        source.append(buf, n);
+    fclose(f);
+    return assemble(source, rom);
+}
+
+void Chip8Assembler::print_errors(std::ostream &out, const char *path) const {
+    for (const AsmError &e : _errors)
+        out << path << ":" << e.line << ": " << e.message << "\n";
+}
+
+void chip8_random_source(uint32_t &seed, int instructions, std::string &out) {
+    auto rnd = [&seed](uint32_t n) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed % n;
+    };
+    static const char *alu[] = {"LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN", "SHL"};
+    static const char *fx[] = {"LD V%X, DT", "LD DT, V%X", "LD ST, V%X", "ADD I, V%X", "LD F, V%X",
+                               "LD B, V%X", "LD [I], V%X", "LD V%X, [I]"};
+    char line[64];
+    out.clear();
+    out.reserve(instructions * 16 + 64);
+    out += "        LD I, data\n";
+    for (int i = 0; i < instructions; ++i) {
+        int x = rnd(16), y = rnd(16);
+        int len = snprintf(line, sizeof(line), "L%d: ", i);
+        char *p = line + len;
+        int left = sizeof(line) - len;
+        switch (rnd(12)) {
+            case 0: snprintf(p, left, "LD V%X, %u", x, rnd(256)); break;
+            case 1: snprintf(p, left, "ADD V%X, 0x%02X", x, rnd(256)); break;
+            case 2: snprintf(p, left, "%s V%X, V%X", alu[rnd(9)], x, y); break;
+            case 3: snprintf(p, left, "%s V%X, %u", rnd(2) ? "SE" : "SNE", x, rnd(256)); break;
+            case 4: snprintf(p, left, "%s V%X, V%X", rnd(2) ? "SE" : "SNE", x, y); break;
+            case 5: snprintf(p, left, "RND V%X, 0x%02X", x, rnd(256)); break;
+            case 6: snprintf(p, left, "DRW V%X, V%X, %u", x, y, 1 + rnd(15)); break;
+            case 7: snprintf(p, left, fx[rnd(8)], x); break;
+            case 8: snprintf(p, left, "LD I, data + %u", rnd(64)); break;
+            case 9: snprintf(p, left, "JP L%u", rnd(instructions)); break;
+            case 10: snprintf(p, left, "%s V%X", rnd(2) ? "SKP" : "SKNP", x); break;
+            default: snprintf(p, left, "CLS"); break;
+        }
+        out += line;
+        out += '\n';
+    }
+    out += "        JP $\ndata:   DB ";
+    for (int i = 0; i < 80; ++i) {
+        snprintf(line, sizeof(line), i ? ", %u" : "%u", rnd(256));
+        out += line;
+    }
+    out += '\n';
+}
@@ -0,0 +1,94 @@
+/* Chip-8 assembler.
+
+   Syntax is what disasm.h prints (Cowgod's mnemonics), one statement per
+   line, ';' starts a comment, case-insensitive except for symbols:
+
+       start:  LD V0, 0x10         ; label, hex
+               ADD V0, 1
+               SNE V0, end - start ; expressions: + - on numbers, symbols, $
+               JP start
+       sprite: DB 0b11110000, %10010000, $F0
+       speed   EQU 4               ; or DEFINE speed 4
+               ORG 0x300           ; pad with zeros up to an address
+
+       MACRO inc reg, by           ; {reg}/reg are replaced, \@ is unique per use
+               ADD reg, by
+       ENDM
+               inc V1, speed
+
+   OPTION SCHIP / OPTION XOCHIP (or the constructor) enables the extended
+   opcodes: SCD, SCR, SCL, EXIT, LOW, HIGH, LD HF/R; XO-CHIP SCU, SAVE/LOAD
+   Vx, Vy, PLANE, AUDIO, PITCH and LD I, LONG addr. Chip8 itself only runs
+   the base set.
+
+   Two passes over the macro-expanded lines; the first sizes statements and
+   places labels, the second encodes. Errors are collected, not thrown.
+*/
+
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "chip8.h"
+
+#define ASM_MAX_MACRO_DEPTH 16
+#define ASM_MAX_ROM (CHIP8_MEMORY_SIZE - CHIP8_PC_OFFSET)
+
+struct AsmError {
+    int line;
+    std::string message;
+};
+
+class Chip8Assembler {
+    struct Line {
+        int number; // in the source, for errors
+        std::string text;
+    };
+    struct Macro {
+        std::vector<std::string> params;
+        std::vector<Line> body;
+    };
+    enum OperandKind { OP_V, OP_I, OP_I_IND, OP_DT, OP_ST, OP_K, OP_F, OP_HF, OP_B, OP_R, OP_LONG, OP_VALUE };
+    struct Operand {
+        OperandKind kind;
+        int value;
+    };
+
+    Chip8Variant _variant, _initial_variant;
+    std::vector<AsmError> _errors;
+    std::unordered_map<std::string, int> _symbols;
+    std::unordered_map<std::string, Macro> _macros;
+    std::vector<Line> _lines;
+    std::vector<uint8_t> _out;
+    int _pc, _pass, _line, _expansions;
+
+    void _error(const std::string &);
+    bool _expand(const std::vector<Line> &src, int depth);
+    bool _eval(const std::string &expr, int &value);
+    bool _operand(const std::string &text, Operand &);
+    void _emit(uint16_t word);
+    void _statement(const std::string &mnemonic, std::vector<std::string> &args);
+    void _instruction(const std::string &mnemonic, const std::vector<Operand> &ops);
+    bool _need(Chip8Variant, const char *mnemonic);
+
+public:
+    Chip8Assembler(Chip8Variant variant = CHIP8_VARIANT_CHIP8);
+
+    bool assemble(const std::string &source, std::vector<uint8_t> &rom); // rom as loaded at CHIP8_PC_OFFSET
+    bool assemble_file(const char *path, std::vector<uint8_t> &rom);
+
+    const std::vector<AsmError> &errors() const { return _errors; }
+    void print_errors(std::ostream &, const char *path) const; // path:line: message
+    bool symbol(const std::string &name, int &value) const;
+};
+
+// Random but valid program text for fuzzing: `instructions` statements with labelled jump targets.
+void chip8_random_source(uint32_t &seed, int instructions, std::string &out);
+
+#include "assembler.cpp"
@@ -0,0 +1,138 @@
+#include "bench.h"
+
+static inline uint64_t bench_tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+#ifdef __linux__
+static int bench_perf_open(uint64_t config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+BenchCounters::BenchCounters() {
+    _branch_fd = _cache_fd = -1;
+#ifdef __linux__
+    _branch_fd = bench_perf_open(PERF_COUNT_HW_BRANCH_MISSES);
+    _cache_fd = bench_perf_open(PERF_COUNT_HW_CACHE_MISSES);
+#endif
+}
+
+BenchCounters::~BenchCounters() {
+#ifdef __linux__
+    if (_branch_fd >= 0) close(_branch_fd);
+    if (_cache_fd >= 0) close(_cache_fd);
+#endif
+}
+
+void BenchCounters::start() {
+#ifdef __linux__
+    for (int fd : {_branch_fd, _cache_fd})
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+}
+
+void BenchCounters::stop(int64_t &branch_misses, int64_t &cache_misses) {
+    branch_misses = cache_misses = -1;
+#ifdef __linux__
+    int fds[2] = {_branch_fd, _cache_fd};
+    int64_t *out[2] = {&branch_misses, &cache_misses};
+    for (int i = 0; i < 2; ++i) {
+        if (fds[i] < 0) continue;
+        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t v;
+        if (read(fds[i], &v, sizeof(v)) == sizeof(v)) *out[i] = v;
+    }
+#endif
+}
+
+BenchResult chip8_bench_run(const char *name, const std::vector<uint8_t> &rom, uint64_t instructions) {
+    BenchResult r;
+    r.name = name;
+    r.instructions = 0;
+    r.seconds = r.mips = r.cycles_per_instruction = 0;
+    r.branch_misses = r.cache_misses = -1;
+    r.ok = false;
+
+    Chip8 chip8;
+    if (!chip8.load_rom(rom.data(), rom.size())) return r;
+    chip8.start_execution();
+    for (int i = 0; i < BENCH_WARMUP_FRAMES; ++i)
+        chip8.run_frame(BENCH_IPF);
+
+    uint64_t frames = (instructions + BENCH_IPF - 1) / BENCH_IPF;
+    BenchCounters counters;
+    Timer t;
+    counters.start();
+    uint64_t tsc = bench_tsc();
+    for (uint64_t f = 0; f < frames; ++f)
+        chip8.run_frame(BENCH_IPF);
+    tsc = bench_tsc() - tsc;
+    counters.stop(r.branch_misses, r.cache_misses);
+    r.seconds = t.getTime();
+
+    r.instructions = frames * BENCH_IPF;
+    r.mips = r.instructions / r.seconds / 1e6;
+    r.cycles_per_instruction = (double)tsc / r.instructions;
+    r.ok = chip8.is_running();
+    return r;
+}
+
+bool chip8_bench_suite(const char *rom_dir, uint64_t instructions, std::vector<BenchResult> &results) {
+    bool ok = true;
+    results.clear();
+    for (const char *name : bench_workloads) {
+        std::string path = std::string(rom_dir) + "/bench_" + name + ".asm";
+        Chip8Assembler as;
+        std::vector<uint8_t> rom;
+        if (!as.assemble_file(path.c_str(), rom)) {
+            as.print_errors(std::cerr, path.c_str());
+            results.push_back({name, 0, 0, 0, 0, -1, -1, false});
+            ok = false;
+            continue;
+        }
+        results.push_back(chip8_bench_run(name, rom, instructions));
+        ok &= results.back().ok;
+    }
+    return ok;
+}
+
+void chip8_bench_json(const std::vector<BenchResult> &results, std::ostream &out) {
+    char buf[256];
+    out << "{\n  \"ipf\": " << BENCH_IPF << ",\n";
+#ifdef __VERSION__
+    out << "  \"compiler\": \"" << __VERSION__ << "\",\n";
+#endif
+    out << "  \"profiling\": " << (chip8_profiling ? "true" : "false")
+        << ",\n  \"tracing\": " << (chip8_tracing ? "true" : "false") << ",\n  \"workloads\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult &r = results[i];
+        snprintf(buf, sizeof(buf),
+                 "    {\"name\": \"%s\", \"ok\": %s, \"instructions\": %llu, \"seconds\": %.6f, \"mips\": %.3f, "
+                 "\"cycles_per_instruction\": %.3f, ",
+                 r.name.c_str(), r.ok ? "true" : "false", (unsigned long long)r.instructions, r.seconds, r.mips,
+                 r.cycles_per_instruction);
+        out << buf;
+        if (r.branch_misses >= 0) out << "\"branch_misses\": " << r.branch_misses << ", ";
+        else out << "\"branch_misses\": null, ";
+        if (r.cache_misses >= 0) out << "\"cache_misses\": " << r.cache_misses;
+        else out << "\"cache_misses\": null";
+        out << (i + 1 < results.size() ? "},\n" : "}\n");
+    }
+    out << "  ]\n}\n";
+}
@@ -0,0 +1,66 @@
+/* Interpreter benchmark suite.
+
+   Each workload is one of the roms/bench_*.asm programs, assembled at
+   start so the suite never runs stale binaries. A workload runs a fixed
+   number of guest instructions (frames of BENCH_IPF after a short warm-up)
+   and reports emulated MIPS, host TSC cycles per guest instruction, and
+   branch and cache misses from perf_event_open when the kernel allows it
+   (-1 otherwise; perf_event_paranoid and containers often say no).
+
+   The JSON goes to stdout so runs can be kept and diffed across commits.
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "chip8.h"
+#include "assembler.h"
+#include "mega_utils/timer.h"
+
+#define BENCH_IPF 10000
+#define BENCH_WARMUP_FRAMES 10
+#define BENCH_DEFAULT_INSTRUCTIONS 50000000ull
+
+// roms/bench_<name>.asm
+static const char *const bench_workloads[] = {"alu", "draw", "call", "memory", "bcd", "selfmod"};
+
+struct BenchResult {
+    std::string name;
+    uint64_t instructions;
+    double seconds;
+    double mips;
+    double cycles_per_instruction; // TSC cycles, 0 without rdtsc
+    int64_t branch_misses;         // -1 if perf counters are unavailable
+    int64_t cache_misses;
+    bool ok;                       // assembled and ran without halting
+};
+
+// Hardware counters for the calling thread, user space only.
+class BenchCounters {
+    int _branch_fd, _cache_fd;
+
+public:
+    BenchCounters();
+    ~BenchCounters();
+    void start();
+    void stop(int64_t &branch_misses, int64_t &cache_misses);
+};
+
+BenchResult chip8_bench_run(const char *name, const std::vector<uint8_t> &rom, uint64_t instructions);
+// Runs every workload from `rom_dir`; false if any failed.
+bool chip8_bench_suite(const char *rom_dir, uint64_t instructions, std::vector<BenchResult> &results);
+void chip8_bench_json(const std::vector<BenchResult> &, std::ostream &);
+
+#include "bench.cpp"
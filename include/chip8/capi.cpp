@@ -0,0 +1,24 @@
+#include "capi.h"
+
+int chip8_capi_version(void) { return CHIP8_CAPI_VERSION; }
+
+Chip8 *chip8_new(void) { return new Chip8; }
+void chip8_free(Chip8 *c) { delete c; }
+
+int chip8_load_rom(Chip8 *c, const uint8_t *data, size_t size) { return c->load_rom(data, size); }
+void chip8_start(Chip8 *c) { c->start_execution(); }
+void chip8_stop(Chip8 *c) { c->stop_execution(); }
+int chip8_is_running(const Chip8 *c) { return c->is_running(); }
+void chip8_set_quirks(Chip8 *c, uint32_t quirks) { c->set_quirks(quirks); }
+void chip8_set_keys(Chip8 *c, uint16_t mask) { c->set_keys(mask); }
+
+uint32_t chip8_run_frame(Chip8 *c, int ipf) { return c->run_frame(ipf); }
+uint32_t chip8_run_until(Chip8 *c, uint32_t event_mask, uint64_t max_cycles, int ipf) { return c->run_until(event_mask, max_cycles, ipf); }
+void chip8_set_event_handler(Chip8 *c, Chip8EventHandler fn, void *user, uint32_t mask) { c->set_event_handler(fn, user, mask); }
+void chip8_set_error_handler(Chip8 *c, Chip8ErrorHandler fn, void *user) { c->set_error_handler(fn, user); }
+
+const uint8_t *chip8_display(const Chip8 *c) { return c->get_display_buffer(); }
+const uint8_t *chip8_memory_page(const Chip8 *c, int page) { return page >= 0 && page < CHIP8_PAGES ? c->get_memory_page(page) : nullptr; }
+const uint8_t *chip8_registers(const Chip8 *c) { return c->get_registers(); }
+uint16_t chip8_pc(const Chip8 *c) { return c->get_pc(); }
+uint16_t chip8_index(const Chip8 *c) { return c->get_index(); }
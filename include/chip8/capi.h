@@ -0,0 +1,67 @@
+/* C ABI for embedding the core in other runtimes (C, FFI from Python, Rust, C#...).
+
+   Unlike the rest of include/chip8 this is a real translation unit: build
+   capi.cpp once into a shared library and use this header from C,
+
+       g++ -std=c++17 -O2 -shared -fPIC -Iinclude include/chip8/capi.cpp -o libchip8.so
+
+   The handle is the Chip8 object itself and the views point into it, so
+   nothing is copied: the display stays valid for the machine's lifetime
+   (its contents change with each frame), a memory page until the next
+   write to it. Events and handlers are the ones in chip8.h.
+*/
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+#include "chip8.h"
+extern "C" {
+#else
+typedef struct Chip8 Chip8;
+
+#define CHIP8_EVENT_FRAME 0x01
+#define CHIP8_EVENT_KEY_WAIT 0x02
+#define CHIP8_EVENT_SOUND_ON 0x04
+#define CHIP8_EVENT_SOUND_OFF 0x08
+#define CHIP8_EVENT_HALT 0x10
+#define CHIP8_EVENT_ERROR 0x20
+#define CHIP8_EVENT_ALL 0x3F
+
+#define CHIP8_DISPLAY_WIDTH 64
+#define CHIP8_DISPLAY_HEIGHT 32
+#define CHIP8_PAGE_SIZE 256
+#define CHIP8_PAGES 16
+
+typedef void (*Chip8EventHandler)(void *user, uint32_t events);
+typedef void (*Chip8ErrorHandler)(void *user, uint16_t pc, const char *message);
+#endif
+
+#define CHIP8_CAPI_VERSION 1
+int chip8_capi_version(void); // CHIP8_CAPI_VERSION the library was built with
+
+Chip8 *chip8_new(void);
+void chip8_free(Chip8 *);
+
+int chip8_load_rom(Chip8 *, const uint8_t *data, size_t size); // 1 = loaded
+void chip8_start(Chip8 *);                                      // from 0x200
+void chip8_stop(Chip8 *);
+int chip8_is_running(const Chip8 *);
+void chip8_set_quirks(Chip8 *, uint32_t quirks);
+void chip8_set_keys(Chip8 *, uint16_t mask);
+
+uint32_t chip8_run_frame(Chip8 *, int ipf);
+uint32_t chip8_run_until(Chip8 *, uint32_t event_mask, uint64_t max_cycles, int ipf);
+void chip8_set_event_handler(Chip8 *, Chip8EventHandler, void *user, uint32_t mask);
+void chip8_set_error_handler(Chip8 *, Chip8ErrorHandler, void *user);
+
+const uint8_t *chip8_display(const Chip8 *);           // 1bpp, 8 pixels per byte, MSB leftmost
+const uint8_t *chip8_memory_page(const Chip8 *, int);   // page 0..CHIP8_PAGES-1, nullptr outside
+const uint8_t *chip8_registers(const Chip8 *);          // V0..VF
+uint16_t chip8_pc(const Chip8 *);
+uint16_t chip8_index(const Chip8 *);
+
+#ifdef __cplusplus
+}
+#endif
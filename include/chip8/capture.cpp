@@ -0,0 +1,136 @@
+#include "capture.h"
+
+FrameCapture::FrameCapture() {
+    _queue = nullptr;
+    _head = _tail = 0;
+    _written = _dropped = 0;
+    _max_depth = 0;
+    _running = false;
+    _file = nullptr;
+    _file_buffer = nullptr;
+    _format = CAPTURE_Y4M;
+    _w = _h = 0;
+    _scale = 1;
+}
+
+FrameCapture::~FrameCapture() {
+    close();
+}
+
+bool FrameCapture::open(const char *path, CaptureFormat format, int w, int h, int scale, int fps) {
+    close();
+    if (w * h / 8 > CAPTURE_MAX_FRAME_BYTES || scale < 1) return false;
+
+    _file = fopen(path, "wb");
+    if (_file == nullptr) {
+        cerr << "FrameCapture::open could not open " << path << "\n";
+        return false;
+    }
+    _file_buffer = new char[CAPTURE_WRITE_BUFFER];
+    setvbuf(_file, _file_buffer, _IOFBF, CAPTURE_WRITE_BUFFER);
+
+    _format = format;
+    _w = w;
+    _h = h;
+    _scale = scale;
+    int out_w = w * scale, out_h = h * scale;
+    if (format == CAPTURE_Y4M) {
+        fprintf(_file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", out_w, out_h, fps);
+        _frame.assign(out_w * out_h + 2 * (out_w / 2) * (out_h / 2), 128); // chroma stays neutral
+    } else {
+        _frame.assign(out_w * out_h * 3, 0);
+    }
+
+    _queue = new Slot[CAPTURE_QUEUE_LEN];
+    _head = _tail = 0;
+    _written = _dropped = 0;
+    _max_depth = 0;
+    _running = true;
+    _writer = std::thread(&FrameCapture::_writer_loop, this);
+    return true;
+}
+
+void FrameCapture::close() {
+    if (_file == nullptr) return;
+    _running = false;
+    if (_writer.joinable()) _writer.join();
+    fclose(_file);
+    _file = nullptr;
+    delete[] _file_buffer;
+    _file_buffer = nullptr;
+    delete[] _queue;
+    _queue = nullptr;
+}
+
+bool FrameCapture::push(const uint8_t *bits) {
+    if (_file == nullptr) return false;
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    uint32_t tail = _tail.load(std::memory_order_acquire);
+    uint32_t depth = head - tail;
+    if (depth >= CAPTURE_QUEUE_LEN) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    memcpy(_queue[head & (CAPTURE_QUEUE_LEN - 1)].bits, bits, _w * _h / 8);
+    _head.store(head + 1, std::memory_order_release);
+
+    if (depth + 1 > _max_depth.load(std::memory_order_relaxed))
+        _max_depth.store(depth + 1, std::memory_order_relaxed);
+    return true;
+}
+
+CaptureStats FrameCapture::stats() const {
+    CaptureStats s;
+    s.frames_written = _written.load(std::memory_order_relaxed);
+    s.frames_dropped = _dropped.load(std::memory_order_relaxed);
+    s.queue_depth = _head.load(std::memory_order_relaxed) - _tail.load(std::memory_order_relaxed);
+    s.max_queue_depth = _max_depth.load(std::memory_order_relaxed);
+    return s;
+}
+
+void FrameCapture::_expand(const uint8_t *bits) {
+    const int out_w = _w * _scale;
+    const int row_bytes = _w / 8;
+    for (int y = 0; y < _h; ++y) {
+        uint8_t *dst = &_frame[0] + (size_t)y * _scale * out_w * (_format == CAPTURE_Y4M ? 1 : 3);
+        uint8_t *row = dst;
+        for (int x = 0; x < _w; ++x) {
+            uint8_t v = (bits[y * row_bytes + (x >> 3)] & (0x80 >> (x & 7))) ? 255 : 0;
+            if (_format == CAPTURE_Y4M) {
+                memset(row, v, _scale);
+                row += _scale;
+            } else {
+                memset(row, v, _scale * 3);
+                row += _scale * 3;
+            }
+        }
+        // repeat the expanded row for vertical scaling
+        size_t row_len = row - dst;
+        for (int s = 1; s < _scale; ++s)
+            memcpy(dst + s * row_len, dst, row_len);
+    }
+}
+
+void FrameCapture::_writer_loop() {
+    for (;;) {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        uint32_t head = _head.load(std::memory_order_acquire);
+        if (tail == head) {
+            if (!_running.load(std::memory_order_acquire)) {
+                // producer may have pushed right before stopping
+                if (_head.load(std::memory_order_acquire) == tail) break;
+                continue;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            continue;
+        }
+
+        _expand(_queue[tail & (CAPTURE_QUEUE_LEN - 1)].bits);
+        _tail.store(tail + 1, std::memory_order_release);
+
+        if (_format == CAPTURE_Y4M) fputs("FRAME\n", _file);
+        fwrite(_frame.data(), 1, _frame.size(), _file);
+        _written.fetch_add(1, std::memory_order_relaxed);
+    }
+    fflush(_file);
+}
@@ -0,0 +1,71 @@
+/* Asynchronous video capture of the Chip-8 display.
+
+   The emulation thread only copies the finished 1bpp framebuffer into a
+   lock-free single-producer/single-consumer ring. A writer thread expands
+   the frames and writes them out as Y4M (mono, 4:2:0) or raw RGB24 with
+   large buffered writes. If the ring is full the frame is dropped instead
+   of stalling the emulator.
+*/
+
+#pragma once
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#define CAPTURE_MAX_FRAME_BYTES (128 * 64 / 8)
+#define CAPTURE_QUEUE_LEN 256 // power of 2
+#define CAPTURE_WRITE_BUFFER (1 << 20)
+
+enum CaptureFormat {
+    CAPTURE_Y4M,
+    CAPTURE_RAW_RGB,
+};
+
+struct CaptureStats {
+    uint64_t frames_written;
+    uint64_t frames_dropped;
+    uint32_t queue_depth;
+    uint32_t max_queue_depth;
+};
+
+class FrameCapture {
+    struct Slot {
+        uint8_t bits[CAPTURE_MAX_FRAME_BYTES];
+    };
+    Slot *_queue;
+    alignas(64) std::atomic<uint32_t> _head; // written by producer
+    alignas(64) std::atomic<uint32_t> _tail; // written by writer thread
+    alignas(64) std::atomic<uint64_t> _written, _dropped;
+    std::atomic<uint32_t> _max_depth;
+
+    std::atomic<bool> _running;
+    std::thread _writer;
+    FILE *_file;
+    char *_file_buffer;
+    CaptureFormat _format;
+    int _w, _h, _scale;
+    std::vector<uint8_t> _frame; // expanded output frame
+
+    void _writer_loop();
+    void _expand(const uint8_t *bits);
+
+public:
+    FrameCapture();
+    ~FrameCapture();
+
+    bool open(const char *path, CaptureFormat format, int w, int h, int scale = 1, int fps = 60);
+    void close(); // drains the queue, joins the writer
+
+    bool push(const uint8_t *bits); // emulation thread; false = frame dropped
+    CaptureStats stats() const;
+    bool is_open() const { return _file != nullptr; }
+};
+
+#include "capture.cpp"
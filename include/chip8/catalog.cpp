@@ -0,0 +1,259 @@
+#include "catalog.h"
+
+// ------------------------ SHA-1 -------------------------
+void chip8_sha1(const uint8_t *data, size_t size, uint8_t out[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    auto rol = [](uint32_t v, int n) { return (v << n) | (v >> (32 - n)); };
+    auto block = [&](const uint8_t *p) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i)
+            w[i] = (uint32_t)p[4 * i] << 24 | p[4 * i + 1] << 16 | p[4 * i + 2] << 8 | p[4 * i + 3];
+        for (int i = 16; i < 80; ++i)
+            w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+            if (i < 20) f = (b & c) | (~b & d), k = 0x5A827999;
+            else if (i < 40) f = b ^ c ^ d, k = 0x6ED9EBA1;
+            else if (i < 60) f = (b & c) | (b & d) | (c & d), k = 0x8F1BBCDC;
+            else f = b ^ c ^ d, k = 0xCA62C1D6;
+            uint32_t t = rol(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rol(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a, h[1] += b, h[2] += c, h[3] += d, h[4] += e;
+    };
+
+    size_t full = size / 64 * 64;
+    for (size_t i = 0; i < full; i += 64)
+        block(data + i);
+
+    uint8_t tail[128] = {};
+    size_t rest = size - full;
+    if (rest > 0) memcpy(tail, data + full, rest);
+    tail[rest] = 0x80;
+    size_t tail_len = rest < 56 ? 64 : 128;
+    uint64_t bits = (uint64_t)size * 8;
+    for (int i = 0; i < 8; ++i)
+        tail[tail_len - 1 - i] = bits >> (8 * i);
+    for (size_t i = 0; i < tail_len; i += 64)
+        block(tail + i);
+
+    for (int i = 0; i < 5; ++i) {
+        out[4 * i] = h[i] >> 24;
+        out[4 * i + 1] = h[i] >> 16;
+        out[4 * i + 2] = h[i] >> 8;
+        out[4 * i + 3] = h[i];
+    }
+}
+
+void chip8_sha1_hex(const uint8_t sha1[20], char out[41]) {
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < 20; ++i) {
+        out[2 * i] = digits[sha1[i] >> 4];
+        out[2 * i + 1] = digits[sha1[i] & 0xF];
+    }
+    out[40] = 0;
+}
+
+static bool catalog_parse_sha1(const char *hex, uint8_t out[20]) {
+    for (int i = 0; i < 40; ++i) {
+        char c = hex[i];
+        int v = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (v < 0) return false;
+        if (i % 2 == 0) out[i / 2] = v << 4;
+        else out[i / 2] |= v;
+    }
+    return hex[40] == ' ' || hex[40] == '\t';
+}
+
+// ------------------------ catalog -------------------------
+RomCatalog::RomCatalog() {
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+bool RomCatalog::load_database(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (f == nullptr) {
+        cerr << "RomCatalog could not open " << path << "\n";
+        return false;
+    }
+    char line[512], sha1[64], variant[32], quirks[256];
+    int number = 0;
+    while (fgets(line, sizeof(line), f) != nullptr) {
+        ++number;
+        if (line[0] == '#' || line[0] == '\n') continue;
+        int title_at = 0;
+        RomProfile p;
+        if (sscanf(line, "%63s %31s %255s %n", sha1, variant, quirks, &title_at) < 3 || strlen(sha1) != 40 ||
+            !chip8_parse_quirks(quirks, p.quirks)) {
+            cerr << path << ":" << number << ": bad profile line\n";
+            continue;
+        }
+        if (strcmp(variant, "schip") == 0) p.variant = CHIP8_VARIANT_SCHIP;
+        else if (strcmp(variant, "xochip") == 0) p.variant = CHIP8_VARIANT_XOCHIP;
+        else p.variant = CHIP8_VARIANT_CHIP8;
+        p.title = line + title_at;
+        while (!p.title.empty() && (p.title.back() == '\n' || p.title.back() == '\r')) p.title.pop_back();
+        for (char *c = sha1; *c; ++c)
+            if (*c >= 'A' && *c <= 'F') *c += 32;
+        _database[sha1] = p;
+    }
+    fclose(f);
+    return true;
+}
+
+bool RomCatalog::load_index(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (f == nullptr) return false; // first run
+    char line[4096];
+    if (fgets(line, sizeof(line), f) == nullptr || strncmp(line, CATALOG_INDEX_MAGIC, 8) != 0) {
+        fclose(f);
+        return false;
+    }
+    while (fgets(line, sizeof(line), f) != nullptr) {
+        IndexRecord r;
+        unsigned long long size;
+        long long mtime;
+        int at = 0;
+        if (sscanf(line, "%llu %lld %n", &size, &mtime, &at) < 2 || at == 0 || !catalog_parse_sha1(line + at, r.sha1))
+            continue;
+        r.size = size;
+        r.mtime_ns = mtime;
+        std::string p = line + at + 41;
+        if (!p.empty() && p.back() == '\n') p.pop_back();
+        _index[p] = r;
+    }
+    fclose(f);
+    return true;
+}
+
+bool RomCatalog::save_index(const char *path) const {
+    std::string tmp = std::string(path) + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "w");
+    if (f == nullptr) {
+        cerr << "RomCatalog could not write " << tmp << "\n";
+        return false;
+    }
+    fputs(CATALOG_INDEX_MAGIC "\n", f);
+    char hex[41];
+    for (const RomEntry &e : _entries) {
+        chip8_sha1_hex(e.sha1, hex);
+        fprintf(f, "%llu %lld %s %s\n", (unsigned long long)e.size, (long long)e.mtime_ns, hex, e.path.c_str());
+    }
+    bool ok = fclose(f) == 0;
+    return ok && rename(tmp.c_str(), path) == 0;
+}
+
+void RomCatalog::_add(const std::string &path, const struct stat &st) {
+    RomEntry e;
+    e.path = path;
+    e.size = st.st_size;
+    e.mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+
+    auto cached = _index.find(path);
+    if (cached != _index.end() && cached->second.size == e.size && cached->second.mtime_ns == e.mtime_ns) {
+        memcpy(e.sha1, cached->second.sha1, 20);
+        ++_stats.cached;
+    } else {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        const uint8_t *data = nullptr;
+        if (e.size > 0) {
+            void *m = mmap(nullptr, e.size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m == MAP_FAILED) {
+                close(fd);
+                return;
+            }
+            data = (const uint8_t *)m;
+        }
+        chip8_sha1(data, e.size, e.sha1);
+        if (data != nullptr) munmap((void *)data, e.size);
+        close(fd);
+        ++_stats.hashed;
+        _stats.bytes_hashed += e.size;
+    }
+
+    char hex[41];
+    chip8_sha1_hex(e.sha1, hex);
+    auto profile = _database.find(hex);
+    e.known = profile != _database.end();
+    if (e.known) e.profile = profile->second;
+    else e.profile = {CHIP8_VARIANT_CHIP8, 0, ""};
+
+    auto existing = _by_path.find(path);
+    if (existing != _by_path.end()) {
+        _entries[existing->second] = std::move(e);
+        return;
+    }
+    _by_path[path] = _entries.size();
+    _entries.push_back(std::move(e));
+    ++_stats.files;
+}
+
+void RomCatalog::_scan_dir(const std::string &dir, int depth) {
+    if (depth > 16) return; // symlink loops
+    DIR *d = opendir(dir.c_str());
+    if (d == nullptr) return;
+    int dfd = dirfd(d);
+    dirent *de;
+    while ((de = readdir(d)) != nullptr) {
+        const char *name = de->d_name;
+        if (name[0] == '.') continue;
+        struct stat st;
+        if (fstatat(dfd, name, &st, 0) != 0) continue;
+        std::string path = dir + "/" + name;
+        if (S_ISDIR(st.st_mode)) {
+            _scan_dir(path, depth + 1);
+            continue;
+        }
+        if (!S_ISREG(st.st_mode) || st.st_size > CATALOG_MAX_ROM_SIZE) continue;
+        const char *ext = strrchr(name, '.');
+        if (ext == nullptr || (strcasecmp(ext, ".ch8") != 0 && strcasecmp(ext, ".c8") != 0 &&
+                               strcasecmp(ext, ".sc8") != 0 && strcasecmp(ext, ".xo8") != 0))
+            continue;
+        _add(path, st);
+    }
+    closedir(d);
+}
+
+void RomCatalog::scan(const char *dir) {
+    Timer t;
+    _scan_dir(dir, 0);
+    _stats.seconds = t.getTime();
+}
+
+const RomEntry *RomCatalog::find(const std::string &path) const {
+    auto it = _by_path.find(path);
+    return it == _by_path.end() ? nullptr : &_entries[it->second];
+}
+
+bool RomCatalog::load(const RomEntry &e, Chip8 &chip8) const {
+    int fd = open(e.path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << "RomCatalog could not open " << e.path << "\n";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return chip8.load_rom(nullptr, 0);
+    }
+    if (st.st_size > CHIP8_MEMORY_SIZE - CHIP8_PC_OFFSET) {
+        close(fd);
+        return chip8.load_rom(nullptr, st.st_size); // reports it
+    }
+    void *m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) return false;
+    bool ok = chip8.load_rom((const uint8_t *)m, st.st_size);
+    munmap(m, st.st_size);
+    return ok;
+}
@@ -0,0 +1,101 @@
+/* ROM library catalog (POSIX).
+
+   scan() walks a folder tree for ROM files (.ch8 .c8 .sc8 .xo8), stats each
+   one and looks it up in the index by path: a matching size and mtime reuse
+   the stored SHA-1, anything else is mmapped and hashed. The SHA-1 then keys
+   the profile database, a text file of
+
+       <sha1 hex>  <chip8|schip|xochip>  <quirk,quirk,...|->  <title>
+
+   with quirks as chip8_parse_quirks() reads them (quirks.h). SHA-1 because
+   that is what published ROM lists key on. The index is a text file too,
+   written to a temporary name and renamed:
+
+       C8INDEX1
+       <size> <mtime ns> <sha1 hex> <path>
+
+   load() maps the file and copies it straight into the Chip8's memory.
+   XO-CHIP ROMs (up to CATALOG_MAX_ROM_SIZE) are listed and can have a
+   profile, but this interpreter cannot load them.
+*/
+
+#pragma once
+#ifdef __linux__
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "chip8.h"
+#include "quirks.h"
+#include "mega_utils/timer.h"
+
+#define CATALOG_INDEX_MAGIC "C8INDEX1"
+#define CATALOG_MAX_ROM_SIZE (0x10000 - CHIP8_PC_OFFSET) // XO-CHIP's 64 KB address space; bigger files are not ROMs
+
+struct RomProfile {
+    Chip8Variant variant;
+    uint32_t quirks; // CHIP8_QUIRK_*
+    std::string title;
+};
+
+struct RomEntry {
+    std::string path;
+    uint64_t size;
+    int64_t mtime_ns;
+    uint8_t sha1[20];
+    bool known; // found in the profile database
+    RomProfile profile;
+};
+
+struct CatalogStats {
+    uint64_t files;
+    uint64_t hashed; // not in the index, or changed since
+    uint64_t cached;
+    uint64_t bytes_hashed;
+    double seconds; // last scan()
+};
+
+void chip8_sha1(const uint8_t *data, size_t size, uint8_t out[20]);
+void chip8_sha1_hex(const uint8_t sha1[20], char out[41]);
+
+class RomCatalog {
+    struct IndexRecord {
+        uint64_t size;
+        int64_t mtime_ns;
+        uint8_t sha1[20];
+    };
+
+    std::vector<RomEntry> _entries;
+    std::unordered_map<std::string, size_t> _by_path;       // into _entries
+    std::unordered_map<std::string, IndexRecord> _index;    // from the index file
+    std::unordered_map<std::string, RomProfile> _database;  // by sha1 hex
+    CatalogStats _stats;
+
+    void _scan_dir(const std::string &dir, int depth);
+    void _add(const std::string &path, const struct stat &);
+
+public:
+    RomCatalog();
+
+    bool load_database(const char *path);
+    bool load_index(const char *path);
+    bool save_index(const char *path) const;
+
+    void scan(const char *dir); // adds to what is already catalogued
+    const std::vector<RomEntry> &entries() const { return _entries; }
+    const RomEntry *find(const std::string &path) const;
+    CatalogStats stats() const { return _stats; }
+
+    bool load(const RomEntry &, Chip8 &) const;
+};
+
+#include "catalog.cpp"
+#endif // __linux__
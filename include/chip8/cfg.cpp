@@ -0,0 +1,234 @@
+#include "cfg.h"
+
+Chip8CFG::Chip8CFG() {
+    memset(_memory, 0, sizeof(_memory));
+    memset(_map, 0, sizeof(_map));
+    memset(_leader, 0, sizeof(_leader));
+    memset(_function, 0, sizeof(_function));
+    _rom_end = CHIP8_PC_OFFSET;
+    _unresolved = 0;
+}
+
+void Chip8CFG::analyze(const uint8_t *rom, size_t size) {
+    if (size > CHIP8_MEMORY_SIZE - CHIP8_PC_OFFSET) size = CHIP8_MEMORY_SIZE - CHIP8_PC_OFFSET;
+    memset(_memory, 0, sizeof(_memory));
+    memcpy(_memory + CHIP8_PC_OFFSET, rom, size);
+    memset(_map, 0, sizeof(_map));
+    memset(_leader, 0, sizeof(_leader));
+    memset(_function, 0, sizeof(_function));
+    _rom_end = CHIP8_PC_OFFSET + size;
+    _blocks.clear();
+    _tables.clear();
+    _unresolved = 0;
+
+    _discover();
+    for (int a = 0; a < CHIP8_MEMORY_SIZE; ++a) // code wins over data seen through I
+        if (_map[a] & (CFG_CODE | CFG_OPERAND)) _map[a] &= CFG_CODE | CFG_OPERAND;
+    _build_blocks();
+}
+
+void Chip8CFG::_mark_data(uint16_t addr, int len) {
+    for (int i = 0; i < len; ++i)
+        _map[(addr + i) & 0x0FFF] |= CFG_DATA;
+}
+
+int Chip8CFG::_table(uint16_t base, uint16_t *targets) const {
+    int n = 0;
+    while (n < CFG_MAX_TABLE) {
+        uint16_t addr = (base + 2 * n) & 0x0FFF;
+        if (addr < CHIP8_PC_OFFSET || addr + 1 >= _rom_end || (_opcode(addr) >> 12) != 0x1) break;
+        targets[n++] = addr;
+    }
+    return n;
+}
+
+void Chip8CFG::_discover() {
+    uint16_t work[CHIP8_MEMORY_SIZE + CFG_MAX_TABLE];
+    int pending = 0;
+    auto push = [&](uint16_t addr) {
+        addr &= 0x0FFF;
+        _leader[addr] = true;
+        if (_map[addr] != CFG_CODE && pending < CHIP8_MEMORY_SIZE) work[pending++] = addr;
+    };
+    push(CHIP8_PC_OFFSET);
+
+    while (pending > 0) {
+        uint16_t addr = work[--pending];
+        int I = -1, V0 = -1; // constants along this path, -1 = unknown
+        for (;;) {
+            if (addr >= CHIP8_MEMORY_SIZE - 1 || _map[addr] == CFG_CODE) break;
+            if (_leader[addr]) I = V0 = -1; // other paths join here
+            uint16_t op = _opcode(addr);
+            if (!chip8_is_valid(op)) break;
+            _map[addr] = CFG_CODE;
+            _map[addr + 1] = CFG_OPERAND;
+
+            int x = (op >> 8) & 0xF, n = op & 0xF, nn = op & 0xFF, nnn = op & 0xFFF;
+            bool ends = false;
+            switch (op >> 12) {
+                case 0x0:
+                    ends = op == 0x00EE;
+                    break;
+                case 0x1:
+                    push(nnn);
+                    ends = true;
+                    break;
+                case 0x2:
+                    _function[nnn] = true;
+                    push(nnn);
+                    push(addr + 2);
+                    ends = true;
+                    break;
+                case 0x3: case 0x4: case 0x5: case 0x9: case 0xE:
+                    push(addr + 2);
+                    push(addr + 4);
+                    ends = true;
+                    break;
+                case 0x6:
+                    if (x == 0) V0 = nn;
+                    break;
+                case 0x7:
+                    if (x == 0 && V0 >= 0) V0 = (V0 + nn) & 0xFF;
+                    break;
+                case 0x8: case 0xC:
+                    if (x == 0) V0 = -1;
+                    break;
+                case 0xA:
+                    I = nnn;
+                    break;
+                case 0xB: {
+                    std::vector<uint16_t> targets;
+                    if (V0 >= 0) {
+                        targets.push_back((nnn + V0) & 0x0FFF);
+                    } else {
+                        uint16_t table[CFG_MAX_TABLE];
+                        int count = _table(nnn, table);
+                        targets.assign(table, table + count);
+                    }
+                    if (targets.empty()) ++_unresolved;
+                    for (uint16_t t : targets) push(t);
+                    _tables.push_back({addr, targets});
+                    ends = true;
+                    break;
+                }
+                case 0xD:
+                    if (I >= 0) _mark_data(I, n);
+                    break;
+                case 0xF:
+                    switch (nn) {
+                        case 0x1E: case 0x29: I = -1; break;
+                        case 0x33: if (I >= 0) _mark_data(I, 3); break;
+                        case 0x55: if (I >= 0) _mark_data(I, x + 1); break;
+                        case 0x65:
+                            if (I >= 0) _mark_data(I, x + 1);
+                            V0 = -1;
+                            break;
+                        case 0x07: case 0x0A:
+                            if (x == 0) V0 = -1;
+                            break;
+                    }
+                    break;
+            }
+            if (ends) break;
+            addr += 2;
+        }
+    }
+}
+
+void Chip8CFG::_build_blocks() {
+    for (int a = 0; a < CHIP8_MEMORY_SIZE; ++a) {
+        if (_map[a] != CFG_CODE) continue;
+        CfgBlock b;
+        b.start = a;
+        for (;;) {
+            uint16_t op = _opcode(a);
+            int next = a + 2;
+            int type = op >> 12;
+            if (op == 0x00EE) {
+                b.exit = CFG_RETURN;
+            } else if (type == 0x1) {
+                b.exit = CFG_JUMP;
+                b.succ = {(uint16_t)(op & 0x0FFF)};
+            } else if (type == 0x2) {
+                b.exit = CFG_CALL;
+                b.succ = {(uint16_t)(op & 0x0FFF), (uint16_t)next};
+            } else if (type == 0x3 || type == 0x4 || type == 0x5 || type == 0x9 || type == 0xE) {
+                b.exit = CFG_SKIP;
+                b.succ = {(uint16_t)next, (uint16_t)(next + 2)};
+            } else if (type == 0xB) {
+                b.exit = CFG_UNRESOLVED;
+                for (const auto &t : _tables)
+                    if (t.first == a && !t.second.empty()) {
+                        b.exit = CFG_TABLE;
+                        b.succ = t.second;
+                    }
+            } else if (next >= CHIP8_MEMORY_SIZE || _map[next] != CFG_CODE) {
+                b.exit = CFG_HALT;
+            } else if (_leader[next]) {
+                b.exit = CFG_FALLTHROUGH;
+                b.succ = {(uint16_t)next};
+            } else {
+                a = next;
+                continue;
+            }
+            b.end = next;
+            break;
+        }
+        _blocks.push_back(b);
+        a = b.end - 1;
+    }
+}
+
+void Chip8CFG::write_listing(ostream &out) const {
+    char line[96], text[32];
+    for (int a = CHIP8_PC_OFFSET; a < _rom_end;) {
+        if (_map[a] == CFG_CODE) {
+            uint16_t op = _opcode(a);
+            chip8_disassemble(op, text, sizeof(text));
+            if (_function[a]) out << "\nsub_" << hex << a << dec << ":\n";
+            snprintf(line, sizeof(line), "0x%03X%c %04X  %s\n", a, _leader[a] ? '>' : ' ', op, text);
+            out << line;
+            a += 2;
+            continue;
+        }
+        // up to 8 bytes of the same kind per line
+        uint8_t kind = _map[a];
+        int n = snprintf(line, sizeof(line), "0x%03X  DB", a);
+        int count = 0;
+        while (a < _rom_end && count < 8 && _map[a] == kind) {
+            n += snprintf(line + n, sizeof(line) - n, "%s0x%02X", count ? ", " : " ", _memory[a]);
+            ++a;
+            ++count;
+        }
+        out << line << (kind == CFG_DATA ? "  ; data\n" : kind == CFG_OPERAND ? "  ; inside an instruction\n" : "  ; unreached\n");
+    }
+}
+
+void Chip8CFG::write_dot(ostream &out) const {
+    char text[32], buf[64];
+    out << "digraph chip8 {\n    node [shape=box, fontname=\"monospace\"];\n";
+    for (const CfgBlock &b : _blocks) {
+        snprintf(buf, sizeof(buf), "    b%03X [label=\"", b.start);
+        out << buf;
+        if (_function[b.start]) {
+            snprintf(buf, sizeof(buf), "sub_%03X:\\l", b.start);
+            out << buf;
+        }
+        for (int a = b.start; a < b.end; a += 2) {
+            chip8_disassemble(_opcode(a), text, sizeof(text));
+            snprintf(buf, sizeof(buf), "%03X  %s\\l", a, text);
+            out << buf;
+        }
+        out << "\"" << (b.exit == CFG_UNRESOLVED ? ", color=red" : "") << "];\n";
+
+        for (size_t i = 0; i < b.succ.size(); ++i) {
+            const char *style = "";
+            if (b.exit == CFG_CALL) style = i == 0 ? " [label=\"call\"]" : " [style=dashed, label=\"return\"]";
+            else if (b.exit == CFG_SKIP) style = i == 0 ? "" : " [label=\"skip\"]";
+            else if (b.exit == CFG_TABLE) style = " [style=dotted]";
+            snprintf(buf, sizeof(buf), "    b%03X -> b%03X%s;\n", b.start, b.succ[i], style);
+            out << buf;
+        }
+    }
+    out << "}\n";
+}
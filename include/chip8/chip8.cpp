@@ -1,23 +1,368 @@
 #include "chip8.h"
 
+static const uint8_t chip8_font[16 * 5] = {
+    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+    0x20, 0x60, 0x20, 0x20, 0x70, // 1
+    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+    0xF0, 0x80, 0xF0, 0x80, 0x80, // F
+};
+
+// ------------------------ memory -------------------------
+atomic<int64_t> Chip8Memory::live_pages(0);
+
+Chip8Page *Chip8Memory::_alloc() {
+    Chip8Page *p = new Chip8Page;
+    p->refs.store(1, memory_order_relaxed);
+    live_pages.fetch_add(1, memory_order_relaxed);
+    return p;
+}
+
+void Chip8Memory::_release(Chip8Page *p) {
+    if (p->refs.fetch_sub(1, memory_order_acq_rel) == 1) {
+        delete p;
+        live_pages.fetch_sub(1, memory_order_relaxed);
+    }
+}
+
+Chip8Page *Chip8Memory::_own(int page, bool keep_data) {
+    Chip8Page *old = _pages[page];
+    Chip8Page *p = _alloc();
+    if (keep_data) memcpy(p->data, old->data, CHIP8_PAGE_SIZE);
+    _release(old);
+    _pages[page] = p;
+    return p;
+}
+
+Chip8Memory::Chip8Memory() {
+    _hash = 0;
+    for (int i = 0; i < CHIP8_PAGES; ++i) {
+        _pages[i] = _alloc();
+        memset(_pages[i]->data, 0, CHIP8_PAGE_SIZE);
+    }
+}
+
+Chip8Memory::Chip8Memory(const Chip8Memory &o) {
+    _hash = o._hash;
+    for (int i = 0; i < CHIP8_PAGES; ++i) {
+        _pages[i] = o._pages[i];
+        _pages[i]->refs.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+Chip8Memory &Chip8Memory::operator=(const Chip8Memory &o) {
+    for (int i = 0; i < CHIP8_PAGES; ++i) {
+        o._pages[i]->refs.fetch_add(1, memory_order_relaxed); // before release: self-assignment safe
+        _release(_pages[i]);
+        _pages[i] = o._pages[i];
+    }
+    _hash = o._hash;
+    return *this;
+}
+
+Chip8Memory::~Chip8Memory() {
+    for (int i = 0; i < CHIP8_PAGES; ++i)
+        _release(_pages[i]);
+}
+
+void Chip8Memory::write_block(uint16_t addr, const uint8_t *src, size_t n) {
+    while (n > 0) {
+        addr &= CHIP8_MEMORY_SIZE - 1;
+        int page = addr / CHIP8_PAGE_SIZE, off = addr % CHIP8_PAGE_SIZE;
+        size_t chunk = CHIP8_PAGE_SIZE - off;
+        if (chunk > n) chunk = n;
+
+        Chip8Page *p = _pages[page], *shared = nullptr;
+        if (p->refs.load(memory_order_acquire) > 1) {
+            shared = p;
+            shared->refs.fetch_add(1, memory_order_relaxed); // the hash needs its old bytes after _own lets go of it
+            p = _own(page, chunk != CHIP8_PAGE_SIZE);        // whole page overwritten: no copy
+        }
+        const uint8_t *old = (shared != nullptr ? shared : p)->data + off;
+        for (size_t i = 0; i < chunk; ++i) {
+            uint8_t value = src != nullptr ? src[i] : 0;
+            if (old[i] != value) _hash ^= chip8_zobrist(CHIP8_HASH_MEMORY + addr + i, old[i]) ^ chip8_zobrist(CHIP8_HASH_MEMORY + addr + i, value);
+            p->data[off + i] = value;
+        }
+        if (shared != nullptr) _release(shared);
+        if (src != nullptr) src += chunk;
+        addr += chunk;
+        n -= chunk;
+    }
+}
+
+void Chip8Memory::read_block(uint16_t addr, uint8_t *dst, size_t n) const {
+    while (n > 0) {
+        addr &= CHIP8_MEMORY_SIZE - 1;
+        int page = addr / CHIP8_PAGE_SIZE, off = addr % CHIP8_PAGE_SIZE;
+        size_t chunk = CHIP8_PAGE_SIZE - off;
+        if (chunk > n) chunk = n;
+        memcpy(dst, _pages[page]->data + off, chunk);
+        dst += chunk;
+        addr += chunk;
+        n -= chunk;
+    }
+}
+
+uint64_t Chip8Memory::full_hash() const {
+    uint64_t h = 0;
+    for (int a = 0; a < CHIP8_MEMORY_SIZE; ++a)
+        h ^= chip8_zobrist(CHIP8_HASH_MEMORY + a, (*this)[a]);
+    return h;
+}
+
+// ------------------------ machine -------------------------
 Chip8::Chip8() {
-    memset(_memory, 0, CHIP8_MEMORY_SIZE);
+    _memory.write_block(CHIP8_FONT_OFFSET, chip8_font, sizeof(chip8_font));
+    memset(_stack, 0, sizeof(_stack));
+    _stack_pointer = 0;
     memset(_display_buffer, 0, CHIP8_DISPLAY_BUFFER_SIZE);
     memset(_V, 0, 16);
+    _PC = CHIP8_PC_OFFSET;
     _I = 0;
+    _keys = 0;
 
-    _timer.interval();
+    _DT = _ST = 0;
+    _rng = 0x2545F491;
+    _running = _waiting_key = false;
+    _hash = 0;
+    _profile = nullptr;
+    _trace = nullptr;
+    _trace_reg = 0xFF;
+    _trace_value = 0;
+    _quirks = 0;
+    _error = false;
+    _cycles = 0;
+    _on_event = nullptr;
+    _event_user = nullptr;
+    _event_mask = CHIP8_EVENT_ALL;
+    _on_error = nullptr;
+    _error_user = nullptr;
+}
 
-    _DT = _ST = 0.;
+Chip8 Chip8::fork() const {
+    Chip8 c(*this);
+    c._on_event = nullptr; // a fork's frames are not the host's
+    c._on_error = nullptr;
+    c._trace = nullptr;    // the ring has one producer, the traced machine
+    c._profile = nullptr;  // plain counters, and a branch's time is not the host's
+    return c;
+}
+
+void Chip8::restore(const Chip8 &from) {
+    if (&from == this) return;
+    Chip8Profile *profile = _profile;
+    Chip8TraceRing *trace = _trace;
+    uint32_t quirks = _quirks, event_mask = _event_mask;
+    uint64_t cycles = _cycles;
+    Chip8EventHandler on_event = _on_event;
+    Chip8ErrorHandler on_error = _on_error;
+    void *event_user = _event_user, *error_user = _error_user;
+    *this = from;
+    _profile = profile;
+    _trace = trace;
+    _quirks = quirks;
+    _cycles = cycles;
+    set_event_handler(on_event, event_user, event_mask);
+    set_error_handler(on_error, error_user);
 }
 
 void Chip8::stop_execution() {
-    // TODO
+    _running = false;
 }
 
 void Chip8::start_execution() {
-    _PC = 0;
-    // TODO
+    _PC = CHIP8_PC_OFFSET;
+    _stack_pointer = 0;
+    _waiting_key = false;
+    _error = false;
+    _running = true;
+}
+
+bool Chip8::load_rom(const uint8_t *data, size_t size) {
+    if (size > CHIP8_MEMORY_SIZE - CHIP8_PC_OFFSET) {
+        _throw("ROM too big!");
+        return false;
+    }
+    _memory.write_block(CHIP8_PC_OFFSET, data, size);
+    _memory.write_block(CHIP8_PC_OFFSET + size, nullptr, CHIP8_MEMORY_SIZE - CHIP8_PC_OFFSET - size);
+#ifdef CHIP8_HASH_CHECK
+    if (state_hash() != full_state_hash()) _throw("State hash out of sync after load_rom!");
+#endif
+    return true;
+}
+
+bool Chip8::load_rom(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == nullptr) {
+        cerr << "Chip8::load_rom could not open " << path << "\n";
+        return false;
+    }
+    uint8_t buf[CHIP8_MEMORY_SIZE];
+    size_t size = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    return load_rom(buf, size);
+}
+
+template <class Debugger, uint32_t Quirks>
+void Chip8::_run_frame_as(int ipf, Debugger *debugger) {
+    constexpr bool debug = !is_void<Debugger>::value;
+    int i = 0;
+    if constexpr (debug) i = debugger->_frame_pos;
+    for (; i < ipf && _running; ++i) {
+        uint16_t opcode = (_memory[_PC] << 8) | _memory[_PC + 1];
+        if constexpr (debug) {
+            if (debugger->_before(opcode)) { // paused before this instruction
+                debugger->_frame_pos = i;
+                return;
+            }
+        }
+        if constexpr (chip8_profiling) {
+            if (_profile != nullptr) {
+                ++_profile->pc[_PC & (CHIP8_MEMORY_SIZE - 1)];
+                ++_profile->op_class[opcode >> 12];
+                ++_profile->total;
+            }
+        }
+        uint16_t pc = _PC;
+        if constexpr (chip8_tracing) _trace_reg = 0xFF;
+        _processOpCode<Quirks>(opcode);
+        if constexpr (chip8_tracing) {
+            if (_trace != nullptr) _trace->push({pc, opcode, _I, _trace_reg, _trace_reg == 0xFF ? (uint8_t)0 : _trace_value});
+        }
+        if constexpr (debug) {
+            if (debugger->_after(pc, opcode)) { // paused after it; a key wait still ends the frame
+                debugger->_frame_pos = _waiting_key ? ipf : i + 1;
+                return;
+            }
+        }
+        if (_waiting_key) break; // FX0A retries next frame
+    }
+    if constexpr (debug) debugger->_frame_pos = 0;
+    else _cycles += i;
+    if (_DT > 0) --_DT;
+    if (_ST > 0) --_ST;
+#ifdef CHIP8_HASH_CHECK
+    if (state_hash() != full_state_hash()) _throw("State hash out of sync!");
+#endif
+}
+
+template <class Debugger>
+void Chip8::_run_frame(int ipf, Debugger *debugger) {
+    typedef void (Chip8::*Loop)(int, Debugger *);
+    static constexpr Loop loops[CHIP8_QUIRK_ALL + 1] = {
+        &Chip8::_run_frame_as<Debugger, 0x0>, &Chip8::_run_frame_as<Debugger, 0x1>, &Chip8::_run_frame_as<Debugger, 0x2>, &Chip8::_run_frame_as<Debugger, 0x3>,
+        &Chip8::_run_frame_as<Debugger, 0x4>, &Chip8::_run_frame_as<Debugger, 0x5>, &Chip8::_run_frame_as<Debugger, 0x6>, &Chip8::_run_frame_as<Debugger, 0x7>,
+        &Chip8::_run_frame_as<Debugger, 0x8>, &Chip8::_run_frame_as<Debugger, 0x9>, &Chip8::_run_frame_as<Debugger, 0xA>, &Chip8::_run_frame_as<Debugger, 0xB>,
+        &Chip8::_run_frame_as<Debugger, 0xC>, &Chip8::_run_frame_as<Debugger, 0xD>, &Chip8::_run_frame_as<Debugger, 0xE>, &Chip8::_run_frame_as<Debugger, 0xF>,
+    };
+    (this->*loops[_quirks])(ipf, debugger);
+}
+
+uint32_t Chip8::run_frame(int ipf) {
+    bool sound = _ST > 0, running = _running;
+    _run_frame<void>(ipf, nullptr);
+
+    uint32_t events = CHIP8_EVENT_FRAME;
+    if ((_ST > 0) != sound) events |= sound ? CHIP8_EVENT_SOUND_OFF : CHIP8_EVENT_SOUND_ON;
+    if (running && !_running) events |= CHIP8_EVENT_HALT;
+    if (_error) {
+        events |= CHIP8_EVENT_ERROR;
+        _error = false;
+    }
+    if (_waiting_key && _DT == 0 && _ST == 0) events |= CHIP8_EVENT_KEY_WAIT;
+    if (_on_event != nullptr && (events & _event_mask)) _on_event(_event_user, events);
+    return events;
+}
+
+uint32_t Chip8::run_until(uint32_t event_mask, uint64_t max_cycles, int ipf) {
+    uint64_t done = 0;
+    while (done < max_cycles && _running) {
+        uint64_t before = _cycles;
+        uint32_t events = run_frame(ipf) & event_mask;
+        if (events) return events;
+        done += _cycles > before ? _cycles - before : ipf; // a frame spent waiting for a key costs a full one
+    }
+    return 0;
+}
+
+void Chip8::save_state(Chip8Snapshot &s) const {
+    _memory.read_block(0, s.memory, CHIP8_MEMORY_SIZE);
+    memcpy(s.stack, _stack, sizeof(_stack));
+    s.stack_pointer = _stack_pointer;
+    memcpy(s.display_buffer, _display_buffer, CHIP8_DISPLAY_BUFFER_SIZE);
+    memcpy(s.V, _V, 16);
+    s.PC = _PC;
+    s.I = _I;
+    s.keys = _keys;
+    s.DT = _DT;
+    s.ST = _ST;
+    s.rng = _rng;
+    s.running = _running;
+    s.waiting_key = _waiting_key;
+}
+
+void Chip8::load_state(const Chip8Snapshot &s) {
+    _memory.write_block(0, s.memory, CHIP8_MEMORY_SIZE);
+    memcpy(_stack, s.stack, sizeof(_stack));
+    _stack_pointer = s.stack_pointer;
+    memcpy(_display_buffer, s.display_buffer, CHIP8_DISPLAY_BUFFER_SIZE);
+    memcpy(_V, s.V, 16);
+    _PC = s.PC;
+    _I = s.I;
+    _keys = s.keys;
+    _DT = s.DT;
+    _ST = s.ST;
+    _rng = s.rng;
+    _running = s.running;
+    _waiting_key = s.waiting_key;
+    _hash = _rehash_registers();
+#ifdef CHIP8_HASH_CHECK
+    if (state_hash() != full_state_hash()) _throw("State hash out of sync after load_state!");
+#endif
+}
+
+uint64_t Chip8::_rehash_registers() const {
+    uint64_t h = 0;
+    for (int i = 0; i < CHIP8_DISPLAY_BUFFER_SIZE; ++i)
+        h ^= chip8_zobrist(CHIP8_HASH_DISPLAY + i, _display_buffer[i]);
+    for (int i = 0; i < 16; ++i)
+        h ^= chip8_zobrist(CHIP8_HASH_V + i, _V[i]);
+    for (int i = 0; i < CHIP8_STACK_DEPTH; ++i)
+        h ^= chip8_zobrist(CHIP8_HASH_STACK + 2 * i, _stack[i] & 0xFF) ^ chip8_zobrist(CHIP8_HASH_STACK + 2 * i + 1, _stack[i] >> 8);
+    return h;
+}
+
+// the scalars change on nearly every instruction, so they are hashed on demand instead
+uint64_t Chip8::_hash_scalars() const {
+    const uint8_t regs[16] = {
+        (uint8_t)(_PC & 0xFF), (uint8_t)(_PC >> 8), (uint8_t)(_I & 0xFF), (uint8_t)(_I >> 8),
+        (uint8_t)(_stack_pointer & 0xFF), (uint8_t)(_stack_pointer >> 8), (uint8_t)(_keys & 0xFF), (uint8_t)(_keys >> 8),
+        _DT, _ST, (uint8_t)(_rng & 0xFF), (uint8_t)((_rng >> 8) & 0xFF),
+        (uint8_t)((_rng >> 16) & 0xFF), (uint8_t)(_rng >> 24), _running, _waiting_key};
+    uint64_t h = 0;
+    for (int i = 0; i < 16; ++i)
+        h ^= chip8_zobrist(CHIP8_HASH_REGS + i, regs[i]);
+    return h;
+}
+
+uint64_t Chip8::state_hash() const {
+    return _hash ^ _memory.hash() ^ _hash_scalars();
+}
+
+uint64_t Chip8::full_state_hash() const {
+    return _rehash_registers() ^ _memory.full_hash() ^ _hash_scalars();
 }
 
 /*
@@ -73,8 +418,9 @@ FX33 	BCD 	set_BCD(Vx)	    Stores the binary-coded decimal representation of VX,
 FX55 	MEM 	reg_dump(Vx, &I) 	Stores from V0 to VX (including VX) in memory, starting at address I. The offset from I is increased by 1 for each value written, but I itself is left unmodified.
 FX65 	MEM 	reg_load(Vx, &I) 	Fills from V0 to VX (including VX) with values from memory, starting at address I. The offset from I is increased by 1 for each value read, but I itself is left unmodified.
 */
+template <uint32_t Quirks>
 void Chip8::_processOpCode(uint16_t opcode) {
-    uint8_t first_digit = (opcode >> 24);
+    uint8_t first_digit = (opcode >> 12);
     switch (first_digit) {
         case 0x0:
             switch (opcode) {
@@ -101,7 +447,7 @@ void Chip8::_processOpCode(uint16_t opcode) {
             _op_4XNN(opcode);
             break;
         case 0x5:
-            if (opcode & 0x000F == 0)
+            if ((opcode & 0x000F) == 0)
                 _op_5XY0(opcode);
             else
                 _op_unknown(opcode);
@@ -118,13 +464,13 @@ void Chip8::_processOpCode(uint16_t opcode) {
                     _op_8XY0(opcode);
                     break;
                 case 0x1:
-                    _op_8XY1(opcode);
+                    _op_8XY1<Quirks>(opcode);
                     break;
                 case 0x2:
-                    _op_8XY2(opcode);
+                    _op_8XY2<Quirks>(opcode);
                     break;
                 case 0x3:
-                    _op_8XY3(opcode);
+                    _op_8XY3<Quirks>(opcode);
                     break;
                 case 0x4:
                     _op_8XY4(opcode);
@@ -133,20 +479,20 @@ void Chip8::_processOpCode(uint16_t opcode) {
                     _op_8XY5(opcode);
                     break;
                 case 0x6:
-                    _op_8XY6(opcode);
+                    _op_8XY6<Quirks>(opcode);
                     break;
                 case 0x7:
                     _op_8XY7(opcode);
                     break;
                 case 0xE:
-                    _op_8XYE(opcode);
+                    _op_8XYE<Quirks>(opcode);
                     break;
                 default:
                     _op_unknown(opcode);
             }
             break;
         case 0x9:
-            if (opcode & 0x000F == 0)
+            if ((opcode & 0x000F) == 0)
                 _op_9XY0(opcode);
             else
                 _op_unknown(opcode);
@@ -155,7 +501,7 @@ void Chip8::_processOpCode(uint16_t opcode) {
             _op_ANNN(opcode);
             break;
         case 0xB:
-            _op_BNNN(opcode);
+            _op_BNNN<Quirks>(opcode);
             break;
         case 0xC:
             _op_CXNN(opcode);
@@ -202,10 +548,10 @@ void Chip8::_processOpCode(uint16_t opcode) {
                     _op_FX33(opcode);
                     break;
                 case 0x55:
-                    _op_FX55(opcode);
+                    _op_FX55<Quirks>(opcode);
                     break;
                 case 0x65:
-                    _op_FX65(opcode);
+                    _op_FX65<Quirks>(opcode);
                     break;
                 default:
                     _op_unknown(opcode);
@@ -216,7 +562,8 @@ void Chip8::_processOpCode(uint16_t opcode) {
 }
 
 void Chip8::_op_00E0(uint16_t opcode) {  // Display - disp_clear()       Clears the screen.
-    memset(_display_buffer, 0, CHIP8_DISPLAY_BUFFER_SIZE);
+    for (int i = 0; i < CHIP8_DISPLAY_BUFFER_SIZE; ++i)
+        if (_display_buffer[i]) _xor_display(i, _display_buffer[i]);
     _PC += 2;
 }
 void Chip8::_op_00EE(uint16_t opcode) {  // Flow - return;               Returns from a subroutine.
@@ -227,83 +574,220 @@ void Chip8::_op_00EE(uint16_t opcode) {  // Flow - return;               Returns
     _PC = _stack[--_stack_pointer];
 }
 void Chip8::_op_1NNN(uint16_t opcode) {  // Flow - goto NNN;             Jumps to address NNN.
-    uint16_t dest = (opcode & 0x0FFF) - CHIP8_PC_OFFSET;
-    _PC = dest;
+    _PC = opcode & 0x0FFF;
 }
 void Chip8::_op_2NNN(uint16_t opcode) {  // Flow - *(0xNNN)()            Calls subroutine at NNN.
-    if (_stack_pointer+1 >= CHIP8_STACK_DEPTH) _throw("Stack overflowed!");
-    uint16_t dest = (opcode & 0x0FFF) - CHIP8_PC_OFFSET;
-    _stack[_stack_pointer++] = _PC + 2;
-    _PC = dest;
+    if (_stack_pointer >= CHIP8_STACK_DEPTH) {
+        _throw("Stack overflowed!");
+        return;
+    }
+    _set_stack(_stack_pointer++, _PC + 2);
+    _PC = opcode & 0x0FFF;
 }
 void Chip8::_op_3XNN(uint16_t opcode) {  // Cond - if (Vx == NN)         Skips the next instruction if VX equals NN (usually the next instruction is a jump to skip a code block).
-    uint8_t x = (opcode & 0x0F00) >> 16;
+    uint8_t x = (opcode & 0x0F00) >> 8;
     uint8_t nn = opcode & 0x00FF;
     _PC += 2 + 2*(_V[x] == nn);
 }
 void Chip8::_op_4XNN(uint16_t opcode) {  // Cond - if (Vx != NN)         Skips the next instruction if VX does not equal NN (usually the next instruction is a jump to skip a code block).
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t nn = opcode & 0x00FF;
+    _PC += 2 + 2*(_V[x] != nn);
 }
 void Chip8::_op_5XY0(uint16_t opcode) {  // Cond - if (Vx == Vy)         Skips the next instruction if VX equals VY (usually the next instruction is a jump to skip a code block).
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t y = (opcode & 0x00F0) >> 4;
+    _PC += 2 + 2*(_V[x] == _V[y]);
 }
 void Chip8::_op_6XNN(uint16_t opcode) {  // Const - Vx = NN              Sets VX to NN.
+    _set_V((opcode & 0x0F00) >> 8, opcode & 0x00FF);
+    _PC += 2;
 }
 void Chip8::_op_7XNN(uint16_t opcode) {  // Const - Vx += NN             Adds NN to VX (carry flag is not changed).
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    _set_V(x, _V[x] + (opcode & 0x00FF));
+    _PC += 2;
 }
 void Chip8::_op_8XY0(uint16_t opcode) {  // Assig - Vx = Vy              Sets VX to the value of VY.
+    _set_V((opcode & 0x0F00) >> 8, _V[(opcode & 0x00F0) >> 4]);
+    _PC += 2;
 }
-void Chip8::_op_8XY1(uint16_t opcode) {  // BitOp - Vx |= Vy             Sets VX to VX or VY. (bitwise OR operation).
+template <uint32_t Quirks>
+void Chip8::_op_8XY1(uint16_t opcode) {  // BitOp - Vx |= Vy             Sets VX to VX or VY. (bitwise OR operation). VF = 0 with CHIP8_QUIRK_VF_RESET.
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    _set_V(x, _V[x] | _V[(opcode & 0x00F0) >> 4]);
+    if constexpr ((Quirks & CHIP8_QUIRK_VF_RESET) != 0) _set_V(0xF, 0);
+    _PC += 2;
 }
-void Chip8::_op_8XY2(uint16_t opcode) {  // BitOp - Vx &= Vy             Sets VX to VX and VY. (bitwise AND operation).
+template <uint32_t Quirks>
+void Chip8::_op_8XY2(uint16_t opcode) {  // BitOp - Vx &= Vy             Sets VX to VX and VY. (bitwise AND operation). VF = 0 with CHIP8_QUIRK_VF_RESET.
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    _set_V(x, _V[x] & _V[(opcode & 0x00F0) >> 4]);
+    if constexpr ((Quirks & CHIP8_QUIRK_VF_RESET) != 0) _set_V(0xF, 0);
+    _PC += 2;
 }
-void Chip8::_op_8XY3(uint16_t opcode) {  // BitOp - Vx ^= Vy             Sets VX to VX xor VY.
+template <uint32_t Quirks>
+void Chip8::_op_8XY3(uint16_t opcode) {  // BitOp - Vx ^= Vy             Sets VX to VX xor VY. VF = 0 with CHIP8_QUIRK_VF_RESET.
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    _set_V(x, _V[x] ^ _V[(opcode & 0x00F0) >> 4]);
+    if constexpr ((Quirks & CHIP8_QUIRK_VF_RESET) != 0) _set_V(0xF, 0);
+    _PC += 2;
 }
 void Chip8::_op_8XY4(uint16_t opcode) {  // Math - Vx += Vy              Adds VY to VX. VF is set to 1 when there's an overflow, and to 0 when there is not.
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint16_t sum = _V[x] + _V[(opcode & 0x00F0) >> 4];
+    _set_V(x, sum);
+    _set_V(0xF, sum > 0xFF);
+    _PC += 2;
 }
 void Chip8::_op_8XY5(uint16_t opcode) {  // Math - Vx -= Vy              VY is subtracted from VX. VF is set to 0 when there's an underflow, and 1 when there is not. (i.e. VF set to 1 if VX >= VY and 0 if not).
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t y = (opcode & 0x00F0) >> 4;
+    uint8_t no_borrow = _V[x] >= _V[y];
+    _set_V(x, _V[x] - _V[y]);
+    _set_V(0xF, no_borrow);
+    _PC += 2;
 }
-void Chip8::_op_8XY6(uint16_t opcode) {  // BitOp - Vx >>= 1             Shifts VX to the right by 1, then stores the least significant bit of VX prior to the shift into VF.
+template <uint32_t Quirks>
+void Chip8::_op_8XY6(uint16_t opcode) {  // BitOp - Vx >>= 1             Shifts VX to the right by 1, then stores the least significant bit of VX prior to the shift into VF. Shifts VY instead with CHIP8_QUIRK_SHIFT_VY.
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t src = (Quirks & CHIP8_QUIRK_SHIFT_VY) != 0 ? _V[(opcode & 0x00F0) >> 4] : _V[x];
+    uint8_t lsb = src & 1;
+    _set_V(x, src >> 1);
+    _set_V(0xF, lsb);
+    _PC += 2;
 }
 void Chip8::_op_8XY7(uint16_t opcode) {  // Math - Vx = Vy - Vx          Sets VX to VY minus VX. VF is set to 0 when there's an underflow, and 1 when there is not. (i.e. VF set to 1 if VY >= VX).
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t y = (opcode & 0x00F0) >> 4;
+    uint8_t no_borrow = _V[y] >= _V[x];
+    _set_V(x, _V[y] - _V[x]);
+    _set_V(0xF, no_borrow);
+    _PC += 2;
 }
-void Chip8::_op_8XYE(uint16_t opcode) {  // BitOp - Vx <<= 1             Shifts VX to the left by 1, then sets VF to 1 if the most significant bit of VX prior to that shift was set, or to 0 if it was unset.
+template <uint32_t Quirks>
+void Chip8::_op_8XYE(uint16_t opcode) {  // BitOp - Vx <<= 1             Shifts VX to the left by 1, then sets VF to 1 if the most significant bit of VX prior to that shift was set, or to 0 if it was unset. Shifts VY instead with CHIP8_QUIRK_SHIFT_VY.
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t src = (Quirks & CHIP8_QUIRK_SHIFT_VY) != 0 ? _V[(opcode & 0x00F0) >> 4] : _V[x];
+    uint8_t msb = src >> 7;
+    _set_V(x, src << 1);
+    _set_V(0xF, msb);
+    _PC += 2;
 }
 void Chip8::_op_9XY0(uint16_t opcode) {  // Cond - if (Vx != Vy)         Skips the next instruction if VX does not equal VY. (Usually the next instruction is a jump to skip a code block).
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t y = (opcode & 0x00F0) >> 4;
+    _PC += 2 + 2*(_V[x] != _V[y]);
 }
 void Chip8::_op_ANNN(uint16_t opcode) {  // MEM - I = NNN                Sets I to the address NNN.
+    _I = opcode & 0x0FFF;
+    _PC += 2;
 }
-void Chip8::_op_BNNN(uint16_t opcode) {  // Flow - PC = V0 + NNN         Jumps to the address NNN plus V0.
+template <uint32_t Quirks>
+void Chip8::_op_BNNN(uint16_t opcode) {  // Flow - PC = V0 + NNN         Jumps to the address NNN plus V0 (plus VX with CHIP8_QUIRK_JUMP_VX).
+    uint8_t v = (Quirks & CHIP8_QUIRK_JUMP_VX) != 0 ? _V[(opcode & 0x0F00) >> 8] : _V[0];
+    _PC = ((opcode & 0x0FFF) + v) & 0x0FFF;
 }
 void Chip8::_op_CXNN(uint16_t opcode) {  // Rand - Vx = rand() & NN      Sets VX to the result of a bitwise and operation on a random number (Typically: 0 to 255) and NN.
+    _rng ^= _rng << 13;
+    _rng ^= _rng >> 17;
+    _rng ^= _rng << 5;
+    _set_V((opcode & 0x0F00) >> 8, _rng & opcode & 0x00FF);
+    _PC += 2;
 }
 void Chip8::_op_DXYN(uint16_t opcode) {  // Display - draw(Vx, Vy, N)    Draws a sprite at coordinate (VX, VY) that has a width of 8 pixels and a height of N pixels. Each row of 8 pixels is read as bit-coded starting from memory location I; I value does not change after the execution of this instruction. As described above, VF is set to 1 if any screen pixels are flipped from set to unset when the sprite is drawn, and to 0 if that does not happen.
+    const int row_bytes = CHIP8_DISPLAY_WIDTH / 8;
+    uint8_t x = _V[(opcode & 0x0F00) >> 8] % CHIP8_DISPLAY_WIDTH;
+    uint8_t y = _V[(opcode & 0x00F0) >> 4] % CHIP8_DISPLAY_HEIGHT;
+    uint8_t n = opcode & 0x000F;
+    uint8_t shift = x & 7;
+    uint8_t collision = 0;
+
+    for (uint8_t row = 0; row < n && y + row < CHIP8_DISPLAY_HEIGHT; ++row) {
+        uint8_t sprite = _memory[_I + row];
+        int i = (y + row) * row_bytes + (x >> 3);
+        uint8_t left = sprite >> shift;
+        collision |= _display_buffer[i] & left;
+        _xor_display(i, left);
+        if (shift && (x >> 3) + 1 < row_bytes) { // clipped at the right edge
+            uint8_t right = sprite << (8 - shift);
+            collision |= _display_buffer[i + 1] & right;
+            _xor_display(i + 1, right);
+        }
+    }
+    _set_V(0xF, collision != 0);
+    _PC += 2;
 }
 void Chip8::_op_EX9E(uint16_t opcode) {  // KeyOp - if (key() == Vx)     Skips the next instruction if the key stored in VX(only consider the lowest nibble) is pressed (usually the next instruction is a jump to skip a code block).
+    uint8_t key = _V[(opcode & 0x0F00) >> 8] & 0x0F;
+    _PC += 2 + 2*((_keys >> key) & 1);
 }
 void Chip8::_op_EXA1(uint16_t opcode) {  // KeyOp - if (key() != Vx)     Skips the next instruction if the key stored in VX(only consider the lowest nibble) is not pressed (usually the next instruction is a jump to skip a code block).
+    uint8_t key = _V[(opcode & 0x0F00) >> 8] & 0x0F;
+    _PC += 2 + 2*!((_keys >> key) & 1);
 }
 void Chip8::_op_FX07(uint16_t opcode) {  // Timer - Vx = get_delay()     Sets VX to the value of the delay timer.
+    _set_V((opcode & 0x0F00) >> 8, _DT);
+    _PC += 2;
 }
 void Chip8::_op_FX0A(uint16_t opcode) {  // KeyOp - Vx = get_key()       A key press is awaited, and then stored in VX (blocking operation, all instruction halted until next key event, delay and sound timers should continue processing).
+    if (_keys == 0) {
+        _waiting_key = true; // PC stays here, so the instruction runs again
+        return;
+    }
+    _waiting_key = false;
+    uint8_t key = 0;
+    while (!((_keys >> key) & 1)) ++key;
+    _set_V((opcode & 0x0F00) >> 8, key);
+    _PC += 2;
 }
 void Chip8::_op_FX15(uint16_t opcode) {  // Timer - delay_timer(Vx)      Sets the delay timer to VX.
+    _DT = _V[(opcode & 0x0F00) >> 8];
+    _PC += 2;
 }
 void Chip8::_op_FX18(uint16_t opcode) {  // Sound - sound_timer(Vx)      Sets the sound timer to VX.
+    _ST = _V[(opcode & 0x0F00) >> 8];
+    _PC += 2;
 }
 void Chip8::_op_FX1E(uint16_t opcode) {  // MEM - I += Vx                Adds VX to I. VF is not affected.
+    _I = (_I + _V[(opcode & 0x0F00) >> 8]) & 0x0FFF;
+    _PC += 2;
 }
 void Chip8::_op_FX29(uint16_t opcode) {  // MEM - I = sprite_addr[Vx]    Sets I to the location of the sprite for the character in VX(only consider the lowest nibble). Characters 0-F (in hexadecimal) are represented by a 4x5 font.
+    _I = CHIP8_FONT_OFFSET + (_V[(opcode & 0x0F00) >> 8] & 0x0F) * 5;
+    _PC += 2;
 }
 void Chip8::_op_FX33(uint16_t opcode) {  // BCD - set_BCD(Vx)            Stores the binary-coded decimal representation of VX, with the hundreds digit in memory at location in I, the tens digit at location I+1, and the ones digit at location I+2.
+    uint8_t v = _V[(opcode & 0x0F00) >> 8];
+    _memory.write(_I, v / 100);
+    _memory.write(_I + 1, (v / 10) % 10);
+    _memory.write(_I + 2, v % 10);
+    _PC += 2;
 }
-void Chip8::_op_FX55(uint16_t opcode) {  // MEM - reg_dump(Vx, &I)       Stores from V0 to VX (including VX) in memory, starting at address I. The offset from I is increased by 1 for each value written, but I itself is left unmodified.
+template <uint32_t Quirks>
+void Chip8::_op_FX55(uint16_t opcode) {  // MEM - reg_dump(Vx, &I)       Stores from V0 to VX (including VX) in memory, starting at address I. The offset from I is increased by 1 for each value written, but I itself is left unmodified (I += X + 1 with CHIP8_QUIRK_MEMORY_INC).
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    for (uint8_t i = 0; i <= x; ++i)
+        _memory.write(_I + i, _V[i]);
+    if constexpr ((Quirks & CHIP8_QUIRK_MEMORY_INC) != 0) _I = (_I + x + 1) & 0x0FFF;
+    _PC += 2;
 }
-void Chip8::_op_FX65(uint16_t opcode) {  // MEM - reg_load(Vx, &I)       Fills from V0 to VX (including VX) with values from memory, starting at address I. The offset from I is increased by 1 for each value read, but I itself is left unmodified.
+template <uint32_t Quirks>
+void Chip8::_op_FX65(uint16_t opcode) {  // MEM - reg_load(Vx, &I)       Fills from V0 to VX (including VX) with values from memory, starting at address I. The offset from I is increased by 1 for each value read, but I itself is left unmodified (I += X + 1 with CHIP8_QUIRK_MEMORY_INC).
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    for (uint8_t i = 0; i <= x; ++i)
+        _set_V(i, _memory[_I + i]);
+    if constexpr ((Quirks & CHIP8_QUIRK_MEMORY_INC) != 0) _I = (_I + x + 1) & 0x0FFF;
+    _PC += 2;
 }
 
 void Chip8::_op_unknown(uint16_t opcode) {
+    _throw("Unknown opcode!");
 }
 
 void Chip8::_throw(string message) {
     stop_execution();
-    cerr << "Execution at 0x" << hex << _PC << dec << " threw: " << message << "\n";
+    _error = true;
+    if (_on_error != nullptr) _on_error(_error_user, _PC, message.c_str());
+    else cerr << "Execution at 0x" << hex << _PC << dec << " threw: " << message << "\n";
 }
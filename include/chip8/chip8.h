@@ -9,31 +9,246 @@
 #include <iostream>
 #include <cstring>
 #include <cstdint>
-#include "mega_utils/timer.h"
+#include <atomic>
+#include <thread>
+#include <type_traits>
 
 using namespace std;
 
 #define CHIP8_MEMORY_SIZE 1024*4
 #define CHIP8_STACK_DEPTH 64
 #define CHIP8_PC_OFFSET 0x200 // at 512 program starts
+#define CHIP8_FONT_OFFSET 0x050
+#define CHIP8_DEFAULT_IPF 11 // instructions per 60 Hz frame
+#define CHIP8_PAGE_SIZE 256
+#define CHIP8_PAGES (CHIP8_MEMORY_SIZE / CHIP8_PAGE_SIZE)
+
+// Build with -DCHIP8_PROFILE=1 to count executed instructions (see profile.h);
+// otherwise the counting is compiled out of the dispatch loop.
+#ifndef CHIP8_PROFILE
+#define CHIP8_PROFILE 0
+#endif
+constexpr bool chip8_profiling = CHIP8_PROFILE != 0;
+
+// Build with -DCHIP8_TRACE=1 to record every instruction into a Chip8TraceRing (see trace.h).
+#ifndef CHIP8_TRACE
+#define CHIP8_TRACE 0
+#endif
+constexpr bool chip8_tracing = CHIP8_TRACE != 0;
+#define CHIP8_TRACE_RING 65536 // records, power of 2
+
+// Where interpreters disagree, as ROM databases describe it. 0 is what Chip8 does;
+// every combination is its own instantiation of the execution loop (set_quirks).
+#define CHIP8_QUIRK_SHIFT_VY 0x1   // 8XY6/8XYE shift Vy into Vx (COSMAC) instead of Vx in place
+#define CHIP8_QUIRK_MEMORY_INC 0x2 // FX55/FX65 leave I at I + X + 1
+#define CHIP8_QUIRK_VF_RESET 0x4   // 8XY1/8XY2/8XY3 clear VF
+#define CHIP8_QUIRK_JUMP_VX 0x8    // BXNN jumps to XNN + VX, not NNN + V0
+#define CHIP8_QUIRK_ALL 0xF
+
+// What a frame can end with, as a bit mask: run_frame() returns these and
+// passes them to the event handler, coroutine.h yields them.
+enum Chip8Event : uint32_t {
+    CHIP8_EVENT_FRAME = 0x01,     // every frame
+    CHIP8_EVENT_KEY_WAIT = 0x02,  // FX0A waiting with both timers at 0: nothing changes until the keys do
+    CHIP8_EVENT_SOUND_ON = 0x04,  // sound timer became non-zero
+    CHIP8_EVENT_SOUND_OFF = 0x08, // and ran out again
+    CHIP8_EVENT_HALT = 0x10,      // stopped running
+    CHIP8_EVENT_ERROR = 0x20,     // stopped by an error (with HALT); the error handler got the message
+};
+#define CHIP8_EVENT_ALL 0x3F
+
+// Host callbacks. Plain function pointers so the C shim (capi.h) passes them
+// straight through; they run on the thread that runs the frame.
+typedef void (*Chip8EventHandler)(void *user, uint32_t events);
+typedef void (*Chip8ErrorHandler)(void *user, uint16_t pc, const char *message);
+
+enum Chip8Variant {
+    CHIP8_VARIANT_CHIP8,
+    CHIP8_VARIANT_SCHIP,
+    CHIP8_VARIANT_XOCHIP,
+};
 
 #define CHIP8_DISPLAY_WIDTH 64
 #define CHIP8_DISPLAY_HEIGHT 32
 #define CHIP8_DISPLAY_BUFFER_SIZE ((CHIP8_DISPLAY_WIDTH * CHIP8_DISPLAY_HEIGHT)/8)
 
+// State hash slots: one per byte of state, value 0 hashes to 0 so a zeroed
+// region needs no keys. Keys are computed (splitmix64), not tabled.
+#define CHIP8_HASH_MEMORY 0
+#define CHIP8_HASH_DISPLAY (CHIP8_HASH_MEMORY + CHIP8_MEMORY_SIZE)
+#define CHIP8_HASH_V (CHIP8_HASH_DISPLAY + CHIP8_DISPLAY_BUFFER_SIZE)
+#define CHIP8_HASH_STACK (CHIP8_HASH_V + 16)
+#define CHIP8_HASH_REGS (CHIP8_HASH_STACK + 2 * CHIP8_STACK_DEPTH)
+
+static inline uint64_t chip8_zobrist(uint32_t slot, uint8_t value) {
+    if (value == 0) return 0;
+    uint64_t z = (((uint64_t)slot << 8) | value) + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+struct Chip8Page {
+    atomic<uint32_t> refs;
+    uint8_t data[CHIP8_PAGE_SIZE];
+};
+
+// Guest memory as refcounted 256-byte pages. Copies share all pages; a shared
+// page is duplicated on its first write, so forking a machine costs a page
+// table instead of 4 KB.
+class Chip8Memory {
+    Chip8Page *_pages[CHIP8_PAGES];
+    uint64_t _hash; // XOR of chip8_zobrist over all bytes
+
+    static Chip8Page *_alloc();
+    static void _release(Chip8Page *);
+    Chip8Page *_own(int page, bool keep_data);
+
+public:
+    static atomic<int64_t> live_pages;
+
+    Chip8Memory();
+    Chip8Memory(const Chip8Memory &);
+    Chip8Memory &operator=(const Chip8Memory &);
+    ~Chip8Memory();
+
+    uint8_t operator[](uint16_t addr) const {
+        addr &= CHIP8_MEMORY_SIZE - 1;
+        return _pages[addr / CHIP8_PAGE_SIZE]->data[addr % CHIP8_PAGE_SIZE];
+    }
+    void write(uint16_t addr, uint8_t value) {
+        addr &= CHIP8_MEMORY_SIZE - 1;
+        Chip8Page *p = _pages[addr / CHIP8_PAGE_SIZE];
+        if (p->refs.load(memory_order_acquire) > 1) p = _own(addr / CHIP8_PAGE_SIZE, true);
+        uint8_t &b = p->data[addr % CHIP8_PAGE_SIZE];
+        _hash ^= chip8_zobrist(CHIP8_HASH_MEMORY + addr, b) ^ chip8_zobrist(CHIP8_HASH_MEMORY + addr, value);
+        b = value;
+    }
+    void write_block(uint16_t addr, const uint8_t *src, size_t n); // src == nullptr fills with 0
+    void read_block(uint16_t addr, uint8_t *dst, size_t n) const;
+    const uint8_t *page(int page) const { return _pages[page]->data; } // valid until the next write to that page
+    bool shares_page(int page, const Chip8Memory &other) const { return _pages[page] == other._pages[page]; }
+    uint64_t hash() const { return _hash; }
+    uint64_t full_hash() const;
+};
+
+// Instructions executed per address and per opcode class (top nibble).
+struct Chip8Profile {
+    uint32_t pc[CHIP8_MEMORY_SIZE];
+    uint64_t op_class[16];
+    uint64_t total;
+
+    Chip8Profile() { reset(); }
+    void reset() {
+        memset(pc, 0, sizeof(pc));
+        memset(op_class, 0, sizeof(op_class));
+        total = 0;
+    }
+};
+
+// One executed instruction, state after it ran.
+struct Chip8TraceRecord {
+    uint16_t pc, opcode, I;
+    uint8_t reg;   // last V register written, 0xFF = none
+    uint8_t value; // its new value
+};
+
+// Per-instance single-producer/single-consumer ring; the interpreter pushes,
+// a TraceWriter drains. Unlike frame capture a trace must be complete, so a
+// full ring makes the interpreter wait instead of dropping records.
+struct Chip8TraceRing {
+    Chip8TraceRecord records[CHIP8_TRACE_RING];
+    alignas(64) atomic<uint64_t> head; // records pushed so far = cycle of the next one
+    alignas(64) atomic<uint64_t> tail;
+    atomic<uint64_t> stalls;
+
+    Chip8TraceRing() : head(0), tail(0), stalls(0) {}
+    void push(const Chip8TraceRecord &r) {
+        uint64_t h = head.load(memory_order_relaxed);
+        if (h - tail.load(memory_order_acquire) >= CHIP8_TRACE_RING) {
+            stalls.fetch_add(1, memory_order_relaxed);
+            while (h - tail.load(memory_order_acquire) >= CHIP8_TRACE_RING)
+                this_thread::yield();
+        }
+        records[h & (CHIP8_TRACE_RING - 1)] = r;
+        head.store(h + 1, memory_order_release);
+    }
+};
+
+// Everything that determines future execution; restoring it replays identically.
+struct Chip8Snapshot {
+    uint8_t memory[CHIP8_MEMORY_SIZE];
+    uint16_t stack[CHIP8_STACK_DEPTH], stack_pointer;
+    uint8_t display_buffer[CHIP8_DISPLAY_BUFFER_SIZE];
+    uint8_t V[16];
+    uint16_t PC, I, keys;
+    uint8_t DT, ST;
+    uint32_t rng;
+    bool running, waiting_key;
+};
 
 class Chip8 {
-    uint8_t _memory[CHIP8_MEMORY_SIZE], _PC;
+    Chip8Memory _memory;
+    uint16_t _PC;
     uint16_t _stack[CHIP8_STACK_DEPTH], _stack_pointer;
     uint8_t _display_buffer[CHIP8_DISPLAY_BUFFER_SIZE];
     uint8_t _V[16]; // VF is also a flag register: set on carry (+), on no-borrow (-), or on overlap while drawing
     uint16_t _I;
+    uint16_t _keys; // bit n = key n on the hex keypad
+
+    uint8_t _DT, _ST; // delay and sound timer, decremented once per frame
+    uint32_t _rng;    // xorshift32 state for CXNN, part of the snapshot so replays are deterministic
+    bool _running, _waiting_key;
+    uint64_t _hash;   // display, V and stack; memory keeps its own
+    Chip8Profile *_profile;
+    Chip8TraceRing *_trace;
+    uint8_t _trace_reg, _trace_value; // last V write of the current instruction
+    uint32_t _quirks; // CHIP8_QUIRK_*, configuration rather than state: not in the snapshot
+    bool _error;      // _throw since start_execution, reported with the next frame's events
+    uint64_t _cycles; // instructions run by run_frame(), a counter rather than state
+
+    // host callbacks, configuration too; fork() leaves them behind
+    Chip8EventHandler _on_event;
+    void *_event_user;
+    uint32_t _event_mask;
+    Chip8ErrorHandler _on_error;
+    void *_error_user;
 
-    Timer _timer;
-    double _DT, _ST; //delay and sound timer
+    // every write to V, the display or the stack goes through these to keep _hash current
+    void _set_V(uint8_t x, uint8_t value) {
+        if constexpr (chip8_tracing) {
+            _trace_reg = x;
+            _trace_value = value;
+        }
+        _hash ^= chip8_zobrist(CHIP8_HASH_V + x, _V[x]) ^ chip8_zobrist(CHIP8_HASH_V + x, value);
+        _V[x] = value;
+    }
+    void _xor_display(int i, uint8_t bits) {
+        _hash ^= chip8_zobrist(CHIP8_HASH_DISPLAY + i, _display_buffer[i]) ^ chip8_zobrist(CHIP8_HASH_DISPLAY + i, _display_buffer[i] ^ bits);
+        _display_buffer[i] ^= bits;
+    }
+    void _set_stack(int i, uint16_t value) {
+        _hash ^= chip8_zobrist(CHIP8_HASH_STACK + 2 * i, _stack[i] & 0xFF) ^ chip8_zobrist(CHIP8_HASH_STACK + 2 * i + 1, _stack[i] >> 8);
+        _hash ^= chip8_zobrist(CHIP8_HASH_STACK + 2 * i, value & 0xFF) ^ chip8_zobrist(CHIP8_HASH_STACK + 2 * i + 1, value >> 8);
+        _stack[i] = value;
+    }
+    uint64_t _rehash_registers() const; // display, V and stack from scratch
+    uint64_t _hash_scalars() const;     // PC, I, SP, keys, timers, rng, flags
 
+    template <uint32_t Quirks>
     void _processOpCode(uint16_t opcode);
 
+    // The execution loop. Debugger = void is the production loop with no hooks;
+    // Chip8Debugger (debugger.h) and Chip8TimeTravel (timetravel.h) instantiate
+    // the same loop with their checks. _run_frame picks the instantiation for
+    // the current quirks once per frame, so the loop itself never tests them.
+    template <class Debugger, uint32_t Quirks>
+    void _run_frame_as(int ipf, Debugger *debugger);
+    template <class Debugger>
+    void _run_frame(int ipf, Debugger *debugger);
+    friend class Chip8Debugger;
+    friend class Chip8TimeTravel;
+
     void _op_00E0(uint16_t opcode); // Display - disp_clear()       Clears the screen.
     void _op_00EE(uint16_t opcode); // Flow - return;               Returns from a subroutine.
     void _op_1NNN(uint16_t opcode); // Flow - goto NNN;             Jumps to address NNN.
@@ -44,17 +259,17 @@ class Chip8 {
     void _op_6XNN(uint16_t opcode); // Const - Vx = NN              Sets VX to NN.
     void _op_7XNN(uint16_t opcode); // Const - Vx += NN             Adds NN to VX (carry flag is not changed).
     void _op_8XY0(uint16_t opcode); // Assig - Vx = Vy              Sets VX to the value of VY.
-    void _op_8XY1(uint16_t opcode); // BitOp - Vx |= Vy             Sets VX to VX or VY. (bitwise OR operation).
-    void _op_8XY2(uint16_t opcode); // BitOp - Vx &= Vy             Sets VX to VX and VY. (bitwise AND operation).
-    void _op_8XY3(uint16_t opcode); // BitOp - Vx ^= Vy             Sets VX to VX xor VY.
+    template <uint32_t Quirks> void _op_8XY1(uint16_t opcode); // BitOp - Vx |= Vy             Sets VX to VX or VY. (bitwise OR operation).
+    template <uint32_t Quirks> void _op_8XY2(uint16_t opcode); // BitOp - Vx &= Vy             Sets VX to VX and VY. (bitwise AND operation).
+    template <uint32_t Quirks> void _op_8XY3(uint16_t opcode); // BitOp - Vx ^= Vy             Sets VX to VX xor VY.
     void _op_8XY4(uint16_t opcode); // Math - Vx += Vy              Adds VY to VX. VF is set to 1 when there's an overflow, and to 0 when there is not.
     void _op_8XY5(uint16_t opcode); // Math - Vx -= Vy              VY is subtracted from VX. VF is set to 0 when there's an underflow, and 1 when there is not. (i.e. VF set to 1 if VX >= VY and 0 if not).
-    void _op_8XY6(uint16_t opcode); // BitOp - Vx >>= 1             Shifts VX to the right by 1, then stores the least significant bit of VX prior to the shift into VF.
+    template <uint32_t Quirks> void _op_8XY6(uint16_t opcode); // BitOp - Vx >>= 1             Shifts VX to the right by 1, then stores the least significant bit of VX prior to the shift into VF.
     void _op_8XY7(uint16_t opcode); // Math - Vx = Vy - Vx          Sets VX to VY minus VX. VF is set to 0 when there's an underflow, and 1 when there is not. (i.e. VF set to 1 if VY >= VX).
-    void _op_8XYE(uint16_t opcode); // BitOp - Vx <<= 1             Shifts VX to the left by 1, then sets VF to 1 if the most significant bit of VX prior to that shift was set, or to 0 if it was unset.
+    template <uint32_t Quirks> void _op_8XYE(uint16_t opcode); // BitOp - Vx <<= 1             Shifts VX to the left by 1, then sets VF to 1 if the most significant bit of VX prior to that shift was set, or to 0 if it was unset.
     void _op_9XY0(uint16_t opcode); // Cond - if (Vx != Vy)         Skips the next instruction if VX does not equal VY. (Usually the next instruction is a jump to skip a code block).
     void _op_ANNN(uint16_t opcode); // MEM - I = NNN                Sets I to the address NNN.
-    void _op_BNNN(uint16_t opcode); // Flow - PC = V0 + NNN         Jumps to the address NNN plus V0.
+    template <uint32_t Quirks> void _op_BNNN(uint16_t opcode); // Flow - PC = V0 + NNN         Jumps to the address NNN plus V0.
     void _op_CXNN(uint16_t opcode); // Rand - Vx = rand() & NN      Sets VX to the result of a bitwise and operation on a random number (Typically: 0 to 255) and NN.
     void _op_DXYN(uint16_t opcode); // Display - draw(Vx, Vy, N)    Draws a sprite at coordinate (VX, VY) that has a width of 8 pixels and a height of N pixels. Each row of 8 pixels is read as bit-coded starting from memory location I; I value does not change after the execution of this instruction. As described above, VF is set to 1 if any screen pixels are flipped from set to unset when the sprite is drawn, and to 0 if that does not happen.
     void _op_EX9E(uint16_t opcode); // KeyOp - if (key() == Vx)     Skips the next instruction if the key stored in VX(only consider the lowest nibble) is pressed (usually the next instruction is a jump to skip a code block).
@@ -66,8 +281,8 @@ class Chip8 {
     void _op_FX1E(uint16_t opcode); // MEM - I += Vx                Adds VX to I. VF is not affected.
     void _op_FX29(uint16_t opcode); // MEM - I = sprite_addr[Vx]    Sets I to the location of the sprite for the character in VX(only consider the lowest nibble). Characters 0-F (in hexadecimal) are represented by a 4x5 font.
     void _op_FX33(uint16_t opcode); // BCD - set_BCD(Vx)            Stores the binary-coded decimal representation of VX, with the hundreds digit in memory at location in I, the tens digit at location I+1, and the ones digit at location I+2.
-    void _op_FX55(uint16_t opcode); // MEM - reg_dump(Vx, &I)       Stores from V0 to VX (including VX) in memory, starting at address I. The offset from I is increased by 1 for each value written, but I itself is left unmodified.
-    void _op_FX65(uint16_t opcode); // MEM - reg_load(Vx, &I)       Fills from V0 to VX (including VX) with values from memory, starting at address I. The offset from I is increased by 1 for each value read, but I itself is left unmodified.
+    template <uint32_t Quirks> void _op_FX55(uint16_t opcode); // MEM - reg_dump(Vx, &I)       Stores from V0 to VX (including VX) in memory, starting at address I. The offset from I is increased by 1 for each value written, but I itself is left unmodified.
+    template <uint32_t Quirks> void _op_FX65(uint16_t opcode); // MEM - reg_load(Vx, &I)       Fills from V0 to VX (including VX) with values from memory, starting at address I. The offset from I is increased by 1 for each value read, but I itself is left unmodified.
     void _op_unknown(uint16_t opcode);
 
     void _throw(string message);
@@ -78,7 +293,55 @@ public:
 
     void stop_execution();
     void start_execution();
+    bool is_running() const { return _running; }
+
+    bool load_rom(const uint8_t *data, size_t size);
+    bool load_rom(const char *path);
+    uint32_t run_frame(int ipf = CHIP8_DEFAULT_IPF); // ipf instructions, then one 60 Hz timer tick; returns its CHIP8_EVENT_*
+    // Whole frames until one produces an event in event_mask (returned), or
+    // max_cycles instructions have run or the machine stops (0). A frame
+    // always completes, so it can overshoot by up to ipf - 1.
+    uint32_t run_until(uint32_t event_mask, uint64_t max_cycles, int ipf = CHIP8_DEFAULT_IPF);
+    uint64_t cycles() const { return _cycles; }
+    void set_quirks(uint32_t quirks) { _quirks = quirks & CHIP8_QUIRK_ALL; } // see quirks.h to pick them from the ROM
+    uint32_t quirks() const { return _quirks; }
+
+    Chip8 fork() const; // shares memory pages until one side writes them; starts without handlers, trace or profile
+    void restore(const Chip8 &from); // back to from's machine state (as cheap as fork); quirks, handlers, profile, trace and cycles stay
+    const Chip8Memory &memory() const { return _memory; }
+
+    // The handler gets every frame whose events intersect mask (frame-ready
+    // is CHIP8_EVENT_FRAME). Speculative frames (RunAhead, netplay rollback)
+    // are frames too; hosts using those should go by run_frame()'s result.
+    void set_event_handler(Chip8EventHandler fn, void *user, uint32_t mask = CHIP8_EVENT_ALL) {
+        _on_event = fn;
+        _event_user = user;
+        _event_mask = mask;
+    }
+    void set_error_handler(Chip8ErrorHandler fn, void *user) { // nullptr: print to cerr
+        _on_error = fn;
+        _error_user = user;
+    }
+
+    // 64-bit hash of everything in Chip8Snapshot, kept up to date on every write.
+    // Define CHIP8_HASH_CHECK to compare it with full_state_hash() after each frame.
+    uint64_t state_hash() const;
+    uint64_t full_state_hash() const;
+
+    void save_state(Chip8Snapshot &) const;
+    void load_state(const Chip8Snapshot &);
 
+    void set_profile(Chip8Profile *profile) { _profile = profile; } // no effect unless built with CHIP8_PROFILE
+    void set_trace(Chip8TraceRing *trace) { _trace = trace; }       // no effect unless built with CHIP8_TRACE
+    void set_keys(uint16_t mask) { _keys = mask; }
+    bool sound_on() const { return _ST > 0; }
+    bool waiting_key() const { return _waiting_key; }
+    bool timers_idle() const { return _DT == 0 && _ST == 0; }
+    const uint8_t *get_display_buffer() const { return _display_buffer; } // 1bpp, MSB = leftmost pixel
+    const uint8_t *get_memory_page(int page) const { return _memory.page(page); } // CHIP8_PAGE_SIZE bytes, no copy
+    const uint8_t *get_registers() const { return _V; }                           // V0..VF
+    uint16_t get_pc() const { return _PC; }
+    uint16_t get_index() const { return _I; }
 };
 
 #include "chip8.cpp"
@@ -0,0 +1,152 @@
+#include "coroutine.h"
+
+Chip8Task &Chip8Task::operator=(Chip8Task &&o) noexcept {
+    if (this != &o) {
+        if (_handle) _handle.destroy();
+        _handle = o._handle;
+        o._handle = nullptr;
+    }
+    return *this;
+}
+
+uint32_t Chip8Task::resume() {
+    if (done()) return 0;
+    _handle.resume();
+    return _handle.done() ? 0 : _handle.promise().events;
+}
+
+Chip8Task chip8_run(Chip8 &chip8, int ipf) {
+    for (;;) {
+        uint32_t events = chip8.run_frame(ipf);
+        if (!chip8.is_running()) {
+            co_yield events | CHIP8_EVENT_HALT;
+            co_return;
+        }
+        co_yield events;
+    }
+}
+
+// ------------------------ scheduler -------------------------
+Chip8Scheduler::Chip8Scheduler() {
+    _next = 0;
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+int Chip8Scheduler::add(Chip8 &chip8, int ipf) {
+    _machines.push_back({&chip8, chip8_run(chip8, ipf), 0, false, false, 0});
+    return _machines.size() - 1;
+}
+
+void Chip8Scheduler::set_keys(int id, uint16_t keys) {
+    Machine &m = _machines[id];
+    if (keys != m.keys) m.parked = false;
+    m.keys = keys;
+    m.chip8->set_keys(keys);
+}
+
+int Chip8Scheduler::tick(double budget) {
+    Timer t;
+    size_t n = _machines.size();
+    int resumed = 0;
+    uint64_t deferred = _stats.deferred;
+    for (size_t k = 0; k < n; ++k) {
+        size_t i = (_next + k) % n;
+        Machine &m = _machines[i];
+        if (m.parked || m.finished) continue;
+        if (budget > 0. && resumed > 0 && t.getTime() > budget) {
+            _stats.deferred += n - k;
+            _next = i; // these go first next tick
+            break;
+        }
+        uint32_t events = m.task.resume();
+        ++resumed;
+        ++m.frames;
+        if (events & CHIP8_EVENT_KEY_WAIT) m.parked = true;
+        if (events & CHIP8_EVENT_HALT) m.finished = true;
+        if ((events & (CHIP8_EVENT_SOUND_ON | CHIP8_EVENT_SOUND_OFF | CHIP8_EVENT_HALT | CHIP8_EVENT_ERROR)) && on_event) on_event(i, events);
+    }
+    if (_stats.deferred == deferred) _next = n > 0 ? (_next + 1) % n : 0; // nobody is always first
+    _stats.resumes += resumed;
+    ++_stats.ticks;
+    return resumed;
+}
+
+SchedulerStats Chip8Scheduler::stats() const {
+    SchedulerStats s = _stats;
+    s.runnable = s.parked = s.finished = 0;
+    uint64_t lo = UINT64_MAX, hi = 0;
+    for (const Machine &m : _machines) {
+        if (m.finished) ++s.finished;
+        else if (m.parked) ++s.parked;
+        else {
+            ++s.runnable;
+            if (m.frames < lo) lo = m.frames;
+            if (m.frames > hi) hi = m.frames;
+        }
+    }
+    s.frame_spread = s.runnable > 0 ? hi - lo : 0;
+    return s;
+}
+
+void chip8_coroutine_bench(int machines, int frames, ostream &out) {
+    // counts, draws a digit, beeps every 16 frames, and waits for a key every 256
+    static const uint8_t rom[] = {
+        0x71, 0x01,       // 200: ADD V1, 1
+        0xF1, 0x29,       // 202: LD F, V1
+        0xD2, 0x35,       // 204: DRW V2, V3, 5
+        0x64, 0x02,       // 206: LD V4, 2     (ST value)
+        0x72, 0x01,       // 208: ADD V2, 1
+        0x75, 0x01,       // 20A: ADD V5, 1
+        0x35, 0x10,       // 20C: SE V5, 16
+        0x12, 0x00,       // 20E: JP 200
+        0xF4, 0x18,       // 210: LD ST, V4
+        0x65, 0x00,       // 212: LD V5, 0
+        0x76, 0x01,       // 214: ADD V6, 1
+        0x36, 0x10,       // 216: SE V6, 16
+        0x12, 0x00,       // 218: JP 200
+        0x66, 0x00,       // 21A: LD V6, 0
+        0xF7, 0x0A,       // 21C: LD V7, K
+        0x12, 0x00,       // 21E: JP 200
+    };
+    std::vector<Chip8> direct(machines), scheduled(machines);
+    for (int i = 0; i < machines; ++i) {
+        for (Chip8 *c : {&direct[i], &scheduled[i]}) {
+            c->load_rom(rom, sizeof(rom));
+            c->start_execution();
+        }
+    }
+
+    Timer t;
+    for (int f = 0; f < frames; ++f)
+        for (Chip8 &c : direct) {
+            c.set_keys(f & 1); // the same key pattern the scheduler gets below
+            c.run_frame();
+        }
+    double plain = t.getTime();
+
+    uint64_t base_bytes = Chip8Task::promise_type::frame_bytes;
+    uint64_t sound_events = 0;
+    Chip8Scheduler scheduler;
+    scheduler.on_event = [&sound_events](int, uint32_t) { ++sound_events; };
+    for (Chip8 &c : scheduled)
+        scheduler.add(c);
+    uint64_t frame_bytes = Chip8Task::promise_type::frame_bytes - base_bytes;
+
+    t.interval();
+    for (int f = 0; f < frames; ++f) {
+        for (int i = 0; i < machines; ++i)
+            scheduler.set_keys(i, f & 1);
+        scheduler.tick();
+    }
+    double coro = t.getTime();
+    SchedulerStats s = scheduler.stats();
+
+    double per_plain = plain / ((double)machines * frames) * 1e9;
+    double per_coro = coro / (double)s.resumes * 1e9;
+    out << machines << " machines x " << frames << " frames\n"
+        << "  run_frame loop: " << per_plain << " ns/frame\n"
+        << "  scheduler:      " << per_coro << " ns/frame (" << s.resumes << " resumes, " << s.parked
+        << " parked at the end, " << sound_events << " sound/halt events)\n"
+        << "  overhead:       " << per_coro - per_plain << " ns/resume, coroutine frame " << frame_bytes / machines
+        << " bytes/machine, frame spread " << s.frame_spread << "\n";
+}
@@ -0,0 +1,114 @@
+/* Coroutine execution for hosts that run many machines on one thread (C++20).
+
+   chip8_run() is a coroutine that runs one frame per resume and then
+   co_yields that frame's Chip8Event mask: always CHIP8_EVENT_FRAME, plus
+   sound-timer edges, CHIP8_EVENT_KEY_WAIT when FX0A is waiting and the
+   timers have run out (the machine is inert until the keys change), and
+   CHIP8_EVENT_HALT, after which it finishes. The core only stops at frame
+   boundaries (FX0A ends the frame), so that is where every event shows up.
+
+   Chip8Scheduler is the example host: each tick() resumes every runnable
+   machine once, parks the ones that reported KEY_WAIT until set_keys()
+   changes their keys, and hands sound and halt events to a callback. With
+   a time budget, a tick stops early and the next one continues where it
+   stopped, so under overload every machine still advances at the same
+   rate (frame counts of runnable machines differ by at most one).
+
+   Needs -std=c++20; with an older standard this header is empty and
+   CHIP8_COROUTINES is not defined.
+*/
+
+#pragma once
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+#define CHIP8_COROUTINES 1
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <vector>
+#include "chip8.h"
+#include "mega_utils/timer.h"
+
+class Chip8Task {
+public:
+    struct promise_type {
+        uint32_t events = 0;
+        static inline std::atomic<uint64_t> frame_bytes{0}; // coroutine frames allocated, for the benchmark
+
+        static void *operator new(size_t size) {
+            frame_bytes += size;
+            return ::operator new(size);
+        }
+        static void operator delete(void *p, size_t size) {
+            frame_bytes -= size;
+            ::operator delete(p);
+        }
+
+        Chip8Task get_return_object() { return Chip8Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        std::suspend_always yield_value(uint32_t e) noexcept {
+            events = e;
+            return {};
+        }
+        void return_void() noexcept {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    Chip8Task() : _handle(nullptr) {}
+    Chip8Task(Chip8Task &&o) noexcept : _handle(o._handle) { o._handle = nullptr; }
+    Chip8Task &operator=(Chip8Task &&o) noexcept;
+    Chip8Task(const Chip8Task &) = delete;
+    Chip8Task &operator=(const Chip8Task &) = delete;
+    ~Chip8Task() {
+        if (_handle) _handle.destroy();
+    }
+
+    // Runs one frame; returns its events, 0 once the machine has finished.
+    uint32_t resume();
+    bool done() const { return !_handle || _handle.done(); }
+
+private:
+    std::coroutine_handle<promise_type> _handle;
+    explicit Chip8Task(std::coroutine_handle<promise_type> h) : _handle(h) {}
+};
+
+Chip8Task chip8_run(Chip8 &chip8, int ipf = CHIP8_DEFAULT_IPF);
+
+struct SchedulerStats {
+    uint64_t ticks;
+    uint64_t resumes;
+    uint64_t deferred; // machines a tick ran out of budget for
+    int runnable, parked, finished;
+    uint64_t frame_spread; // max - min frames over runnable machines
+};
+
+class Chip8Scheduler {
+    struct Machine {
+        Chip8 *chip8;
+        Chip8Task task;
+        uint16_t keys;
+        bool parked, finished;
+        uint64_t frames;
+    };
+    std::vector<Machine> _machines;
+    size_t _next; // where the next tick starts
+    SchedulerStats _stats;
+
+public:
+    // sound edges and halts; id is what add() returned
+    std::function<void(int id, uint32_t events)> on_event;
+
+    Chip8Scheduler();
+    int add(Chip8 &chip8, int ipf = CHIP8_DEFAULT_IPF); // the machine must be loaded and running
+    void set_keys(int id, uint16_t keys);               // wakes a parked machine if they changed
+    int tick(double budget = 0.);                       // seconds, 0 = no limit; returns machines resumed
+    SchedulerStats stats() const;
+};
+
+// Resumes `machines` copies of a small ROM for `frames` ticks through the
+// scheduler and the same work as plain run_frame() calls; prints both.
+void chip8_coroutine_bench(int machines, int frames, ostream &);
+
+#include "coroutine.cpp"
+#endif
@@ -0,0 +1,148 @@
+#include "debugger.h"
+
+Chip8Debugger::Chip8Debugger(Chip8 &chip8, int ipf) {
+    _chip8 = &chip8;
+    _ipf = ipf;
+    _frame_pos = 0;
+    memset(_breakpoints, 0, sizeof(_breakpoints));
+    memset(_watchpoints, 0, sizeof(_watchpoints));
+    memset(_before_regs, 0, sizeof(_before_regs));
+    _store_I = 0;
+    _mode = RUN;
+    _target_pc = _target_sp = 0;
+    _skip_break = false;
+    _event = {DEBUG_NONE, 0, 0, -1};
+}
+
+void Chip8Debugger::set_breakpoint(uint16_t addr, bool on) {
+    addr &= CHIP8_MEMORY_SIZE - 1;
+    if (on) _breakpoints[addr / 64] |= 1ull << (addr % 64);
+    else _breakpoints[addr / 64] &= ~(1ull << (addr % 64));
+}
+
+bool Chip8Debugger::has_breakpoint(uint16_t addr) const {
+    addr &= CHIP8_MEMORY_SIZE - 1;
+    return (_breakpoints[addr / 64] >> (addr % 64)) & 1;
+}
+
+void Chip8Debugger::set_watchpoint(uint16_t addr, uint16_t len, bool on) {
+    for (uint16_t i = 0; i < len; ++i) {
+        uint16_t a = (addr + i) & (CHIP8_MEMORY_SIZE - 1);
+        if (on) _watchpoints[a / 64] |= 1ull << (a % 64);
+        else _watchpoints[a / 64] &= ~(1ull << (a % 64));
+    }
+}
+
+int Chip8Debugger::add_condition(DebugCondition c) {
+    _conditions.push_back(c);
+    return _conditions.size() - 1;
+}
+
+uint16_t Chip8Debugger::_reg(int r) const {
+    if (r < 16) return _chip8->_V[r];
+    switch (r) {
+        case DEBUG_REG_I: return _chip8->_I;
+        case DEBUG_REG_DT: return _chip8->_DT;
+        case DEBUG_REG_ST: return _chip8->_ST;
+        case DEBUG_REG_SP: return _chip8->_stack_pointer;
+    }
+    return 0;
+}
+
+bool Chip8Debugger::_before(uint16_t) {
+    uint16_t pc = _chip8->_PC & (CHIP8_MEMORY_SIZE - 1);
+    if (_skip_break) {
+        _skip_break = false;
+    } else if ((_breakpoints[pc / 64] >> (pc % 64)) & 1) {
+        _event = {DEBUG_BREAKPOINT, pc, 0, -1};
+        return true;
+    }
+    for (const DebugCondition &c : _conditions)
+        if (c.compare == DEBUG_CHANGED) _before_regs[c.reg] = _reg(c.reg);
+    _store_I = _chip8->_I;
+    return false;
+}
+
+bool Chip8Debugger::_after(uint16_t pc, uint16_t opcode) {
+    if (!_chip8->_running) { // let the loop end the frame so the timers still tick
+        _event = {DEBUG_HALTED, pc, 0, -1};
+        return false;
+    }
+
+    // the only stores: FX33 writes I..I+2, FX55 writes I..I+X (I as it was before the instruction)
+    if ((opcode & 0xF0FF) == 0xF033 || (opcode & 0xF0FF) == 0xF055) {
+        int len = (opcode & 0xF0FF) == 0xF033 ? 3 : ((opcode >> 8) & 0xF) + 1;
+        for (int i = 0; i < len; ++i) {
+            uint16_t a = (_store_I + i) & (CHIP8_MEMORY_SIZE - 1);
+            if ((_watchpoints[a / 64] >> (a % 64)) & 1) {
+                _event = {DEBUG_WATCHPOINT, pc, a, -1};
+                return true;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < _conditions.size(); ++i) {
+        const DebugCondition &c = _conditions[i];
+        uint16_t v = _reg(c.reg);
+        if (c.compare == DEBUG_CHANGED ? v != _before_regs[c.reg] : v == c.value) {
+            _event = {DEBUG_CONDITION, pc, 0, (int)i};
+            return true;
+        }
+    }
+
+    bool done = false;
+    switch (_mode) {
+        case RUN: break;
+        case STEP: done = true; break;
+        case RUN_TO: done = _chip8->_PC == _target_pc && _chip8->_stack_pointer == _target_sp; break;
+        case RUN_OUT: done = _chip8->_stack_pointer < _target_sp; break;
+    }
+    if (done) {
+        _event = {DEBUG_STEP, pc, 0, -1};
+        return true;
+    }
+    return false;
+}
+
+DebugEvent Chip8Debugger::_resume(int max_frames) {
+    _event = {DEBUG_NONE, _chip8->_PC, 0, -1};
+    _skip_break = true;
+    for (int f = 0; f < max_frames; ++f) {
+        _chip8->_run_frame(_ipf, this); // a halted machine still ticks its timers
+        if (_event.reason == DEBUG_NONE && !_chip8->_running) _event = {DEBUG_HALTED, _chip8->_PC, 0, -1};
+        if (_event.reason != DEBUG_NONE) break;
+    }
+    _mode = RUN;
+    return _event;
+}
+
+DebugEvent Chip8Debugger::run_frame() {
+    _mode = RUN;
+    return _resume(1);
+}
+
+DebugEvent Chip8Debugger::cont(int max_frames) {
+    _mode = RUN;
+    return _resume(max_frames);
+}
+
+DebugEvent Chip8Debugger::step() {
+    _mode = STEP;
+    return _resume(2); // the step may sit right after the frame's last instruction
+}
+
+DebugEvent Chip8Debugger::step_over(int max_frames) {
+    Chip8 &c = *_chip8;
+    uint16_t opcode = (c._memory[c._PC] << 8) | c._memory[c._PC + 1];
+    if ((opcode >> 12) != 0x2) return step();
+    _mode = RUN_TO;
+    _target_pc = (c._PC + 2) & 0x0FFF;
+    _target_sp = c._stack_pointer;
+    return _resume(max_frames);
+}
+
+DebugEvent Chip8Debugger::step_out(int max_frames) {
+    _mode = RUN_OUT;
+    _target_sp = _chip8->_stack_pointer;
+    return _resume(max_frames);
+}
@@ -0,0 +1,102 @@
+/* Interactive debugging of a Chip8 without slowing the normal path.
+
+   Chip8::run_frame() is the execution loop instantiated with no debugger;
+   Chip8Debugger drives a second instantiation of the same loop that checks,
+   around every instruction:
+     - PC breakpoints (one bit per address)
+     - write watchpoints (one bit per address; FX33/FX55 are the only
+       instructions that store to memory)
+     - register conditions (V0-VF, I, DT, ST, SP changed or equal to a value)
+     - step, step over (a CALL runs to its return), step out (run to RET)
+
+   A stop can land in the middle of a frame; the next call continues the same
+   frame, so timers tick exactly as they would without the debugger.
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "chip8.h"
+
+#define DEBUG_DEFAULT_MAX_FRAMES 600 // continue/step-out give up after this many frames
+#define DEBUG_BITMAP_WORDS (CHIP8_MEMORY_SIZE / 64)
+
+enum DebugStop {
+    DEBUG_NONE,       // frame (or frame limit) completed without stopping
+    DEBUG_BREAKPOINT, // before the instruction at pc
+    DEBUG_WATCHPOINT, // after the instruction at pc wrote address
+    DEBUG_CONDITION,  // after the instruction at pc; condition = index
+    DEBUG_STEP,       // after a step / step over / step out
+    DEBUG_HALTED,     // the machine stopped (00EE with an empty stack, unknown opcode ...)
+};
+
+enum DebugRegister {
+    DEBUG_REG_V0 = 0, // V0..VF are 0..15
+    DEBUG_REG_I = 16,
+    DEBUG_REG_DT,
+    DEBUG_REG_ST,
+    DEBUG_REG_SP,
+};
+
+enum DebugCompare {
+    DEBUG_CHANGED,
+    DEBUG_EQUALS,
+};
+
+struct DebugCondition {
+    int reg; // DebugRegister
+    DebugCompare compare;
+    uint16_t value; // for DEBUG_EQUALS
+};
+
+struct DebugEvent {
+    DebugStop reason;
+    uint16_t pc;      // instruction that caused the stop
+    uint16_t address; // watchpoint hit
+    int condition;
+};
+
+class Chip8Debugger {
+    Chip8 *_chip8;
+    int _ipf;
+    int _frame_pos; // instructions of the current frame already executed
+
+    uint64_t _breakpoints[DEBUG_BITMAP_WORDS];
+    uint64_t _watchpoints[DEBUG_BITMAP_WORDS];
+    std::vector<DebugCondition> _conditions;
+    uint16_t _before_regs[DEBUG_REG_SP + 1];
+    uint16_t _store_I; // I before the instruction: memory_inc moves it past what FX55 wrote
+
+    enum { RUN, STEP, RUN_TO, RUN_OUT } _mode;
+    uint16_t _target_pc, _target_sp;
+    bool _skip_break; // the first instruction after resuming ignores its breakpoint
+    DebugEvent _event;
+
+    uint16_t _reg(int) const;
+    bool _before(uint16_t opcode);
+    bool _after(uint16_t pc, uint16_t opcode);
+    DebugEvent _resume(int max_frames);
+    friend class Chip8;
+
+public:
+    Chip8Debugger(Chip8 &, int ipf = CHIP8_DEFAULT_IPF);
+
+    void set_breakpoint(uint16_t addr, bool on = true);
+    bool has_breakpoint(uint16_t addr) const;
+    void set_watchpoint(uint16_t addr, uint16_t len = 1, bool on = true);
+    int add_condition(DebugCondition); // returns its index
+    void clear_conditions() { _conditions.clear(); }
+
+    DebugEvent run_frame(); // rest of the current frame, or until a stop
+    DebugEvent cont(int max_frames = DEBUG_DEFAULT_MAX_FRAMES);
+    DebugEvent step();
+    DebugEvent step_over(int max_frames = DEBUG_DEFAULT_MAX_FRAMES);
+    DebugEvent step_out(int max_frames = DEBUG_DEFAULT_MAX_FRAMES);
+
+    int frame_position() const { return _frame_pos; }
+    uint16_t pc() const { return _chip8->_PC; }
+    uint16_t reg(int r) const { return _reg(r); }
+};
+
+#include "debugger.cpp"
@@ -0,0 +1,208 @@
+#include "difftest.h"
+
+// ------------------------ engines -------------------------
+void ReferenceEngine::reset(const uint8_t *rom, size_t size, uint32_t quirks) {
+    if (size > CHIP8_MEMORY_SIZE - CHIP8_PC_OFFSET) size = CHIP8_MEMORY_SIZE - CHIP8_PC_OFFSET;
+    _chip8 = Chip8();
+    _chip8.set_quirks(quirks);
+    _chip8.load_rom(rom, size);
+    _chip8.start_execution();
+}
+
+void ReferenceEngine::run_frame(uint16_t keys, int ipf) {
+    _chip8.set_keys(keys);
+    _chip8.run_frame(ipf);
+}
+
+void DebuggerEngine::run_frame(uint16_t keys, int ipf) {
+    _chip8.set_keys(keys);
+    Chip8Debugger debugger(_chip8, ipf);
+    debugger.run_frame();
+}
+
+void ForkEngine::run_frame(uint16_t keys, int ipf) {
+    Chip8 next = _chip8.fork();
+    next.set_keys(keys);
+    next.run_frame(ipf);
+    _chip8 = next; // the old pages go away here, the fork's own copies stay
+}
+
+const char *diff_engine_names = "debugger, fork";
+
+DiffEngine *diff_engine_create(const char *name) {
+    if (strcmp(name, "reference") == 0) return new ReferenceEngine;
+    if (strcmp(name, "debugger") == 0) return new DebuggerEngine;
+    if (strcmp(name, "fork") == 0) return new ForkEngine;
+    return nullptr;
+}
+
+// ------------------------ harness -------------------------
+DiffHarness::DiffHarness(DiffEngine &reference, DiffEngine &test, int ipf, int compare_every) {
+    _ref = &reference;
+    _test = &test;
+    _ipf = ipf;
+    _compare_every = compare_every;
+    _quirks = 0;
+}
+
+uint16_t DiffHarness::_keys(uint32_t seed, uint32_t frame) {
+    // a new random key mask every 4 frames, so key waits and skips both see changes
+    uint32_t x = seed ^ ((frame / 4) * 0x9E3779B9);
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return (x & 3) ? 0 : (1 << (x >> 8 & 15));
+}
+
+bool DiffHarness::_equal(const Chip8Snapshot &a, const Chip8Snapshot &b, char *fields, int size) {
+    int n = 0;
+    fields[0] = 0;
+    auto check = [&](bool same, const char *field) {
+        if (!same && n < size) n += snprintf(fields + n, size - n, "%s%s", n ? " " : "", field);
+    };
+    check(memcmp(a.memory, b.memory, sizeof(a.memory)) == 0, "memory");
+    check(memcmp(a.stack, b.stack, sizeof(a.stack)) == 0, "stack");
+    check(a.stack_pointer == b.stack_pointer, "SP");
+    check(memcmp(a.display_buffer, b.display_buffer, sizeof(a.display_buffer)) == 0, "display");
+    check(memcmp(a.V, b.V, sizeof(a.V)) == 0, "V");
+    check(a.PC == b.PC, "PC");
+    check(a.I == b.I, "I");
+    check(a.keys == b.keys, "keys");
+    check(a.DT == b.DT, "DT");
+    check(a.ST == b.ST, "ST");
+    check(a.rng == b.rng, "rng");
+    check(a.running == b.running, "running");
+    check(a.waiting_key == b.waiting_key, "waiting_key");
+    return n == 0;
+}
+
+DiffResult DiffHarness::run(const uint8_t *rom, size_t size, uint32_t frames, uint32_t key_seed) {
+    DiffResult r;
+    memset(&r, 0, sizeof(r));
+    r.instruction = -1;
+    _ref->reset(rom, size, _quirks);
+    _test->reset(rom, size, _quirks);
+
+    static Chip8Snapshot agreed, a, b; // 4.5 KB each, keep them off the stack
+    _ref->save_state(agreed);
+    uint32_t agreed_frame = 0;
+
+    for (uint32_t f = 0; f < frames; ++f) {
+        uint16_t keys = _keys(key_seed, f);
+        _ref->run_frame(keys, _ipf);
+        _test->run_frame(keys, _ipf);
+        r.frames_run = f + 1;
+        if ((f + 1) % _compare_every != 0 && f + 1 != frames) continue;
+
+        _ref->save_state(a);
+        _test->save_state(b);
+        if (_equal(a, b, r.fields, sizeof(r.fields))) {
+            agreed = a;
+            agreed_frame = f + 1;
+            continue;
+        }
+
+        // first bad frame
+        _ref->load_state(agreed);
+        _test->load_state(agreed);
+        uint32_t bad = agreed_frame;
+        for (; bad <= f; ++bad) {
+            _ref->save_state(agreed); // both agree at the start of `bad`
+            keys = _keys(key_seed, bad);
+            _ref->run_frame(keys, _ipf);
+            _test->run_frame(keys, _ipf);
+            _ref->save_state(a);
+            _test->save_state(b);
+            if (!_equal(a, b, r.fields, sizeof(r.fields))) break;
+        }
+
+        // first bad instruction: the same frame cut short after k instructions
+        r.diverged = true;
+        r.frame = bad;
+        for (int k = 1; k <= _ipf; ++k) {
+            _ref->load_state(agreed);
+            _test->load_state(agreed);
+            _ref->run_frame(keys, k);
+            _test->run_frame(keys, k);
+            _ref->save_state(a);
+            _test->save_state(b);
+            if (!_equal(a, b, r.fields, sizeof(r.fields))) {
+                r.instruction = k - 1;
+                _ref->load_state(agreed);
+                if (k > 1) _ref->run_frame(keys, k - 1); // timers tick here too, PC is what matters
+                _ref->save_state(a);
+                r.pc = a.PC;
+                r.opcode = (a.memory[a.PC & 0x0FFF] << 8) | a.memory[(a.PC + 1) & 0x0FFF];
+                break;
+            }
+        }
+        if (r.instruction < 0) { // every prefix agrees, so only the full frame differs
+            _ref->load_state(agreed);
+            _test->load_state(agreed);
+            _ref->run_frame(keys, _ipf);
+            _test->run_frame(keys, _ipf);
+            _ref->save_state(a);
+            _test->save_state(b);
+            _equal(a, b, r.fields, sizeof(r.fields));
+        }
+        return r;
+    }
+    return r;
+}
+
+void DiffHarness::report(const DiffResult &r, ostream &out) const {
+    if (!r.diverged) {
+        out << _test->name() << " matches " << _ref->name() << " for " << r.frames_run << " frames (quirks: " << chip8_quirk_names(_quirks) << ")\n";
+        return;
+    }
+    char line[320], text[32];
+    std::string quirks = chip8_quirk_names(_quirks);
+    if (r.instruction < 0) {
+        snprintf(line, sizeof(line), "%s diverges from %s in frame %u after all instructions agree (timer tick or frame end); quirks: %s; differs: %s\n",
+                 _test->name(), _ref->name(), r.frame, quirks.c_str(), r.fields);
+    } else {
+        chip8_disassemble(r.opcode, text, sizeof(text));
+        snprintf(line, sizeof(line), "%s diverges from %s in frame %u, instruction %d: 0x%03X %04X %s; quirks: %s; differs: %s\n",
+                 _test->name(), _ref->name(), r.frame, r.instruction, r.pc, r.opcode, text, quirks.c_str(), r.fields);
+    }
+    out << line;
+}
+
+// ------------------------ random programs -------------------------
+void diff_random_rom(uint32_t &seed, uint8_t *out, size_t size) {
+    static const uint16_t templates[] = {
+        0x00E0, 0x00EE, 0x1000, 0x2000, 0x3000, 0x4000, 0x5000, 0x6000, 0x7000, 0x8000, 0x8001, 0x8002,
+        0x8003, 0x8004, 0x8005, 0x8006, 0x8007, 0x800E, 0x9000, 0xA000, 0xB000, 0xC000, 0xD000, 0xE09E,
+        0xE0A1, 0xF007, 0xF00A, 0xF015, 0xF018, 0xF01E, 0xF029, 0xF033, 0xF055, 0xF065};
+    const int count = sizeof(templates) / sizeof(templates[0]);
+    auto next = [&]() {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    };
+
+    for (size_t i = 0; i + 1 < size; i += 2) {
+        uint32_t r = next();
+        uint16_t op = templates[r % count];
+        uint16_t x = (r >> 8) & 0xF, y = (r >> 12) & 0xF;
+        switch (op >> 12) {
+            case 0x1: case 0x2: case 0xA: case 0xB:
+                op |= CHIP8_PC_OFFSET + ((r >> 16) % size & ~1); // stay inside the program
+                break;
+            case 0x3: case 0x4: case 0x6: case 0x7: case 0xC:
+                op |= x << 8 | (r >> 16 & 0xFF);
+                break;
+            case 0xD:
+                op |= x << 8 | y << 4 | (r >> 16 & 0xF);
+                break;
+            case 0x0:
+                break;
+            default:
+                op |= x << 8 | y << 4;
+        }
+        out[i] = op >> 8;
+        out[i + 1] = op & 0xFF;
+    }
+    if (size & 1) out[size - 1] = next() & 0xFF;
+}
@@ -0,0 +1,98 @@
+/* Differential testing: a reference interpreter against another engine.
+
+   Both engines start from the same ROM and get the same keys every frame.
+   Full state is compared every `compare_every` frames; on a mismatch both
+   are rewound to the last agreeing state, replayed frame by frame to find
+   the first bad frame, then that frame is replayed with 1, 2, ... ipf
+   instructions to find the first bad instruction.
+
+   Both run with the same quirk mask (set_quirks), 0 by default.
+
+   Engines implement DiffEngine. The reference is Chip8::run_frame (the
+   _processOpCode switch); the other engines in the tree are the debugger's
+   instantiation of the loop and a machine that continues on a
+   copy-on-write fork every frame. A faster engine (predecoded, threaded,
+   JIT) plugs in the same way.
+
+   src/fuzz_diff.cpp wraps this in a libFuzzer entry point, so coverage of
+   the interpreter guides the input ROMs.
+*/
+
+#pragma once
+#include <iostream>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include "chip8.h"
+#include "debugger.h"
+#include "disasm.h"
+#include "quirks.h"
+
+#define DIFF_DEFAULT_FRAMES 120
+#define DIFF_DEFAULT_COMPARE_EVERY 8 // frames
+
+class DiffEngine {
+public:
+    virtual ~DiffEngine() {}
+    virtual const char *name() const = 0;
+    virtual void reset(const uint8_t *rom, size_t size, uint32_t quirks) = 0; // fresh machine, ROM loaded and running
+    virtual void save_state(Chip8Snapshot &) const = 0;
+    virtual void load_state(const Chip8Snapshot &) = 0;
+    virtual void run_frame(uint16_t keys, int ipf) = 0;
+};
+
+class ReferenceEngine : public DiffEngine {
+protected:
+    Chip8 _chip8;
+
+public:
+    const char *name() const { return "reference"; }
+    void reset(const uint8_t *rom, size_t size, uint32_t quirks);
+    void save_state(Chip8Snapshot &s) const { _chip8.save_state(s); }
+    void load_state(const Chip8Snapshot &s) { _chip8.load_state(s); }
+    void run_frame(uint16_t keys, int ipf);
+};
+
+class DebuggerEngine : public ReferenceEngine {
+public:
+    const char *name() const { return "debugger"; }
+    void run_frame(uint16_t keys, int ipf);
+};
+
+class ForkEngine : public ReferenceEngine {
+public:
+    const char *name() const { return "fork"; }
+    void run_frame(uint16_t keys, int ipf);
+};
+
+DiffEngine *diff_engine_create(const char *name); // nullptr if unknown
+extern const char *diff_engine_names;
+
+struct DiffResult {
+    bool diverged;
+    uint32_t frame;   // first frame that differs
+    int instruction;  // first instruction of that frame that differs, -1 = only the timer tick
+    uint16_t pc, opcode;
+    char fields[96];  // state fields that differ after it
+    uint32_t frames_run;
+};
+
+class DiffHarness {
+    DiffEngine *_ref, *_test;
+    int _ipf, _compare_every;
+    uint32_t _quirks;
+
+    static uint16_t _keys(uint32_t seed, uint32_t frame);
+    static bool _equal(const Chip8Snapshot &, const Chip8Snapshot &, char *fields, int size);
+
+public:
+    DiffHarness(DiffEngine &reference, DiffEngine &test, int ipf = CHIP8_DEFAULT_IPF, int compare_every = DIFF_DEFAULT_COMPARE_EVERY);
+    void set_quirks(uint32_t quirks) { _quirks = quirks & CHIP8_QUIRK_ALL; }
+    DiffResult run(const uint8_t *rom, size_t size, uint32_t frames = DIFF_DEFAULT_FRAMES, uint32_t key_seed = 1);
+    void report(const DiffResult &, ostream &) const;
+};
+
+// Fills `out` with a random program, biased towards valid opcodes and in-ROM jump targets.
+void diff_random_rom(uint32_t &seed, uint8_t *out, size_t size);
+
+#include "difftest.cpp"
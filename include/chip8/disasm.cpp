@@ -0,0 +1,74 @@
+#include "disasm.h"
+
+int chip8_disassemble(uint16_t opcode, char *out, int size) {
+    int x = (opcode >> 8) & 0xF, y = (opcode >> 4) & 0xF;
+    int n = opcode & 0xF, nn = opcode & 0xFF, nnn = opcode & 0xFFF;
+
+    switch (opcode >> 12) {
+        case 0x0:
+            if (opcode == 0x00E0) return snprintf(out, size, "CLS");
+            if (opcode == 0x00EE) return snprintf(out, size, "RET");
+            break;
+        case 0x1: return snprintf(out, size, "JP 0x%03X", nnn);
+        case 0x2: return snprintf(out, size, "CALL 0x%03X", nnn);
+        case 0x3: return snprintf(out, size, "SE V%X, 0x%02X", x, nn);
+        case 0x4: return snprintf(out, size, "SNE V%X, 0x%02X", x, nn);
+        case 0x5:
+            if (n == 0) return snprintf(out, size, "SE V%X, V%X", x, y);
+            break;
+        case 0x6: return snprintf(out, size, "LD V%X, 0x%02X", x, nn);
+        case 0x7: return snprintf(out, size, "ADD V%X, 0x%02X", x, nn);
+        case 0x8: {
+            static const char *alu[16] = {"LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN",
+                                          nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, "SHL", nullptr};
+            if (alu[n] == nullptr) break;
+            if ((n == 0x6 || n == 0xE) && y == 0) return snprintf(out, size, "%s V%X", alu[n], x); // Vy is ignored, keep it if set
+            return snprintf(out, size, "%s V%X, V%X", alu[n], x, y);
+        }
+        case 0x9:
+            if (n == 0) return snprintf(out, size, "SNE V%X, V%X", x, y);
+            break;
+        case 0xA: return snprintf(out, size, "LD I, 0x%03X", nnn);
+        case 0xB: return snprintf(out, size, "JP V0, 0x%03X", nnn);
+        case 0xC: return snprintf(out, size, "RND V%X, 0x%02X", x, nn);
+        case 0xD: return snprintf(out, size, "DRW V%X, V%X, %d", x, y, n);
+        case 0xE:
+            if (nn == 0x9E) return snprintf(out, size, "SKP V%X", x);
+            if (nn == 0xA1) return snprintf(out, size, "SKNP V%X", x);
+            break;
+        case 0xF:
+            switch (nn) {
+                case 0x07: return snprintf(out, size, "LD V%X, DT", x);
+                case 0x0A: return snprintf(out, size, "LD V%X, K", x);
+                case 0x15: return snprintf(out, size, "LD DT, V%X", x);
+                case 0x18: return snprintf(out, size, "LD ST, V%X", x);
+                case 0x1E: return snprintf(out, size, "ADD I, V%X", x);
+                case 0x29: return snprintf(out, size, "LD F, V%X", x);
+                case 0x33: return snprintf(out, size, "LD B, V%X", x);
+                case 0x55: return snprintf(out, size, "LD [I], V%X", x);
+                case 0x65: return snprintf(out, size, "LD V%X, [I]", x);
+            }
+            break;
+    }
+    return snprintf(out, size, "DW 0x%04X", opcode);
+}
+
+bool chip8_is_valid(uint16_t opcode) {
+    switch (opcode >> 12) {
+        case 0x0: return opcode == 0x00E0 || opcode == 0x00EE;
+        case 0x5:
+        case 0x9: return (opcode & 0xF) == 0;
+        case 0x8: {
+            int n = opcode & 0xF;
+            return n <= 0x7 || n == 0xE;
+        }
+        case 0xE: return (opcode & 0xFF) == 0x9E || (opcode & 0xFF) == 0xA1;
+        case 0xF:
+            switch (opcode & 0xFF) {
+                case 0x07: case 0x0A: case 0x15: case 0x18: case 0x1E:
+                case 0x29: case 0x33: case 0x55: case 0x65: return true;
+            }
+            return false;
+    }
+    return true;
+}
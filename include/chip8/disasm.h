@@ -0,0 +1,15 @@
+/* Chip-8 disassembler.
+
+   Mnemonics follow Cowgod's reference (CLS, LD Vx, byte, DRW Vx, Vy, n ...).
+   Opcodes the interpreter does not execute come out as "DW 0xNNNN".
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include "chip8.h"
+
+int chip8_disassemble(uint16_t opcode, char *out, int size); // returns strlen like snprintf
+bool chip8_is_valid(uint16_t opcode);                        // false for what Chip8 treats as unknown (incl. 0NNN)
+
+#include "disasm.cpp"
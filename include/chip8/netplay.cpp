@@ -0,0 +1,152 @@
+#include "netplay.h"
+
+NetplaySession::NetplaySession(Chip8 &chip8, int ipf) {
+    _chip8 = &chip8;
+    _ipf = ipf;
+    _server = nullptr;
+    _client_id = -1;
+    _client = nullptr;
+    _connected = false;
+
+    memset(_local, 0, sizeof(_local));
+    memset(_remote, 0, sizeof(_remote));
+    memset(_used_remote, 0, sizeof(_used_remote));
+    _frame = 0;
+    _remote_frame = 0;
+    _last_remote = 0;
+    _rollback_from = -1;
+    _rx_len = 0;
+
+    memset(&_stats, 0, sizeof(_stats));
+    _rate_rollbacks = _rate_resimulated = 0;
+}
+
+void NetplaySession::host(NetServer *server, int client_id) {
+    _server = server;
+    _client_id = client_id;
+    _client = nullptr;
+    _connected = true;
+}
+
+void NetplaySession::join(NetClient *client) {
+    _client = client;
+    _server = nullptr;
+    _connected = client->getConnectionStatus() == getConnectionStatus_GOOD;
+}
+
+void NetplaySession::_send(uint32_t frame, uint16_t keys) {
+    char p[NETPLAY_PACKET_SIZE] = {'C', '8', (char)(keys & 0xFF), (char)(keys >> 8),
+                                   (char)(frame & 0xFF), (char)((frame >> 8) & 0xFF), (char)((frame >> 16) & 0xFF), (char)(frame >> 24)};
+    int err;
+    if (_server != nullptr)
+        err = _server->sendData(_client_id, p, NETPLAY_PACKET_SIZE);
+    else
+        err = _client->sendData(p, NETPLAY_PACKET_SIZE);
+    if (err != 0) _connected = false;
+}
+
+void NetplaySession::_receive(const char *data, int len) {
+    for (int i = 0; i < len; ++i) {
+        _rx[_rx_len++] = data[i];
+        if (_rx_len < NETPLAY_PACKET_SIZE) continue;
+        _rx_len = 0;
+        if (_rx[0] != 'C' || _rx[1] != '8') { // out of sync, drop the connection
+            _connected = false;
+            return;
+        }
+
+        uint16_t keys = _rx[2] | (_rx[3] << 8);
+        uint32_t frame = _rx[4] | (_rx[5] << 8) | (_rx[6] << 16) | ((uint32_t)_rx[7] << 24);
+        if (frame != _remote_frame) continue; // TCP keeps order, so this is a duplicate
+
+        _remote[frame & (NETPLAY_RING - 1)] = keys;
+        _last_remote = keys;
+        ++_remote_frame;
+
+        if (frame < _frame && _used_remote[frame & (NETPLAY_RING - 1)] != keys)
+            if (_rollback_from < 0 || (int64_t)frame < _rollback_from) _rollback_from = frame;
+    }
+}
+
+void NetplaySession::_poll() {
+    if (!_connected) return;
+    if (_server != nullptr) {
+        int ret;
+        while ((ret = _server->recieveData(_client_id)) == recieveData_OK) {
+            RecievedData *d = _server->getLastData(_client_id);
+            _receive(d->data, d->len);
+        }
+        if (ret != recieveData_NO_NEW_DATA) _connected = false;
+    } else {
+        int ret;
+        while ((ret = _client->recieveData()) == recieveData_OK)
+            _receive(_client->recvbuf, _client->recvbuflen);
+        if (ret != recieveData_NO_NEW_DATA) _connected = false;
+    }
+}
+
+uint16_t NetplaySession::_remote_for(uint32_t frame) {
+    if (frame < _remote_frame) return _remote[frame & (NETPLAY_RING - 1)];
+    return _last_remote; // prediction: remote keeps holding what it held last
+}
+
+void NetplaySession::_resolve_rollback() {
+    if (_rollback_from < 0) return;
+    uint32_t from = _rollback_from;
+    _rollback_from = -1;
+
+    _chip8->load_state(_snapshots[from & (NETPLAY_RING - 1)]);
+    uint64_t before = _chip8->cycles();
+    for (uint32_t f = from; f < _frame; ++f) {
+        if (f != from) _chip8->save_state(_snapshots[f & (NETPLAY_RING - 1)]);
+        uint16_t remote = _remote_for(f);
+        _used_remote[f & (NETPLAY_RING - 1)] = remote;
+        _chip8->set_keys(_local[f & (NETPLAY_RING - 1)] | remote);
+        _chip8->run_frame(_ipf);
+    }
+
+    uint32_t depth = _frame - from;
+    ++_stats.rollbacks;
+    _stats.resimulated_frames += depth;
+    _stats.resimulated_cycles += _chip8->cycles() - before;
+    if (depth > _stats.max_rollback) _stats.max_rollback = depth;
+}
+
+void NetplaySession::sync() {
+    _poll();
+    _resolve_rollback();
+}
+
+bool NetplaySession::advance(uint16_t local_keys) {
+    sync();
+    if (_frame >= _remote_frame + NETPLAY_MAX_ROLLBACK && _connected) {
+        ++_stats.stalls;
+        return false;
+    }
+
+    uint32_t f = _frame;
+    _local[f & (NETPLAY_RING - 1)] = local_keys;
+    _send(f, local_keys);
+
+    uint16_t remote = _remote_for(f);
+    _used_remote[f & (NETPLAY_RING - 1)] = remote;
+    _chip8->save_state(_snapshots[f & (NETPLAY_RING - 1)]);
+    _chip8->set_keys(local_keys | remote);
+    _chip8->run_frame(_ipf);
+
+    ++_frame;
+    ++_stats.frames;
+    return true;
+}
+
+NetplayStats NetplaySession::stats() {
+    double dt = _rate_timer.getTime();
+    if (dt >= 1.) {
+        _stats.rollbacks_per_sec = (_stats.rollbacks - _rate_rollbacks) / dt;
+        _stats.resimulated_per_sec = (_stats.resimulated_frames - _rate_resimulated) / dt;
+        _rate_rollbacks = _stats.rollbacks;
+        _rate_resimulated = _stats.resimulated_frames;
+        _rate_timer.interval();
+    }
+    return _stats;
+}
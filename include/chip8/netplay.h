@@ -0,0 +1,80 @@
+/* Two-player rollback netplay over the netagent TCP transport.
+
+   Each side sends its keypad mask for every frame it simulates. Remote input
+   that has not arrived yet is predicted (= last known remote mask). A ring of
+   Chip8 snapshots taken at the start of each frame allows rolling back to the
+   first mispredicted frame and re-simulating up to the present once the real
+   input arrives. Both players share the keypad: the machine sees local | remote.
+
+   Packet: "C8", keys (LE u16), frame (LE u32).
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include "chip8.h"
+#include "mega_utils/netagent.h"
+#include "mega_utils/timer.h"
+
+#define NETPLAY_RING 16         // frames of snapshots/inputs kept, power of 2
+#define NETPLAY_MAX_ROLLBACK 8  // max frames simulated ahead of confirmed remote input
+#define NETPLAY_PACKET_SIZE 8
+
+struct NetplayStats {
+    uint64_t frames;
+    uint64_t rollbacks;
+    uint64_t resimulated_frames;
+    uint64_t resimulated_cycles; // instructions those frames ran again
+    uint64_t stalls;             // frames we had to wait because the remote fell too far behind
+    uint32_t max_rollback;       // deepest rollback seen [frames]
+    double rollbacks_per_sec;    // over the last full second
+    double resimulated_per_sec;
+};
+
+class NetplaySession {
+    Chip8 *_chip8;
+    int _ipf;
+
+    NetServer *_server;
+    int _client_id;
+    NetClient *_client;
+    bool _connected;
+
+    Chip8Snapshot _snapshots[NETPLAY_RING]; // state at the start of frame f
+    uint16_t _local[NETPLAY_RING];
+    uint16_t _remote[NETPLAY_RING];
+    uint16_t _used_remote[NETPLAY_RING]; // what the frame was simulated with
+    uint32_t _frame;                     // next frame to simulate
+    uint32_t _remote_frame;              // remote input is known for frames < _remote_frame
+    uint16_t _last_remote;
+    int64_t _rollback_from;              // -1 = nothing mispredicted
+
+    uint8_t _rx[NETPLAY_PACKET_SIZE];
+    int _rx_len;
+
+    NetplayStats _stats;
+    Timer _rate_timer;
+    uint64_t _rate_rollbacks, _rate_resimulated;
+
+    void _send(uint32_t frame, uint16_t keys);
+    void _receive(const char *data, int len);
+    void _poll();
+    void _resolve_rollback();
+    uint16_t _remote_for(uint32_t frame);
+
+public:
+    NetplaySession(Chip8 &, int ipf = CHIP8_DEFAULT_IPF);
+
+    void host(NetServer *, int client_id);
+    void join(NetClient *);
+
+    bool advance(uint16_t local_keys); // simulates one frame; false = stalled, call again next frame
+    void sync();                       // apply any input that arrived without advancing
+
+    uint32_t frame() const { return _frame; }
+    uint32_t confirmed_frame() const { return _remote_frame < _frame ? _remote_frame : _frame; }
+    bool connected() const { return _connected; }
+    NetplayStats stats();
+};
+
+#include "netplay.cpp"
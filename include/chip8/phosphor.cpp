@@ -0,0 +1,94 @@
+#include "phosphor.h"
+
+Phosphor::Phosphor(int w, int h) {
+    set_size(w, h);
+    set_decay(0.);
+    set_rise(255);
+    set_colour(255, 255, 255);
+}
+
+void Phosphor::set_size(int w, int h) {
+    if (w > PHOSPHOR_MAX_WIDTH) w = PHOSPHOR_MAX_WIDTH;
+    if (h > PHOSPHOR_MAX_HEIGHT) h = PHOSPHOR_MAX_HEIGHT;
+    _w = w & ~7; // whole bytes of the 1bpp source
+    _h = h;
+    reset();
+}
+
+void Phosphor::set_decay(double keep) {
+    if (keep < 0.) keep = 0.;
+    if (keep > 1.) keep = 1.;
+    _decay = (uint16_t)(keep * 256. + .5);
+}
+
+void Phosphor::set_rise(uint8_t rise) {
+    _rise = rise;
+}
+
+void Phosphor::set_colour(uint8_t r, uint8_t g, uint8_t b, uint8_t bg_r, uint8_t bg_g, uint8_t bg_b) {
+    for (int i = 0; i < 256; ++i) {
+        uint32_t pr = bg_r + ((r - bg_r) * i) / 255;
+        uint32_t pg = bg_g + ((g - bg_g) * i) / 255;
+        uint32_t pb = bg_b + ((b - bg_b) * i) / 255;
+        _palette[i] = 0xFF000000 | (pr << 16) | (pg << 8) | pb;
+    }
+}
+
+void Phosphor::reset() {
+    memset(_intensity, 0, PHOSPHOR_MAX_PIXELS);
+}
+
+void Phosphor::_update_row_scalar(const uint8_t *bits, uint8_t *row, int from, int to) {
+    for (int x = from; x < to; ++x) {
+        bool lit = bits[x >> 3] & (0x80 >> (x & 7));
+        if (lit) {
+            int v = row[x] + _rise;
+            row[x] = v > 255 ? 255 : v;
+        } else {
+            row[x] = (row[x] * _decay) >> 8;
+        }
+    }
+}
+
+void Phosphor::update(const uint8_t *bits) {
+    const int row_bytes = _w / 8;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i decay = _mm_set1_epi16(_decay);
+    const __m128i rise = _mm_set1_epi8((char)_rise);
+    const __m128i select = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128);
+
+    for (int y = 0; y < _h; ++y, bits += row_bytes) {
+        uint8_t *row = _intensity + y * _w;
+        int x = 0;
+        for (; x + 16 <= _w; x += 16) {
+            // 2 source bytes -> 16 lanes of 0x00/0xFF
+            __m128i m = _mm_unpacklo_epi64(_mm_set1_epi8((char)bits[x >> 3]), _mm_set1_epi8((char)bits[(x >> 3) + 1]));
+            __m128i lit = _mm_cmpeq_epi8(_mm_and_si128(m, select), select);
+
+            __m128i v = _mm_loadu_si128((const __m128i *)(row + x));
+            __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), decay), 8);
+            __m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), decay), 8);
+            __m128i faded = _mm_packus_epi16(lo, hi);
+            __m128i risen = _mm_adds_epu8(v, rise);
+
+            v = _mm_or_si128(_mm_and_si128(lit, risen), _mm_andnot_si128(lit, faded));
+            _mm_storeu_si128((__m128i *)(row + x), v);
+        }
+        _update_row_scalar(bits, row, x, _w);
+    }
+#else
+    for (int y = 0; y < _h; ++y, bits += row_bytes)
+        _update_row_scalar(bits, _intensity + y * _w, 0, _w);
+#endif
+}
+
+void Phosphor::expand_argb(void *pixels, int pitch) const {
+    const uint8_t *src = _intensity;
+    for (int y = 0; y < _h; ++y, src += _w) {
+        uint32_t *dst = (uint32_t *)((uint8_t *)pixels + y * pitch);
+        for (int x = 0; x < _w; ++x)
+            dst[x] = _palette[src[x]];
+    }
+}
@@ -0,0 +1,46 @@
+/* Phosphor persistence filter for the Chip-8 display.
+
+   Keeps one 8-bit intensity per pixel: lit pixels saturate towards 255,
+   unlit ones decay by a constant factor each frame. This hides the flicker
+   caused by XOR-erase + redraw of sprites.
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define PHOSPHOR_MAX_WIDTH 128
+#define PHOSPHOR_MAX_HEIGHT 64
+#define PHOSPHOR_MAX_PIXELS (PHOSPHOR_MAX_WIDTH * PHOSPHOR_MAX_HEIGHT)
+
+class Phosphor {
+    alignas(16) uint8_t _intensity[PHOSPHOR_MAX_PIXELS];
+    uint32_t _palette[256]; // intensity -> ARGB8888
+    int _w, _h;
+    uint16_t _decay; // 8.8 fixed point, 0 = instant off, 256 = never fades
+    uint8_t _rise;   // added to a lit pixel each frame (saturating)
+
+    void _update_row_scalar(const uint8_t *bits, uint8_t *row, int from, int to);
+
+public:
+    Phosphor(int w = 64, int h = 32);
+
+    void set_size(int w, int h);
+    void set_decay(double); // fraction of intensity kept per frame [0, 1]
+    void set_rise(uint8_t);
+    void set_colour(uint8_t r, uint8_t g, uint8_t b, uint8_t bg_r = 0, uint8_t bg_g = 0, uint8_t bg_b = 0);
+    void reset();
+
+    void update(const uint8_t *bits); // 1bpp, MSB = leftmost pixel, rows of w/8 bytes
+    void expand_argb(void *pixels, int pitch) const; // e.g. from SDL_LockTexture on an ARGB8888 streaming texture
+
+    const uint8_t *intensity() const { return _intensity; }
+    int width() const { return _w; }
+    int height() const { return _h; }
+};
+
+#include "phosphor.cpp"
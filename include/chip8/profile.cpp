@@ -0,0 +1,45 @@
+#include "profile.h"
+
+static const char *profile_class_names[16] = {
+    "0 CLS/RET", "1 JP", "2 CALL", "3 SE byte", "4 SNE byte", "5 SE reg", "6 LD byte", "7 ADD byte",
+    "8 ALU", "9 SNE reg", "A LD I", "B JP V0", "C RND", "D DRW", "E SKP/SKNP", "F timers/mem"};
+
+void chip8_profile_report(const Chip8Profile &p, const Chip8Memory &memory, ostream &out, int top) {
+    char line[128];
+    if (!chip8_profiling) {
+        out << "Profile: built without CHIP8_PROFILE=1, nothing was counted\n";
+        return;
+    }
+    if (p.total == 0) {
+        out << "Profile: no instructions executed\n";
+        return;
+    }
+
+    vector<uint16_t> hot;
+    for (int a = 0; a < CHIP8_MEMORY_SIZE; ++a)
+        if (p.pc[a] != 0) hot.push_back(a);
+    if ((int)hot.size() > top) {
+        partial_sort(hot.begin(), hot.begin() + top, hot.end(), [&](uint16_t a, uint16_t b) { return p.pc[a] > p.pc[b]; });
+        hot.resize(top);
+    } else {
+        sort(hot.begin(), hot.end(), [&](uint16_t a, uint16_t b) { return p.pc[a] > p.pc[b]; });
+    }
+
+    snprintf(line, sizeof(line), "Profile: %llu instructions\n  addr    share       count  op    disassembly\n", (unsigned long long)p.total);
+    out << line;
+    for (uint16_t a : hot) {
+        uint16_t opcode = (memory[a] << 8) | memory[a + 1];
+        char text[32];
+        chip8_disassemble(opcode, text, sizeof(text));
+        bool spin = ((opcode >> 12) == 0x1 && (opcode & 0x0FFF) == a) || (opcode & 0xF0FF) == 0xF00A;
+        snprintf(line, sizeof(line), "  0x%03X %6.2f%% %11u  %04X  %s%s\n", a, 100. * p.pc[a] / p.total, p.pc[a], opcode, text, spin ? "  <- spin" : "");
+        out << line;
+    }
+
+    out << "  by class:\n";
+    for (int c = 0; c < 16; ++c) {
+        if (p.op_class[c] == 0) continue;
+        snprintf(line, sizeof(line), "    %-14s %6.2f%% %11llu\n", profile_class_names[c], 100. * p.op_class[c] / p.total, (unsigned long long)p.op_class[c]);
+        out << line;
+    }
+}
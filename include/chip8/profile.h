@@ -0,0 +1,24 @@
+/* Guest code profiler report.
+
+   Chip8::set_profile() points the interpreter at a Chip8Profile; when built
+   with CHIP8_PROFILE=1 every dispatched instruction bumps the counter of its
+   address and of its opcode class. The report lists the hottest addresses
+   with their disassembly and share of all executed instructions, then the
+   class breakdown. A jump to itself (the usual "wait here" idiom) or a key
+   wait is marked as a spin.
+*/
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <vector>
+#include "chip8.h"
+#include "disasm.h"
+
+#define PROFILE_DEFAULT_TOP 20
+
+void chip8_profile_report(const Chip8Profile &, const Chip8Memory &, ostream &, int top = PROFILE_DEFAULT_TOP);
+
+#include "profile.cpp"
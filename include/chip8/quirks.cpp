@@ -0,0 +1,204 @@
+#include "quirks.h"
+
+static const struct {
+    const char *name;
+    uint32_t bit;
+} quirk_names[] = {
+    {"shift_vy", CHIP8_QUIRK_SHIFT_VY},
+    {"memory_inc", CHIP8_QUIRK_MEMORY_INC},
+    {"vf_reset", CHIP8_QUIRK_VF_RESET},
+    {"jump_vx", CHIP8_QUIRK_JUMP_VX},
+};
+
+// what each variant's reference interpreter does
+static const uint32_t variant_quirks[] = {
+    CHIP8_QUIRK_SHIFT_VY | CHIP8_QUIRK_MEMORY_INC | CHIP8_QUIRK_VF_RESET, // COSMAC VIP
+    CHIP8_QUIRK_JUMP_VX,                                                  // SCHIP 1.1
+    CHIP8_QUIRK_SHIFT_VY | CHIP8_QUIRK_MEMORY_INC,                        // Octo
+};
+
+bool chip8_parse_quirks(const char *text, uint32_t &quirks) {
+    quirks = 0;
+    if (strcmp(text, "none") == 0 || strcmp(text, "-") == 0) return true;
+    const char *p = text;
+    while (*p) {
+        const char *end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        bool found = false;
+        for (auto &q : quirk_names)
+            if (strlen(q.name) == len && strncmp(p, q.name, len) == 0) {
+                quirks |= q.bit;
+                found = true;
+            }
+        if (!found) return false;
+        p += len + (end != nullptr);
+    }
+    return true;
+}
+
+std::string chip8_quirk_names(uint32_t quirks) {
+    std::string s;
+    for (auto &q : quirk_names)
+        if (quirks & q.bit) s += (s.empty() ? "" : ",") + std::string(q.name);
+    return s.empty() ? "none" : s;
+}
+
+const char *chip8_variant_name(Chip8Variant v) {
+    static const char *names[] = {"chip8", "schip", "xochip"};
+    return names[v];
+}
+
+static bool quirks_is_schip(uint16_t op) {
+    if ((op & 0xFFF0) == 0x00C0 || (op >= 0x00FB && op <= 0x00FF)) return true;
+    if ((op & 0xF000) == 0xF000 && ((op & 0xFF) == 0x30 || (op & 0xFF) == 0x75 || (op & 0xFF) == 0x85)) return true;
+    return false;
+}
+
+static bool quirks_is_xochip(uint16_t op) {
+    if ((op & 0xFFF0) == 0x00D0) return true;
+    if ((op & 0xF00F) == 0x5002 || (op & 0xF00F) == 0x5003) return true;
+    if (op == 0xF000 || op == 0xF002 || (op & 0xF0FF) == 0xF001 || (op & 0xF0FF) == 0xF03A) return true;
+    return false;
+}
+
+// does the instruction read VF
+static bool quirks_reads_vf(uint16_t op) {
+    int x = (op >> 8) & 0xF, y = (op >> 4) & 0xF, n = op & 0xF;
+    switch (op >> 12) {
+        case 0x3: case 0x4: case 0x7: case 0xE: return x == 0xF;
+        case 0x5: case 0x9: case 0xD: return x == 0xF || y == 0xF;
+        case 0x8: return y == 0xF || (x == 0xF && n != 0);
+        case 0xF: return x == 0xF;
+    }
+    return false;
+}
+
+// does it write VF without reading it
+static bool quirks_writes_vf(uint16_t op) {
+    int x = (op >> 8) & 0xF, n = op & 0xF;
+    switch (op >> 12) {
+        case 0x6: case 0xC: return x == 0xF;
+        case 0x8: return n >= 4 || (x == 0xF && n == 0);
+        case 0xD: return true;
+        case 0xF: return (op & 0xFF) == 0x65 && x == 0xF;
+    }
+    return false;
+}
+
+static bool quirks_uses_i(uint16_t op) {
+    if ((op >> 12) == 0xD) return true;
+    if ((op >> 12) != 0xF) return false;
+    int nn = op & 0xFF;
+    return nn == 0x33 || nn == 0x55 || nn == 0x65 || nn == 0x1E;
+}
+
+QuirkGuess chip8_detect_quirks(const uint8_t *rom, size_t size) {
+    QuirkGuess g;
+    g.variant = CHIP8_VARIANT_CHIP8;
+    g.quirks = 0;
+    g.confidence = 1.;
+    g.unsupported = false;
+
+    uint8_t memory[CHIP8_MEMORY_SIZE] = {0};
+    size_t n = size < CHIP8_MEMORY_SIZE - CHIP8_PC_OFFSET ? size : CHIP8_MEMORY_SIZE - CHIP8_PC_OFFSET;
+    memcpy(memory + CHIP8_PC_OFFSET, rom, n);
+    auto word = [&](int a) { return (uint16_t)(memory[a & 0x0FFF] << 8 | memory[(a + 1) & 0x0FFF]); };
+    auto clause = [&](const std::string &s) { g.reasons += (g.reasons.empty() ? "" : "; ") + s; };
+
+    Chip8CFG *cfg = new Chip8CFG; // 16 KB of tables
+    cfg->analyze(rom, n);
+
+    // variant: extension opcodes where a reached path stops
+    int schip = 0, xochip = 0;
+    if (!cfg->is_code(CHIP8_PC_OFFSET)) { // the very first instruction already is one
+        schip += quirks_is_schip(word(CHIP8_PC_OFFSET));
+        xochip += quirks_is_xochip(word(CHIP8_PC_OFFSET));
+    }
+    for (const CfgBlock &b : cfg->blocks()) {
+        if (b.exit != CFG_HALT || b.end >= CHIP8_MEMORY_SIZE - 1) continue;
+        uint16_t op = word(b.end);
+        schip += quirks_is_schip(op);
+        xochip += quirks_is_xochip(op);
+    }
+    int dxy0 = 0;
+    for (int a = 0; a < CHIP8_MEMORY_SIZE; ++a)
+        if (cfg->is_code(a) && (word(a) & 0xF00F) == 0xD000) ++dxy0; // draws nothing on CHIP-8, 16x16 on SCHIP
+    if (size > CHIP8_MEMORY_SIZE - CHIP8_PC_OFFSET) {
+        g.variant = CHIP8_VARIANT_XOCHIP;
+        clause("larger than 3.5 KB");
+    } else if (xochip > 0) {
+        g.variant = CHIP8_VARIANT_XOCHIP;
+        clause(std::to_string(xochip) + " XO-CHIP opcode(s) on reached paths");
+    } else if (schip > 0 || dxy0 > 0) {
+        g.variant = CHIP8_VARIANT_SCHIP;
+        clause(std::to_string(schip + dxy0) + " SCHIP opcode(s) on reached paths");
+    } else {
+        g.confidence *= .9; // SCHIP programs that do not need its opcodes look the same
+    }
+    g.unsupported = g.variant != CHIP8_VARIANT_CHIP8;
+    uint32_t defaults = variant_quirks[g.variant];
+
+    auto decide = [&](uint32_t bit, const char *name, int on, int off, bool relevant) {
+        if (!relevant) return; // behaves the same either way: leave it off
+        if (on + off == 0) {
+            g.quirks |= defaults & bit;
+            g.confidence *= .6;
+            clause(std::string(name) + " matters, " + ((defaults & bit) ? "on" : "off") + " by variant default");
+            return;
+        }
+        bool set = on > off || (on == off && (defaults & bit));
+        if (set) g.quirks |= bit;
+        g.confidence *= (double)(set ? on : off) / (on + off);
+        clause(std::string(name) + (set ? " on" : " off") + " (" + std::to_string(on) + " for, " + std::to_string(off) + " against)");
+    };
+
+    int shift_vy = 0, shift_in_place = 0;
+    int mem_walk = 0, mem_stay = 0;
+    int jump_vx = 0, jump_v0 = 0;
+    bool mem_relevant = false, vf_relevant = false, jump_relevant = false;
+    for (const CfgBlock &b : cfg->blocks()) {
+        int last_mem = 0;      // FX55/FX65 low byte whose I has not been reloaded since, or 0
+        bool logic_vf = false; // VF holds what a logic op left there
+        uint16_t written = 0;  // V registers set in this block so far
+        for (int a = b.start; a < b.end; a += 2) {
+            uint16_t op = word(a);
+            int x = (op >> 8) & 0xF, y = (op >> 4) & 0xF, k = op & 0xF;
+
+            if ((op >> 12) == 0x8 && (k == 0x6 || k == 0xE) && x != y) {
+                if (y == 0) ++shift_in_place; // "SHR Vx"
+                else ++shift_vy;
+            }
+            if ((op >> 12) == 0xB && x != 0) { // the register set just before is the one meant
+                jump_relevant = true;
+                bool v0 = written & 1, vx = (written >> x) & 1;
+                if (v0 != vx) ++(vx ? jump_vx : jump_v0);
+            }
+            if ((op >> 12) == 0x6 || (op >> 12) == 0x7 || (op >> 12) == 0xC || ((op >> 12) == 0x8 && k != 0)) written |= 1 << x;
+
+            if (logic_vf && quirks_reads_vf(op)) vf_relevant = true;
+            if (quirks_writes_vf(op)) logic_vf = false;
+            if ((op >> 12) == 0x8 && k >= 1 && k <= 3) logic_vf = true;
+
+            // walking: the same block op again, or a draw/BCD through the advanced I;
+            // staying: read back what was stored, store what was loaded, or FX1E
+            if ((op >> 12) == 0xA || (op & 0xF0FF) == 0xF029) last_mem = 0; // I reloaded
+            else if (quirks_uses_i(op)) {
+                int nn = op & 0xFF;
+                if (last_mem != 0) {
+                    mem_relevant = true;
+                    if (nn == 0x1E || ((op >> 12) == 0xF && (nn == 0x55 || nn == 0x65) && nn != last_mem)) ++mem_stay;
+                    else ++mem_walk;
+                }
+                last_mem = (op >> 12) == 0xF && (nn == 0x55 || nn == 0x65) ? nn : 0;
+            }
+        }
+    }
+    decide(CHIP8_QUIRK_SHIFT_VY, "shift_vy", shift_vy, shift_in_place, shift_vy + shift_in_place > 0);
+    decide(CHIP8_QUIRK_MEMORY_INC, "memory_inc", mem_walk, mem_stay, mem_relevant);
+    decide(CHIP8_QUIRK_VF_RESET, "vf_reset", 0, 0, vf_relevant);
+    decide(CHIP8_QUIRK_JUMP_VX, "jump_vx", jump_vx, jump_v0, jump_relevant);
+    if (g.reasons.empty()) clause("no variant-specific behaviour reached");
+
+    delete cfg;
+    return g;
+}
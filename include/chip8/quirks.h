@@ -0,0 +1,50 @@
+/* Quirk and variant detection from the ROM bytes.
+
+   Runs Chip8CFG over the ROM and looks only at reached code:
+
+   - variant: any SCHIP or XO-CHIP opcode on a reached path (the analyzer
+     stops at the first one, which is enough), or a ROM too big for 4 KB.
+   - a quirk is only turned on where it can change what the program does;
+     everything else stays 0, which is the fastest instantiation and the
+     one the core runs without quirks. Shifts with Vy == Vx, BNNN with
+     X == 0 and FX55/FX65 whose I is reloaded before its next use behave the
+     same either way.
+   - shift: "SHR Vx" written with Vy = 0 means in place, a distinct Vy means
+     Vy was meant; the majority wins.
+   - memory: FX55/FX65 followed in its block, without reloading I, by the
+     same opcode again, FX33 or DXYN expects I to advance; a store read back,
+     a load stored again (read-modify-write) or FX1E expects it to stay.
+   - jump: BXNN with X != 0 after a block that set VX but not V0 means VX,
+     the other way round V0.
+   - VF reset has no idiom to go by: when the program reads VF after a logic
+     op, the variant's default applies (as for any quirk without votes).
+
+   Confidence is the product of every decision's share of its evidence
+   (0.6 for a bare default). An explicit profile (ROM database, --quirks)
+   should win over a guess.
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "chip8.h"
+#include "cfg.h"
+
+struct QuirkGuess {
+    Chip8Variant variant;
+    uint32_t quirks;      // CHIP8_QUIRK_*
+    double confidence;    // 0..1
+    bool unsupported;     // needs SCHIP/XO-CHIP opcodes, which Chip8 does not execute
+    std::string reasons;  // one clause per decision
+};
+
+QuirkGuess chip8_detect_quirks(const uint8_t *rom, size_t size);
+
+// "none" or comma-separated shift_vy, memory_inc, vf_reset, jump_vx
+bool chip8_parse_quirks(const char *text, uint32_t &quirks);
+std::string chip8_quirk_names(uint32_t quirks);
+const char *chip8_variant_name(Chip8Variant);
+
+#include "quirks.cpp"
@@ -0,0 +1,74 @@
+#include "runahead.h"
+
+RunAhead::RunAhead(int frames) {
+    set_frames(frames);
+    _speculative = 0;
+    memset(_display, 0, CHIP8_DISPLAY_BUFFER_SIZE);
+}
+
+void RunAhead::set_frames(int frames) {
+    if (frames < 0) frames = 0;
+    if (frames > RUNAHEAD_MAX_FRAMES) frames = RUNAHEAD_MAX_FRAMES;
+    _frames = frames;
+}
+
+const uint8_t *RunAhead::run_frame(Chip8 &chip8, uint16_t keys, int ipf) {
+    chip8.set_keys(keys);
+    chip8.run_frame(ipf);
+    if (_frames == 0) return chip8.get_display_buffer();
+
+    chip8.save_state(_saved);
+    uint64_t before = chip8.cycles();
+    for (int i = 0; i < _frames; ++i)
+        chip8.run_frame(ipf);
+    _speculative += chip8.cycles() - before;
+    memcpy(_display, chip8.get_display_buffer(), CHIP8_DISPLAY_BUFFER_SIZE);
+    chip8.load_state(_saved);
+    return _display;
+}
+
+// ------------------------ latency -------------------------
+InputLatency::InputLatency() {
+    _pending = false;
+    _prev_keys = 0;
+    _count = 0;
+    memset(_ref, 0, CHIP8_DISPLAY_BUFFER_SIZE);
+}
+
+void InputLatency::on_input(uint16_t keys, const uint8_t *shown_display) {
+    uint16_t pressed = keys & ~_prev_keys;
+    _prev_keys = keys;
+    if (!pressed || _pending) return;
+
+    _pending = true;
+    memcpy(_ref, shown_display, CHIP8_DISPLAY_BUFFER_SIZE);
+    _t.interval();
+}
+
+void InputLatency::on_present(const uint8_t *display) {
+    if (!_pending) return;
+    double dt = _t.getTime();
+    if (memcmp(display, _ref, CHIP8_DISPLAY_BUFFER_SIZE) == 0) {
+        if (dt > LATENCY_TIMEOUT) _pending = false;
+        return;
+    }
+    _samples[_count % LATENCY_SAMPLES] = dt;
+    ++_count;
+    _pending = false;
+}
+
+LatencyStats InputLatency::stats() const {
+    LatencyStats s = {0, 0, 0, 0, _count};
+    if (_count == 0) return s;
+
+    uint32_t n = _count < LATENCY_SAMPLES ? _count : LATENCY_SAMPLES;
+    s.last = _samples[(_count - 1) % LATENCY_SAMPLES];
+    s.min = s.max = s.last;
+    for (uint32_t i = 0; i < n; ++i) {
+        s.avg += _samples[i];
+        if (_samples[i] < s.min) s.min = _samples[i];
+        if (_samples[i] > s.max) s.max = _samples[i];
+    }
+    s.avg /= n;
+    return s;
+}
@@ -0,0 +1,58 @@
+/* Run-ahead input latency reduction.
+
+   Each frame the real machine advances one frame with the current keys, then
+   its state is saved, N more frames are emulated with the same keys, that
+   future frame is what gets presented, and the state is restored. A ROM that
+   reacts to input a few frames late therefore shows the reaction N frames
+   sooner.
+
+   InputLatency measures the time from a new key press to the first presented
+   frame that differs from what was on screen when the key went down.
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include "chip8.h"
+#include "mega_utils/timer.h"
+
+#define RUNAHEAD_MAX_FRAMES 8
+#define LATENCY_SAMPLES 64
+#define LATENCY_TIMEOUT 0.5 // presses that change nothing on screen for this long are ignored [s]
+
+class RunAhead {
+    Chip8Snapshot _saved;
+    uint8_t _display[CHIP8_DISPLAY_BUFFER_SIZE];
+    int _frames;
+    uint64_t _speculative; // instructions run in frames that were thrown away
+
+public:
+    RunAhead(int frames = 1);
+    void set_frames(int);
+    int frames() const { return _frames; }
+    uint64_t speculative_cycles() const { return _speculative; } // part of Chip8::cycles() that never became a real frame
+
+    const uint8_t *run_frame(Chip8 &, uint16_t keys, int ipf = CHIP8_DEFAULT_IPF); // returns the display to present
+};
+
+struct LatencyStats {
+    double last, avg, min, max; // [s]
+    uint32_t samples;
+};
+
+class InputLatency {
+    Timer _t;
+    bool _pending;
+    uint16_t _prev_keys;
+    uint8_t _ref[CHIP8_DISPLAY_BUFFER_SIZE];
+    double _samples[LATENCY_SAMPLES];
+    uint32_t _count;
+
+public:
+    InputLatency();
+    void on_input(uint16_t keys, const uint8_t *shown_display); // before emulating the frame
+    void on_present(const uint8_t *display);                    // right after the frame was presented
+    LatencyStats stats() const;
+};
+
+#include "runahead.cpp"
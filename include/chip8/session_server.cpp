@@ -0,0 +1,497 @@
+#include "session_server.h"
+
+static void session_raise_fd_limit() {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+// ------------------------ worker -------------------------
+SessionWorker::SessionWorker() {
+    _running = nullptr;
+    sessions = active = frames = dropped = bytes_sent = 0;
+    worst_tick_ns = 0;
+}
+
+void SessionWorker::start(std::atomic<bool> *running) {
+    _running = running;
+    _thread = std::thread(&SessionWorker::_loop, this);
+}
+
+void SessionWorker::join() {
+    if (_thread.joinable()) _thread.join();
+}
+
+void SessionWorker::post(SessionCommand c) {
+    std::lock_guard<std::mutex> lock(_inbox_mutex);
+    _inbox.push_back(std::move(c));
+}
+
+void SessionWorker::_handle(SessionCommand &c) {
+    Session *s = c.session;
+    if (c.type == SessionCommand::START) {
+        if (s->dead) return;
+        s->chip8 = Chip8();
+        if (!s->chip8.load_rom(c.rom.data(), c.rom.size())) return;
+        s->chip8.start_execution();
+        s->frame = 0; // sent_display stays: the client still shows the last ROM's screen
+        if (s->queue_index < 0) {
+            s->queue_index = _queue.size();
+            _queue.push_back(s);
+            ++active;
+        }
+        return;
+    }
+
+    // CLOSE: the epoll thread already forgot this fd, so closing it here cannot race with a reused fd number
+    if (s->queue_index >= 0) {
+        Session *last = _queue.back();
+        _queue[s->queue_index] = last;
+        last->queue_index = s->queue_index;
+        _queue.pop_back();
+        --active;
+    }
+    close(s->fd);
+    delete s;
+    --sessions;
+}
+
+void SessionWorker::_flush(Session *s) {
+    while (s->out_len > 0) {
+        ssize_t n = send(s->fd, s->out, s->out_len, MSG_NOSIGNAL);
+        if (n > 0) {
+            bytes_sent += n;
+            s->out_len -= n;
+            memmove(s->out, s->out + n, s->out_len);
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        s->dead = true;
+        return;
+    }
+}
+
+void SessionWorker::_emit(Session *s) {
+    if (s->out_len > 0) {
+        _flush(s);
+        if (s->out_len > 0) { // client is not keeping up, skip this frame
+            ++dropped;
+            return;
+        }
+    }
+
+    const uint8_t *display = s->chip8.get_display_buffer();
+    uint8_t delta[CHIP8_DISPLAY_BUFFER_SIZE];
+    uint8_t any = 0;
+    for (int i = 0; i < CHIP8_DISPLAY_BUFFER_SIZE; ++i) {
+        delta[i] = display[i] ^ s->sent_display[i];
+        any |= delta[i];
+    }
+    if (any) {
+        uint8_t *p = s->out + s->out_len;
+        int len = spectate_rle_encode(delta, CHIP8_DISPLAY_BUFFER_SIZE, p + 7);
+        p[0] = 'D';
+        p[1] = s->frame & 0xFF;
+        p[2] = (s->frame >> 8) & 0xFF;
+        p[3] = (s->frame >> 16) & 0xFF;
+        p[4] = s->frame >> 24;
+        p[5] = len & 0xFF;
+        p[6] = len >> 8;
+        s->out_len += 7 + len;
+        memcpy(s->sent_display, display, CHIP8_DISPLAY_BUFFER_SIZE);
+    }
+
+    bool sound = s->chip8.sound_on();
+    if (sound != s->sent_sound) {
+        s->out[s->out_len++] = 'S';
+        s->out[s->out_len++] = sound;
+        s->sent_sound = sound;
+    }
+    _flush(s);
+}
+
+void SessionWorker::_loop() {
+    using namespace std::chrono;
+    const steady_clock::duration tick = duration_cast<steady_clock::duration>(duration<double>(SESSION_TICK));
+    steady_clock::time_point next = steady_clock::now();
+    std::vector<SessionCommand> commands;
+
+    while (_running->load()) {
+        {
+            std::lock_guard<std::mutex> lock(_inbox_mutex);
+            commands.swap(_inbox);
+        }
+        for (SessionCommand &c : commands)
+            _handle(c);
+        commands.clear();
+
+        steady_clock::time_point t0 = steady_clock::now();
+        for (size_t i = 0; i < _queue.size(); ++i) {
+            Session *s = _queue[i];
+            if (s->dead) continue;
+            s->chip8.set_keys(s->keys.load(std::memory_order_relaxed));
+            s->chip8.run_frame();
+            ++s->frame;
+            _emit(s);
+        }
+        frames += _queue.size();
+
+        uint64_t took = duration_cast<nanoseconds>(steady_clock::now() - t0).count();
+        if (took > worst_tick_ns) worst_tick_ns = took;
+
+        next += tick;
+        steady_clock::time_point now = steady_clock::now();
+        if (next < now) next = now; // overloaded: don't try to catch up
+        std::this_thread::sleep_until(next);
+    }
+
+    // whatever the epoll thread closed last
+    std::lock_guard<std::mutex> lock(_inbox_mutex);
+    for (SessionCommand &c : _inbox)
+        if (c.type == SessionCommand::CLOSE) _handle(c);
+    _inbox.clear();
+}
+
+// ------------------------ server -------------------------
+SessionServer::SessionServer(int workers) {
+    _listen_fd = _epoll_fd = -1;
+    _running = false;
+    memset(_sessions, 0, sizeof(_sessions));
+    _next_worker = 0;
+    if (workers <= 0) workers = std::thread::hardware_concurrency();
+    if (workers <= 0) workers = 1;
+    for (int i = 0; i < workers; ++i)
+        _workers.push_back(new SessionWorker());
+}
+
+SessionServer::~SessionServer() {
+    _running = false;
+    for (SessionWorker *w : _workers)
+        w->join();
+    for (int fd = 0; fd < SESSION_MAX_FDS; ++fd) {
+        if (_sessions[fd] != nullptr) {
+            close(fd);
+            delete _sessions[fd];
+        }
+    }
+    for (SessionWorker *w : _workers)
+        delete w;
+    if (_listen_fd >= 0) close(_listen_fd);
+    if (_epoll_fd >= 0) close(_epoll_fd);
+}
+
+bool SessionServer::init(const char *port) {
+    session_raise_fd_limit();
+
+    struct addrinfo hints, *result = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    hints.ai_flags = AI_PASSIVE;
+    int iResult = getaddrinfo(NULL, port, &hints, &result);
+    if (iResult != 0) {
+        std::cout << "SessionServer::init getaddrinfo failed with error: " << iResult << std::endl;
+        return false;
+    }
+
+    _listen_fd = socket(result->ai_family, result->ai_socktype | SOCK_NONBLOCK, result->ai_protocol);
+    int one = 1;
+    setsockopt(_listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (_listen_fd < 0 || ::bind(_listen_fd, result->ai_addr, result->ai_addrlen) != 0 || listen(_listen_fd, SOMAXCONN) != 0) {
+        std::cout << "SessionServer::init socket/bind/listen failed with error: " << errno << std::endl;
+        freeaddrinfo(result);
+        return false;
+    }
+    freeaddrinfo(result);
+
+    _epoll_fd = epoll_create1(0);
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = _listen_fd;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _listen_fd, &ev);
+
+    _running = true;
+    for (SessionWorker *w : _workers)
+        w->start(&_running);
+    return true;
+}
+
+void SessionServer::_accept() {
+    for (;;) {
+        int fd = accept4(_listen_fd, NULL, NULL, SOCK_NONBLOCK);
+        if (fd < 0) return;
+        if (fd >= SESSION_MAX_FDS) {
+            close(fd);
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        Session *s = new Session();
+        s->fd = fd;
+        s->worker = _next_worker++ % _workers.size();
+        s->keys = 0;
+        s->in_len = 0;
+        s->queue_index = -1;
+        s->dead = false;
+        s->frame = 0;
+        memset(s->sent_display, 0, CHIP8_DISPLAY_BUFFER_SIZE); // a new client starts from a blank screen
+        s->sent_sound = false;
+        s->out_len = 0;
+        _sessions[fd] = s;
+        ++_workers[s->worker]->sessions;
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLET | EPOLLRDHUP;
+        ev.data.fd = fd;
+        epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+bool SessionServer::_parse(Session *s) {
+    int pos = 0;
+    while (pos < s->in_len) {
+        uint8_t *p = s->in + pos;
+        int left = s->in_len - pos;
+        if (p[0] == 'K') {
+            if (left < 3) break;
+            s->keys.store(p[1] | (p[2] << 8), std::memory_order_relaxed);
+            pos += 3;
+        } else if (p[0] == 'L') {
+            if (left < 3) break;
+            int len = p[1] | (p[2] << 8);
+            if (len > CHIP8_MEMORY_SIZE - CHIP8_PC_OFFSET) return false;
+            if (left < 3 + len) break;
+            SessionCommand c;
+            c.type = SessionCommand::START;
+            c.session = s;
+            c.rom.assign(p + 3, p + 3 + len);
+            _workers[s->worker]->post(std::move(c));
+            pos += 3 + len;
+        } else {
+            return false;
+        }
+    }
+    memmove(s->in, s->in + pos, s->in_len - pos);
+    s->in_len -= pos;
+    return true;
+}
+
+void SessionServer::_read(Session *s) {
+    for (;;) { // edge triggered: drain the socket
+        ssize_t n = recv(s->fd, s->in + s->in_len, SESSION_IN_BUF - s->in_len, 0);
+        if (n > 0) {
+            s->in_len += n;
+            if (!_parse(s) || s->in_len == SESSION_IN_BUF) {
+                _close(s);
+                return;
+            }
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        _close(s);
+        return;
+    }
+}
+
+void SessionServer::_close(Session *s) {
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, s->fd, NULL);
+    _sessions[s->fd] = nullptr;
+    SessionCommand c;
+    c.type = SessionCommand::CLOSE;
+    c.session = s;
+    _workers[s->worker]->post(std::move(c));
+}
+
+void SessionServer::run() {
+    struct epoll_event events[256];
+    while (_running) {
+        int n = epoll_wait(_epoll_fd, events, 256, 100);
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == _listen_fd) {
+                _accept();
+                continue;
+            }
+            Session *s = _sessions[fd];
+            if (s == nullptr) continue;
+            if (events[i].events & EPOLLIN)
+                _read(s); // also sees EOF
+            else if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP))
+                _close(s);
+        }
+    }
+}
+
+SessionStats SessionServer::stats() {
+    SessionStats st;
+    memset(&st, 0, sizeof(st));
+    for (SessionWorker *w : _workers) {
+        st.connections += w->sessions;
+        st.active += w->active;
+        st.frames += w->frames;
+        st.dropped += w->dropped;
+        st.bytes_sent += w->bytes_sent;
+        double worst = w->worst_tick_ns * 1e-9;
+        if (worst > st.worst_tick) st.worst_tick = worst;
+    }
+    return st;
+}
+
+// ------------------------ load generator -------------------------
+struct LoadConn {
+    int fd;
+    bool active;
+    uint8_t hdr[7];
+    int hdr_len;
+    int want, got; // 'D' payload bytes
+    uint8_t payload[SPECTATE_MAX_PACKET];
+    uint8_t display[CHIP8_DISPLAY_BUFFER_SIZE]; // what the server's deltas add up to
+};
+
+int session_loadgen(const char *server, int idle, int active, int seconds) {
+    static const uint8_t rom[] = {
+        0xA2, 0x08, // I = sprite
+        0xD0, 0x11, // loop: draw 8x1 at V0, V0
+        0x70, 0x01, // V0 += 1
+        0x12, 0x02, // goto loop
+        0xF0, 0x00, // sprite
+    };
+    session_raise_fd_limit();
+
+    // the ROM ignores keys, so frame f of every session looks the same
+    Chip8 reference;
+    reference.load_rom(rom, sizeof(rom));
+    reference.start_execution();
+    std::vector<uint8_t> history(reference.get_display_buffer(), reference.get_display_buffer() + CHIP8_DISPLAY_BUFFER_SIZE);
+    auto reference_at = [&](uint32_t frame) {
+        while (history.size() / CHIP8_DISPLAY_BUFFER_SIZE <= frame) {
+            reference.run_frame();
+            history.insert(history.end(), reference.get_display_buffer(), reference.get_display_buffer() + CHIP8_DISPLAY_BUFFER_SIZE);
+        }
+        return history.data() + (size_t)frame * CHIP8_DISPLAY_BUFFER_SIZE;
+    };
+    auto send_rom = [](int fd) {
+        uint8_t hdr[3] = {'L', (uint8_t)(sizeof(rom) & 0xFF), (uint8_t)(sizeof(rom) >> 8)};
+        send(fd, hdr, 3, MSG_NOSIGNAL);
+        send(fd, rom, sizeof(rom), MSG_NOSIGNAL);
+    };
+
+    struct addrinfo hints, *result = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(server, SESSION_PORT, &hints, &result) != 0) {
+        std::cout << "session_loadgen: cannot resolve " << server << "\n";
+        return 1;
+    }
+
+    int ep = epoll_create1(0);
+    std::vector<LoadConn> conns(idle + active);
+    int open = 0;
+    for (; open < idle + active; ++open) {
+        int fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+        if (fd < 0 || connect(fd, result->ai_addr, result->ai_addrlen) != 0) {
+            std::cout << "session_loadgen: connection " << open << " failed (errno " << errno << ")\n";
+            if (fd >= 0) close(fd);
+            break;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        LoadConn &c = conns[open];
+        memset(&c, 0, sizeof(c));
+        c.fd = fd;
+        c.active = open >= idle;
+        if (c.active) send_rom(fd);
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = open;
+        epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+    }
+    conns.resize(open);
+    freeaddrinfo(result);
+    std::cout << "session_loadgen: " << conns.size() << " connections open\n";
+
+    uint64_t frames = 0, bytes = 0, total_frames = 0, mismatches = 0;
+    bool reloaded = false;
+    Timer run_t, report_t, key_t;
+    struct epoll_event events[256];
+    uint8_t buf[16384];
+    while (run_t.getTime() < seconds) {
+        int n = epoll_wait(ep, events, 256, 10);
+        for (int e = 0; e < n; ++e) {
+            LoadConn &c = conns[events[e].data.u32];
+            ssize_t len;
+            while ((len = recv(c.fd, buf, sizeof(buf), 0)) > 0) {
+                bytes += len;
+                for (ssize_t i = 0; i < len;) {
+                    if (c.want > 0) {
+                        int take = c.want - c.got < len - i ? c.want - c.got : len - i;
+                        memcpy(c.payload + c.got, buf + i, take);
+                        c.got += take;
+                        i += take;
+                        if (c.got < c.want) continue;
+                        uint32_t frame = c.hdr[1] | (c.hdr[2] << 8) | (c.hdr[3] << 16) | ((uint32_t)c.hdr[4] << 24);
+                        if (!spectate_rle_xor(c.payload, c.want, c.display, CHIP8_DISPLAY_BUFFER_SIZE)) {
+                            std::cout << "session_loadgen: bad delta\n";
+                            return 1;
+                        }
+                        if (memcmp(c.display, reference_at(frame), CHIP8_DISPLAY_BUFFER_SIZE) != 0) ++mismatches;
+                        c.want = c.got = 0;
+                        ++frames;
+                        continue;
+                    }
+                    c.hdr[c.hdr_len++] = buf[i++];
+                    if (c.hdr[0] == 'S' && c.hdr_len == 2) {
+                        c.hdr_len = 0;
+                    } else if (c.hdr[0] == 'D' && c.hdr_len == 7) {
+                        c.want = c.hdr[5] | (c.hdr[6] << 8);
+                        c.hdr_len = 0;
+                        if (c.want > SPECTATE_MAX_PACKET) {
+                            std::cout << "session_loadgen: bad stream\n";
+                            return 1;
+                        }
+                    } else if (c.hdr[0] != 'S' && c.hdr[0] != 'D') {
+                        std::cout << "session_loadgen: bad stream\n";
+                        return 1;
+                    }
+                }
+            }
+        }
+
+        if (key_t.getTime() > .1) {
+            key_t.interval();
+            for (LoadConn &c : conns) {
+                if (!c.active || rand() % 4) continue;
+                uint16_t keys = rand() & 0xFFFF;
+                uint8_t k[3] = {'K', (uint8_t)(keys & 0xFF), (uint8_t)(keys >> 8)};
+                send(c.fd, k, 3, MSG_NOSIGNAL);
+            }
+        }
+
+        // halfway through, every active session loads the ROM again on top of its current screen
+        if (!reloaded && run_t.getTime() >= seconds / 2.) {
+            reloaded = true;
+            for (LoadConn &c : conns)
+                if (c.active) send_rom(c.fd);
+        }
+
+        double dt = report_t.getTime();
+        if (dt >= 1.) {
+            report_t.interval();
+            std::cout << "session_loadgen: " << frames / dt << " frames/s received, " << bytes / dt / 1024. << " KB/s\n";
+            total_frames += frames;
+            frames = bytes = 0;
+        }
+    }
+
+    for (LoadConn &c : conns)
+        close(c.fd);
+    close(ep);
+    total_frames += frames;
+    std::cout << "session_loadgen: " << total_frames << " frames received in total, " << mismatches
+              << (mismatches == 0 ? " differ from the server's display\n" : " DIFFER from the server's display\n");
+    return mismatches == 0 ? 0 : 1;
+}
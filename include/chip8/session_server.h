@@ -0,0 +1,131 @@
+/* Hosted Chip-8 sessions: one Chip8 per TCP connection (Linux, epoll).
+
+   One thread owns the listening socket and all reads (epoll, edge triggered).
+   Every connection gets a Session pinned to one worker; each worker has its
+   own run queue and runs all of its active sessions once per 60 Hz tick,
+   then sends back the display change (XOR delta, RLE as in spectate.h) and
+   sound on/off edges. Sessions without a ROM never enter a run queue, so idle
+   connections only cost memory.
+
+   NetServer polls every client with recv() and keeps a 64 KB buffer per
+   client, which does not scale to thousands of sockets, so this server keeps
+   its own epoll loop and small per-session buffers.
+
+   client -> server:  'L' len (LE u16) ROM bytes    load ROM and start
+                      'K' keys (LE u16)             keypad mask
+   server -> client:  'D' frame (LE u32) len (LE u16) RLE(XOR delta)
+                      'S' on (u8)                   sound timer edge
+
+   Deltas are against what the client shows, which starts blank and is kept
+   across an 'L' reload; frame numbers count from the last 'L'.
+*/
+
+#pragma once
+#ifdef __linux__
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include "chip8.h"
+#include "spectate.h"
+#include "mega_utils/timer.h"
+
+#define SESSION_PORT "27017"
+#define SESSION_MAX_FDS 65536
+#define SESSION_IN_BUF (3 + CHIP8_MEMORY_SIZE)
+#define SESSION_OUT_BUF 2048
+#define SESSION_TICK (1. / 60.)
+
+struct Session {
+    int fd;
+    int worker;
+    Chip8 chip8;
+    std::atomic<uint16_t> keys;
+
+    // epoll thread only
+    uint8_t in[SESSION_IN_BUF];
+    int in_len;
+
+    // owning worker only
+    int queue_index; // -1 = not running
+    bool dead;       // send failed, waiting for the epoll thread to notice
+    uint32_t frame;
+    uint8_t sent_display[CHIP8_DISPLAY_BUFFER_SIZE]; // what the client has
+    bool sent_sound;
+    uint8_t out[SESSION_OUT_BUF];
+    int out_len;
+};
+
+struct SessionCommand {
+    enum { START, CLOSE } type;
+    Session *session;
+    std::vector<uint8_t> rom;
+};
+
+struct SessionStats {
+    uint64_t connections; // currently open
+    uint64_t active;      // running a ROM
+    uint64_t frames;      // emulated, all sessions
+    uint64_t dropped;     // frames not sent because the client socket was full
+    uint64_t bytes_sent;
+    double worst_tick;    // slowest worker tick [s]
+};
+
+class SessionWorker {
+    std::thread _thread;
+    std::mutex _inbox_mutex;
+    std::vector<SessionCommand> _inbox;
+    std::vector<Session *> _queue;
+    std::atomic<bool> *_running;
+
+    void _loop();
+    void _handle(SessionCommand &);
+    void _emit(Session *);
+    void _flush(Session *);
+
+public:
+    std::atomic<uint64_t> sessions, active, frames, dropped, bytes_sent;
+    std::atomic<uint64_t> worst_tick_ns;
+
+    SessionWorker();
+    void start(std::atomic<bool> *running);
+    void join();
+    void post(SessionCommand);
+};
+
+class SessionServer {
+    int _listen_fd, _epoll_fd;
+    std::atomic<bool> _running;
+    Session *_sessions[SESSION_MAX_FDS]; // by fd
+    std::vector<SessionWorker *> _workers;
+    int _next_worker;
+
+    void _accept();
+    void _read(Session *);
+    void _close(Session *);
+    bool _parse(Session *); // false = protocol error
+
+public:
+    SessionServer(int workers = 0); // 0 = one per core
+    ~SessionServer();
+
+    bool init(const char *port = SESSION_PORT);
+    void run(); // epoll loop, returns after stop()
+    void stop() { _running = false; }
+    SessionStats stats();
+};
+
+// Opens `idle` connections that never send a ROM and `active` ones that run a
+// small drawing ROM with random key presses, reloaded halfway through. Applies
+// the deltas that come back and checks them against a local run of the ROM;
+// returns 1 if any frame differs.
+int session_loadgen(const char *server, int idle, int active, int seconds);
+
+#include "session_server.cpp"
+#endif // __linux__
@@ -0,0 +1,214 @@
+#include "spectate.h"
+
+int spectate_rle_encode(const uint8_t *src, int len, uint8_t *dst) {
+    int i = 0, out = 0;
+    while (i < len) {
+        int zeros = 0;
+        while (i < len && src[i] == 0 && zeros < 255) {
+            ++zeros;
+            ++i;
+        }
+        if (i == len) break; // trailing zeros are implicit
+
+        int start = i, lits = 0;
+        while (i < len && src[i] != 0 && lits < 255) {
+            ++lits;
+            ++i;
+        }
+        dst[out++] = zeros;
+        dst[out++] = lits;
+        memcpy(dst + out, src + start, lits);
+        out += lits;
+    }
+    return out;
+}
+
+bool spectate_rle_xor(const uint8_t *src, int src_len, uint8_t *dst, int dst_len) {
+    int s = 0, pos = 0;
+    while (s + 2 <= src_len) {
+        pos += src[s];
+        int lits = src[s + 1];
+        s += 2;
+        if (pos + lits > dst_len || s + lits > src_len) return false;
+        for (int i = 0; i < lits; ++i)
+            dst[pos + i] ^= src[s + i];
+        pos += lits;
+        s += lits;
+    }
+    return s == src_len;
+}
+
+// ------------------------ broadcaster -------------------------
+SpectatorBroadcaster::SpectatorBroadcaster(NetServer *server) {
+    _server = server;
+    memset(_prev, 0, CHIP8_DISPLAY_BUFFER_SIZE);
+    _frame = 0;
+    _last_keyframe = 0;
+    _last_sent = 0;
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+int SpectatorBroadcaster::_build(SpectatePacketType type, const uint8_t *payload_src) {
+    int payload = 0;
+    if (payload_src != nullptr)
+        payload = spectate_rle_encode(payload_src, CHIP8_DISPLAY_BUFFER_SIZE, _packet + SPECTATE_HEADER_SIZE);
+
+    _packet[0] = 'S';
+    _packet[1] = 'P';
+    _packet[2] = type;
+    _packet[3] = _frame & 0xFF;
+    _packet[4] = (_frame >> 8) & 0xFF;
+    _packet[5] = (_frame >> 16) & 0xFF;
+    _packet[6] = _frame >> 24;
+    _packet[7] = payload & 0xFF;
+    _packet[8] = payload >> 8;
+    return SPECTATE_HEADER_SIZE + payload;
+}
+
+// a packet whose header and payload are in out[0..n) ends here, or 0 if it is not all there
+static size_t spectate_packet_end(const std::vector<uint8_t> &out, size_t at) {
+    if (out.size() - at < SPECTATE_HEADER_SIZE) return 0;
+    size_t end = at + SPECTATE_HEADER_SIZE + (out[at + 7] | (out[at + 8] << 8));
+    return end <= out.size() ? end : 0;
+}
+
+void SpectatorBroadcaster::_queue(SpectateViewer &v, const uint8_t *packet, int len, const uint8_t *display) {
+    if (v.out.size() - v.sent + len > SPECTATE_OUTBOX_LIMIT) {
+        // too far behind: keep only the packet on the wire, the keyframe replaces the rest
+        v.out.resize(v.sent > 0 ? spectate_packet_end(v.out, 0) : 0);
+        int k = _build(SPECTATE_KEYFRAME, display);
+        v.out.insert(v.out.end(), _packet, _packet + k);
+        ++_stats.resyncs;
+        return;
+    }
+    v.out.insert(v.out.end(), packet, packet + len);
+}
+
+bool SpectatorBroadcaster::_flush(SpectateViewer &v) {
+    while (v.sent < v.out.size()) {
+        int n = _server->sendSome(v.id, (const char *)v.out.data() + v.sent, v.out.size() - v.sent);
+        if (n < 0) return false;
+        if (n == 0) break; // socket buffer full, the rest goes next frame
+        v.sent += n;
+        _stats.bytes_sent += n;
+    }
+    // drop what is fully written; out[] keeps starting at a packet boundary
+    size_t done = 0, end;
+    while ((end = spectate_packet_end(v.out, done)) != 0 && end <= v.sent)
+        done = end;
+    v.out.erase(v.out.begin(), v.out.begin() + done);
+    v.sent -= done;
+    return true;
+}
+
+void SpectatorBroadcaster::broadcast(const uint8_t *display) {
+    int len = 0;
+    if (_frame - _last_keyframe >= SPECTATE_KEYFRAME_INTERVAL || _frame == 0) {
+        len = _build(SPECTATE_KEYFRAME, display);
+        _last_keyframe = _frame;
+        ++_stats.keyframes;
+    } else {
+        uint8_t delta[CHIP8_DISPLAY_BUFFER_SIZE];
+        uint8_t any = 0;
+        for (int i = 0; i < CHIP8_DISPLAY_BUFFER_SIZE; ++i) {
+            delta[i] = display[i] ^ _prev[i];
+            any |= delta[i];
+        }
+        if (any) {
+            len = _build(SPECTATE_DELTA, delta);
+            ++_stats.deltas;
+        } else if (_frame - _last_sent >= SPECTATE_HEARTBEAT_INTERVAL) {
+            len = _build(SPECTATE_HEARTBEAT, nullptr);
+            ++_stats.heartbeats;
+        }
+    }
+    memcpy(_prev, display, CHIP8_DISPLAY_BUFFER_SIZE);
+
+    if (len > 0) {
+        _last_sent = _frame;
+        _stats.bytes_encoded += len;
+        uint8_t packet[SPECTATE_MAX_PACKET]; // _queue may build a keyframe over _packet
+        memcpy(packet, _packet, len);
+        for (SpectateViewer &v : _viewers)
+            _queue(v, packet, len, display);
+    }
+
+    // viewers joining now start from a keyframe of this frame, not from the delta above
+    int id;
+    while ((id = _server->acceptNewClient()) >= 0) {
+        int k = _build(SPECTATE_KEYFRAME, display);
+        _viewers.push_back({id, std::vector<uint8_t>(_packet, _packet + k), 0});
+        _stats.bytes_encoded += k;
+        ++_stats.keyframes;
+    }
+
+    for (size_t i = 0; i < _viewers.size();) {
+        if (_flush(_viewers[i])) {
+            ++i;
+        } else {
+            _viewers[i] = std::move(_viewers.back());
+            _viewers.pop_back();
+        }
+    }
+    _stats.viewers = _viewers.size();
+    ++_stats.frames;
+    ++_frame;
+}
+
+// ------------------------ client -------------------------
+SpectatorClient::SpectatorClient(NetClient *client) {
+    _client = client;
+    memset(_display, 0, CHIP8_DISPLAY_BUFFER_SIZE);
+    _rx_len = 0;
+    _synced = false;
+    _lost = false;
+    _frame = 0;
+}
+
+bool SpectatorClient::_apply(const uint8_t *p, int len) {
+    const uint8_t *payload = p + SPECTATE_HEADER_SIZE;
+    int payload_len = len - SPECTATE_HEADER_SIZE;
+    _frame = p[3] | (p[4] << 8) | (p[5] << 16) | ((uint32_t)p[6] << 24);
+
+    switch (p[2]) {
+        case SPECTATE_KEYFRAME:
+            memset(_display, 0, CHIP8_DISPLAY_BUFFER_SIZE);
+            _synced = spectate_rle_xor(payload, payload_len, _display, CHIP8_DISPLAY_BUFFER_SIZE);
+            return true;
+        case SPECTATE_DELTA:
+            if (!_synced) return false;
+            _synced = spectate_rle_xor(payload, payload_len, _display, CHIP8_DISPLAY_BUFFER_SIZE);
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool SpectatorClient::poll() {
+    bool changed = false;
+    while (!_lost && _client->recieveData() == recieveData_OK) {
+        const uint8_t *data = (const uint8_t *)_client->recvbuf;
+        int len = _client->recvbuflen;
+        for (int i = 0; i < len;) {
+            // header first, then as much payload as the header says
+            int want = SPECTATE_HEADER_SIZE;
+            if (_rx_len >= SPECTATE_HEADER_SIZE) want += _rx[7] | (_rx[8] << 8);
+            if (want > SPECTATE_MAX_PACKET || (_rx_len >= 2 && (_rx[0] != 'S' || _rx[1] != 'P'))) {
+                _client->closeConnection(); // lost framing
+                _lost = true;
+                return changed;
+            }
+            int take = want - _rx_len;
+            if (take > len - i) take = len - i;
+            memcpy(_rx + _rx_len, data + i, take);
+            _rx_len += take;
+            i += take;
+
+            if (_rx_len >= SPECTATE_HEADER_SIZE && _rx_len == SPECTATE_HEADER_SIZE + (_rx[7] | (_rx[8] << 8))) {
+                changed |= _apply(_rx, _rx_len);
+                _rx_len = 0;
+            }
+        }
+    }
+    return changed;
+}
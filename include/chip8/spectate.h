@@ -0,0 +1,94 @@
+/* Spectator streaming of the Chip-8 display.
+
+   The broadcaster XORs each frame with the previous one and run-length
+   encodes the result; every SPECTATE_KEYFRAME_INTERVAL frames it sends a
+   keyframe instead, which is the same encoding against an empty screen. A
+   packet is encoded once and queued for every viewer; a viewer that just
+   joined gets a keyframe of its own. Frames without changes send nothing; a
+   bare heartbeat goes out only if the stream was silent for
+   SPECTATE_HEARTBEAT_INTERVAL frames.
+
+   Each viewer has an outbox that is flushed as far as its socket takes it,
+   so a short write never splits the stream. A viewer that falls more than
+   SPECTATE_OUTBOX_LIMIT bytes behind has its queued deltas dropped and is
+   sent a keyframe instead.
+
+   Packet: "SP", type, frame (LE u32), payload length (LE u16), payload.
+   Payload: repeated [zero run (u8), literal count (u8), literal bytes].
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "chip8.h"
+#include "mega_utils/netagent.h"
+
+#define SPECTATE_PORT "27015"
+#define SPECTATE_KEYFRAME_INTERVAL 300 // frames
+#define SPECTATE_HEARTBEAT_INTERVAL 30 // frames
+#define SPECTATE_HEADER_SIZE 9
+#define SPECTATE_MAX_PACKET (SPECTATE_HEADER_SIZE + 3 * CHIP8_DISPLAY_BUFFER_SIZE)
+#define SPECTATE_OUTBOX_LIMIT (8 * SPECTATE_MAX_PACKET) // bytes queued for one viewer
+
+enum SpectatePacketType {
+    SPECTATE_KEYFRAME = 'K',
+    SPECTATE_DELTA = 'D',
+    SPECTATE_HEARTBEAT = 'H',
+};
+
+struct SpectateStats {
+    uint64_t frames, keyframes, deltas, heartbeats;
+    uint64_t bytes_encoded; // once per packet
+    uint64_t bytes_sent;    // summed over viewers
+    uint64_t resyncs;       // slow viewers cut back to a keyframe
+    int viewers;
+};
+
+int spectate_rle_encode(const uint8_t *src, int len, uint8_t *dst);
+bool spectate_rle_xor(const uint8_t *src, int src_len, uint8_t *dst, int dst_len); // XORs decoded data into dst
+
+struct SpectateViewer {
+    int id;                   // NetServer client
+    std::vector<uint8_t> out; // starts at a packet boundary
+    size_t sent;              // bytes of out[] already written
+};
+
+class SpectatorBroadcaster {
+    NetServer *_server;
+    std::vector<SpectateViewer> _viewers;
+    uint8_t _prev[CHIP8_DISPLAY_BUFFER_SIZE];
+    uint8_t _packet[SPECTATE_MAX_PACKET];
+    uint32_t _frame, _last_keyframe, _last_sent;
+    SpectateStats _stats;
+
+    int _build(SpectatePacketType, const uint8_t *payload_src);
+    void _queue(SpectateViewer &, const uint8_t *packet, int len, const uint8_t *display);
+    bool _flush(SpectateViewer &); // false if the viewer is gone
+
+public:
+    SpectatorBroadcaster(NetServer *);
+    void broadcast(const uint8_t *display); // once per frame
+    SpectateStats stats() const { return _stats; }
+};
+
+class SpectatorClient {
+    NetClient *_client;
+    uint8_t _display[CHIP8_DISPLAY_BUFFER_SIZE];
+    uint8_t _rx[SPECTATE_MAX_PACKET];
+    int _rx_len;
+    bool _synced; // a keyframe has been seen
+    bool _lost;   // stream framing broke, connection closed
+    uint32_t _frame;
+
+    bool _apply(const uint8_t *packet, int len);
+
+public:
+    SpectatorClient(NetClient *);
+    bool poll(); // true if the display changed
+    bool connected() { return !_lost && _client->getConnectionStatus() == getConnectionStatus_GOOD; }
+    const uint8_t *get_display_buffer() const { return _display; }
+    uint32_t frame() const { return _frame; }
+};
+
+#include "spectate.cpp"
@@ -0,0 +1,129 @@
+#include "telemetry.h"
+
+TelemetryWriter::TelemetryWriter() {
+    _segment = nullptr;
+    memset(&_sample, 0, sizeof(_sample));
+}
+
+TelemetryWriter::~TelemetryWriter() {
+    close();
+}
+
+bool TelemetryWriter::open(const char *name) {
+    close();
+    _name = name != nullptr ? name : "/" TELEMETRY_PREFIX + std::to_string(getpid());
+    int fd = shm_open(_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("TelemetryWriter: shm_open");
+        return false;
+    }
+    if (ftruncate(fd, sizeof(TelemetrySegment)) != 0) {
+        perror("TelemetryWriter: ftruncate");
+        ::close(fd);
+        shm_unlink(_name.c_str());
+        return false;
+    }
+    void *p = mmap(nullptr, sizeof(TelemetrySegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        perror("TelemetryWriter: mmap");
+        shm_unlink(_name.c_str());
+        return false;
+    }
+    _segment = new (p) TelemetrySegment; // fresh zeroed pages; magic last so readers never see a half-made header
+    _segment->version = TELEMETRY_VERSION;
+    _segment->pid = getpid();
+    _segment->started = time(nullptr);
+    _segment->seq.store(0, std::memory_order_relaxed);
+    publish();
+    std::atomic_thread_fence(std::memory_order_release);
+    _segment->magic = TELEMETRY_MAGIC;
+    return true;
+}
+
+void TelemetryWriter::close() {
+    if (_segment == nullptr) return;
+    munmap(_segment, sizeof(TelemetrySegment));
+    shm_unlink(_name.c_str());
+    _segment = nullptr;
+}
+
+void TelemetryWriter::frame_time(double seconds) {
+    uint64_t us = seconds > 0. ? (uint64_t)(seconds * 1e6) : 0;
+    if (us > _sample.frame_time_max_us) _sample.frame_time_max_us = us;
+    int k = 0;
+    for (uint64_t ms = us / 1000; ms > 0 && k < TELEMETRY_BUCKETS - 1; ms >>= 1)
+        ++k;
+    ++_sample.frame_time[k];
+}
+
+void TelemetryWriter::publish() {
+    if (_segment == nullptr) return;
+    uint64_t words[TELEMETRY_WORDS];
+    memcpy(words, &_sample, sizeof(words));
+
+    // single writer: plain load/store of seq, no read-modify-write needed
+    uint64_t seq = _segment->seq.load(std::memory_order_relaxed);
+    _segment->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release); // odd before any word
+    for (size_t i = 0; i < TELEMETRY_WORDS; ++i)
+        _segment->words[i].store(words[i], std::memory_order_relaxed);
+    _segment->seq.store(seq + 2, std::memory_order_release); // words before even
+}
+
+// ------------------------ reader -------------------------
+TelemetryReader::TelemetryReader() {
+    _segment = nullptr;
+}
+
+TelemetryReader::~TelemetryReader() {
+    close();
+}
+
+bool TelemetryReader::open(const char *name) {
+    close();
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return false;
+    void *p = mmap(nullptr, sizeof(TelemetrySegment), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+    _segment = (const TelemetrySegment *)p;
+    if (_segment->magic != TELEMETRY_MAGIC || _segment->version != TELEMETRY_VERSION) {
+        close();
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return true;
+}
+
+void TelemetryReader::close() {
+    if (_segment == nullptr) return;
+    munmap((void *)_segment, sizeof(TelemetrySegment));
+    _segment = nullptr;
+}
+
+bool TelemetryReader::read(TelemetrySample &out, int tries) const {
+    uint64_t words[TELEMETRY_WORDS];
+    for (int t = 0; t < tries; ++t) {
+        uint64_t seq = _segment->seq.load(std::memory_order_acquire);
+        if (seq & 1) continue;
+        for (size_t i = 0; i < TELEMETRY_WORDS; ++i)
+            words[i] = _segment->words[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire); // words before the second seq
+        if (_segment->seq.load(std::memory_order_relaxed) == seq) {
+            memcpy(&out, words, sizeof(words));
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<std::string> chip8_telemetry_list() {
+    std::vector<std::string> names;
+    DIR *d = opendir("/dev/shm");
+    if (d == nullptr) return names;
+    while (struct dirent *e = readdir(d))
+        if (strncmp(e->d_name, TELEMETRY_PREFIX, strlen(TELEMETRY_PREFIX)) == 0) names.push_back(std::string("/") + e->d_name);
+    closedir(d);
+    return names;
+}
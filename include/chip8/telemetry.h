@@ -0,0 +1,100 @@
+/* Live counters in POSIX shared memory, for monitoring without a debugger.
+
+   A running instance publishes a TelemetrySample once per frame into the
+   segment /chip8-<pid> (visible as /dev/shm/chip8-<pid>). The sample is
+   guarded by a sequence lock: the writer makes the counter odd, stores the
+   words, and makes it even again, so the emulation thread never waits for
+   a reader. A reader copies the words and retries when the counter was odd
+   or changed meanwhile. Every word is a relaxed atomic, so the copy is
+   free of data races even though it may be torn until the retry.
+
+   The writer unlinks the segment on close(); one left behind by a crashed
+   instance is shown as dead (its pid is gone) and can simply be removed.
+*/
+
+#pragma once
+#ifdef __linux__
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define TELEMETRY_MAGIC 0x53543843u // "C8TS"
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_PREFIX "chip8-"
+#define TELEMETRY_BUCKETS 12 // frame time histogram: bucket 0 < 1 ms, bucket k in [2^(k-1), 2^k) ms, the last one open-ended
+
+struct TelemetrySample {
+    uint64_t instructions;   // committed: Chip8::cycles() without run-ahead frames and rollback re-runs
+    uint64_t frames;
+    uint64_t dropped_frames; // capture frames dropped because the writer fell behind
+    uint64_t ipf;
+    uint64_t runahead;       // frames
+    uint64_t rollbacks;      // netplay
+    uint64_t resimulated;    // netplay frames run again by rollbacks
+    uint64_t latency_avg_us; // input to screen
+    uint64_t latency_max_us;
+    uint64_t frame_time_max_us;
+    uint64_t frame_time[TELEMETRY_BUCKETS];
+};
+#define TELEMETRY_WORDS (sizeof(TelemetrySample) / sizeof(uint64_t))
+static_assert(sizeof(TelemetrySample) % sizeof(uint64_t) == 0, "TelemetrySample is copied as 64-bit words");
+
+struct TelemetrySegment {
+    uint32_t magic, version;
+    uint64_t pid;
+    uint64_t started; // unix time [s]
+    alignas(64) std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> words[TELEMETRY_WORDS];
+};
+
+// Emulation thread side. sample() is a plain struct to update in place;
+// publish() copies it out in a bounded number of stores.
+class TelemetryWriter {
+    TelemetrySegment *_segment;
+    std::string _name;
+    TelemetrySample _sample;
+
+public:
+    TelemetryWriter();
+    ~TelemetryWriter();
+
+    bool open(const char *name = nullptr); // default /chip8-<pid>
+    void close();
+    bool is_open() const { return _segment != nullptr; }
+    const std::string &name() const { return _name; }
+
+    TelemetrySample &sample() { return _sample; }
+    void frame_time(double seconds); // counts one frame into the histogram
+    void publish();
+};
+
+class TelemetryReader {
+    const TelemetrySegment *_segment;
+
+public:
+    TelemetryReader();
+    ~TelemetryReader();
+
+    bool open(const char *name);
+    void close();
+    uint64_t pid() const { return _segment->pid; }
+    bool alive() const { return kill(_segment->pid, 0) == 0; }
+
+    // false if the writer was mid-update on every try
+    bool read(TelemetrySample &, int tries = 100) const;
+};
+
+std::vector<std::string> chip8_telemetry_list(); // segment names in /dev/shm, with their leading '/'
+
+#include "telemetry.cpp"
+#endif // __linux__
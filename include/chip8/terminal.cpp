@@ -0,0 +1,133 @@
+#include "terminal.h"
+
+TerminalRenderer::TerminalRenderer(TerminalMode mode) {
+    _mode = mode;
+    _full_redraw = true;
+    _raw = false;
+    memset(_cells, 0, TERMINAL_MAX_CELLS);
+    memset(_key_hold, 0, 16);
+    _out.reserve(64 * 1024);
+}
+
+TerminalRenderer::~TerminalRenderer() {
+    restore();
+}
+
+void TerminalRenderer::init() {
+    if (_raw) return;
+    if (tcgetattr(STDIN_FILENO, &_orig_termios) == 0) {
+        struct termios raw = _orig_termios;
+        raw.c_lflag &= ~(ICANON | ECHO | ISIG); // Ctrl-C is read as a key, so we can restore the terminal
+        raw.c_cc[VMIN] = 0; // read() never blocks
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+        _raw = true;
+    }
+    const char *enter = "\x1b[?1049h\x1b[?25l\x1b[2J";
+    write(STDOUT_FILENO, enter, strlen(enter));
+    _full_redraw = true;
+}
+
+void TerminalRenderer::restore() {
+    if (!_raw) return;
+    tcsetattr(STDIN_FILENO, TCSANOW, &_orig_termios);
+    const char *leave = "\x1b[0m\x1b[?25h\x1b[?1049l";
+    write(STDOUT_FILENO, leave, strlen(leave));
+    _raw = false;
+}
+
+uint8_t TerminalRenderer::_cell_at(const uint8_t *bits, int w, int h, int cx, int cy) {
+    const int row_bytes = w / 8;
+    auto px = [&](int x, int y) -> uint8_t {
+        if (x >= w || y >= h) return 0;
+        return (bits[y * row_bytes + (x >> 3)] >> (7 - (x & 7))) & 1;
+    };
+
+    if (_mode == TERMINAL_HALF_BLOCK)
+        return px(cx, cy * 2) | (px(cx, cy * 2 + 1) << 1);
+
+    // braille dot numbering: column 0 = dots 1,2,3,7; column 1 = dots 4,5,6,8
+    int x = cx * 2, y = cy * 4;
+    return px(x, y) | (px(x, y + 1) << 1) | (px(x, y + 2) << 2) |
+           (px(x + 1, y) << 3) | (px(x + 1, y + 1) << 4) | (px(x + 1, y + 2) << 5) |
+           (px(x, y + 3) << 6) | (px(x + 1, y + 3) << 7);
+}
+
+void TerminalRenderer::_emit_cell(uint8_t cell) {
+    if (_mode == TERMINAL_HALF_BLOCK) {
+        static const char *blocks[4] = {" ", "\xE2\x96\x80", "\xE2\x96\x84", "\xE2\x96\x88"};
+        _out += blocks[cell & 3];
+        return;
+    }
+    if (cell == 0) { // blank braille renders narrower on some fonts
+        _out += ' ';
+        return;
+    }
+    _out += (char)0xE2;
+    _out += (char)(0xA0 | (cell >> 6));
+    _out += (char)(0x80 | (cell & 0x3F));
+}
+
+size_t TerminalRenderer::render(const uint8_t *bits, int w, int h) {
+    const int cols = _mode == TERMINAL_HALF_BLOCK ? w : (w + 1) / 2;
+    const int rows = _mode == TERMINAL_HALF_BLOCK ? (h + 1) / 2 : (h + 3) / 4;
+    if (cols * rows > TERMINAL_MAX_CELLS) return 0;
+
+    _out.clear();
+    int cursor_x = -1, cursor_y = -1; // where the terminal cursor is after the last write
+    for (int cy = 0; cy < rows; ++cy) {
+        for (int cx = 0; cx < cols; ++cx) {
+            uint8_t cell = _cell_at(bits, w, h, cx, cy);
+            uint8_t &shown = _cells[cy * cols + cx];
+            if (!_full_redraw && cell == shown) continue;
+            shown = cell;
+
+            if (cx != cursor_x || cy != cursor_y) {
+                char mv[24];
+                int n = snprintf(mv, sizeof(mv), "\x1b[%d;%dH", cy + 1, cx + 1);
+                _out.append(mv, n);
+            }
+            _emit_cell(cell);
+            cursor_x = cx + 1;
+            cursor_y = cy;
+        }
+    }
+    _full_redraw = false;
+
+    if (_out.empty()) return 0;
+    size_t done = 0;
+    while (done < _out.size()) {
+        ssize_t n = write(STDOUT_FILENO, _out.data() + done, _out.size() - done);
+        if (n <= 0) break;
+        done += n;
+    }
+    return done;
+}
+
+uint16_t TerminalRenderer::poll_keys(bool *quit) {
+    // 1 2 3 4 / q w e r / a s d f / z x c v  ->  1 2 3 C / 4 5 6 D / 7 8 9 E / A 0 B F
+    static const char layout[16] = {'x', '1', '2', '3', 'q', 'w', 'e', 'a', 's', 'd', 'z', 'c', '4', 'r', 'f', 'v'};
+
+    for (int k = 0; k < 16; ++k)
+        if (_key_hold[k]) --_key_hold[k];
+
+    char buf[64];
+    ssize_t n;
+    while ((n = read(STDIN_FILENO, buf, sizeof(buf))) > 0) {
+        for (ssize_t i = 0; i < n; ++i) {
+            char c = buf[i];
+            if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+            if (c == 3) { // Ctrl-C
+                if (quit) *quit = true;
+                continue;
+            }
+            for (int k = 0; k < 16; ++k)
+                if (layout[k] == c) _key_hold[k] = TERMINAL_KEY_HOLD_FRAMES;
+        }
+    }
+
+    uint16_t mask = 0;
+    for (int k = 0; k < 16; ++k)
+        if (_key_hold[k]) mask |= 1 << k;
+    return mask;
+}
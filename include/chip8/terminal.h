@@ -0,0 +1,51 @@
+/* Terminal renderer for headless sessions (e.g. over SSH).
+
+   Draws the 1bpp display with Unicode half-blocks (1x2 pixels per cell) or
+   braille (2x4 pixels per cell). Only cells that changed since the previous
+   frame are written, so an idle screen costs 0 bytes.
+   Keypad input is read from raw stdin.
+*/
+
+#pragma once
+#ifdef __linux__
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <termios.h>
+#include <unistd.h>
+
+#define TERMINAL_MAX_CELLS (128 * 32)
+#define TERMINAL_KEY_HOLD_FRAMES 6 // terminals send no key-up, so a press is held this long
+
+enum TerminalMode {
+    TERMINAL_HALF_BLOCK,
+    TERMINAL_BRAILLE,
+};
+
+class TerminalRenderer {
+    TerminalMode _mode;
+    uint8_t _cells[TERMINAL_MAX_CELLS]; // what the terminal currently shows
+    bool _full_redraw;
+    std::string _out;
+
+    struct termios _orig_termios;
+    bool _raw;
+    uint8_t _key_hold[16];
+
+    uint8_t _cell_at(const uint8_t *bits, int w, int h, int cx, int cy);
+    void _emit_cell(uint8_t cell);
+
+public:
+    TerminalRenderer(TerminalMode mode = TERMINAL_HALF_BLOCK);
+    ~TerminalRenderer();
+
+    void init();    // raw stdin, alternate screen, hidden cursor
+    void restore(); // called by the destructor too
+
+    size_t render(const uint8_t *bits, int w, int h); // returns bytes written
+    uint16_t poll_keys(bool *quit);                    // call once per frame
+    void invalidate() { _full_redraw = true; }
+};
+
+#include "terminal.cpp"
+#endif // __linux__
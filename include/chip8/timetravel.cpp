@@ -0,0 +1,119 @@
+#include "timetravel.h"
+
+Chip8TimeTravel::Chip8TimeTravel(Chip8 &chip8, int ipf, uint64_t interval) {
+    _chip8 = &chip8;
+    _ipf = ipf;
+    _interval = interval;
+    for (int a = 0; a < CHIP8_MEMORY_SIZE; ++a)
+        _last_write[a] = -1;
+    _cycle = _head = 0;
+    _frame = 0;
+    _mid_frame = false;
+    _stopped = false;
+    _recording = true;
+    _target = UINT64_MAX;
+    _frame_pos = 0;
+    _store_I = 0;
+    _checkpoints.push_back({0, 0, chip8.fork()});
+}
+
+bool Chip8TimeTravel::_before(uint16_t) {
+    _stopped = _cycle == _target;
+    _store_I = _chip8->_I;
+    return _stopped;
+}
+
+bool Chip8TimeTravel::_after(uint16_t, uint16_t opcode) {
+    if (_recording && ((opcode & 0xF0FF) == 0xF033 || (opcode & 0xF0FF) == 0xF055)) {
+        int len = (opcode & 0xF0FF) == 0xF033 ? 3 : ((opcode >> 8) & 0xF) + 1;
+        for (int i = 0; i < len; ++i) {
+            uint16_t a = (_store_I + i) & (CHIP8_MEMORY_SIZE - 1);
+            _writes.push_back({_cycle, a, _last_write[a]});
+            _last_write[a] = _writes.size() - 1;
+        }
+    }
+    ++_cycle;
+    return false;
+}
+
+void Chip8TimeTravel::_truncate() {
+    while (!_writes.empty() && _writes.back().cycle >= _cycle) {
+        _last_write[_writes.back().addr] = _writes.back().prev;
+        _writes.pop_back();
+    }
+    while (_checkpoints.size() > 1 && _checkpoints.back().frame > _frame)
+        _checkpoints.pop_back();
+    _keys.resize(_frame + (_mid_frame ? 1 : 0));
+    _head = _cycle;
+}
+
+void Chip8TimeTravel::run_frame(uint16_t keys) {
+    if (_frame < _keys.size()) { // in the past: this becomes the present
+        _truncate();
+        if (_mid_frame) {
+            _chip8->set_keys(_keys[_frame]);
+            _chip8->_run_frame(_ipf, this);
+            _mid_frame = false;
+            ++_frame;
+        }
+    }
+
+    _keys.push_back(keys);
+    _chip8->set_keys(keys);
+    _chip8->_run_frame(_ipf, this);
+    ++_frame;
+    _head = _cycle;
+
+    if (_cycle - _checkpoints.back().cycle >= _interval)
+        _checkpoints.push_back({_cycle, _frame, _chip8->fork()});
+}
+
+bool Chip8TimeTravel::seek(uint64_t target) {
+    if (_keys.empty()) return false;
+    if (target > _head) target = _head;
+
+    // newest checkpoint at or before the target
+    auto it = upper_bound(_checkpoints.begin(), _checkpoints.end(), target,
+                          [](uint64_t c, const TimeTravelCheckpoint &cp) { return c < cp.cycle; });
+    const TimeTravelCheckpoint &cp = *(it - 1);
+    if (_cycle > target || _cycle < cp.cycle) {
+        _chip8->restore(cp.state); // the host's handlers stay
+        _cycle = cp.cycle;
+        _frame = cp.frame;
+        _frame_pos = 0;
+        _mid_frame = false;
+    }
+
+    _recording = false;
+    _target = target;
+    while (_frame < _keys.size()) {
+        if (!_mid_frame) _chip8->set_keys(_keys[_frame]);
+        _stopped = false;
+        _chip8->_run_frame(_ipf, this);
+        if (_stopped) {
+            _mid_frame = _frame_pos != 0;
+            break;
+        }
+        _mid_frame = false;
+        ++_frame;
+    }
+    _target = UINT64_MAX;
+    _recording = true;
+    return true;
+}
+
+int64_t Chip8TimeTravel::last_write(uint16_t addr, uint64_t before) const {
+    for (int32_t i = _last_write[addr & (CHIP8_MEMORY_SIZE - 1)]; i >= 0; i = _writes[i].prev)
+        if (_writes[i].cycle < before) return _writes[i].cycle;
+    return -1;
+}
+
+bool Chip8TimeTravel::run_back_to_write(uint16_t addr) {
+    int64_t c = last_write(addr, _cycle);
+    return c >= 0 && seek(c);
+}
+
+size_t Chip8TimeTravel::memory_bytes() const {
+    return _keys.capacity() * sizeof(uint16_t) + _writes.capacity() * sizeof(TimeTravelWrite) +
+           _checkpoints.capacity() * sizeof(TimeTravelCheckpoint) + sizeof(*this);
+}
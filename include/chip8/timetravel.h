@@ -0,0 +1,85 @@
+/* Time-travel debugging: seek to any executed instruction, step backwards,
+   run back to the last write of an address.
+
+   Chip8TimeTravel drives the machine through its own instantiation of the
+   execution loop and records
+     - the keypad state of every frame (the only outside input; CXNN draws
+       from the xorshift state, which is part of the machine),
+     - a checkpoint at the first frame boundary after every `interval`
+       instructions (a Chip8 copy, sharing memory pages with its neighbours),
+     - a write log: for every FX33/FX55 store the cycle and, per address, a
+       link to the previous write of that address.
+
+   A cycle is the number of instructions executed; "at cycle c" is the state
+   right before instruction c runs. seek() restores the nearest checkpoint at
+   or before the target (or keeps going from the current state if that is
+   closer) and replays with the recorded keys, so a seek replays at most
+   `interval` instructions. Running a new frame while in the past finishes
+   the current frame as recorded and drops the recorded future.
+*/
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "chip8.h"
+
+#define TIMETRAVEL_CHECKPOINT_CYCLES 100000 // ~2.5 min at the default speed, a few ms to replay
+
+struct TimeTravelCheckpoint {
+    uint64_t cycle;
+    uint32_t frame;
+    Chip8 state;
+};
+
+struct TimeTravelWrite {
+    uint64_t cycle;
+    uint16_t addr;
+    int32_t prev; // previous write of addr, -1 = none
+};
+
+class Chip8TimeTravel {
+    Chip8 *_chip8;
+    int _ipf;
+    uint64_t _interval;
+
+    std::vector<uint16_t> _keys; // per frame
+    std::vector<TimeTravelCheckpoint> _checkpoints;
+    std::vector<TimeTravelWrite> _writes;
+    int32_t _last_write[CHIP8_MEMORY_SIZE]; // newest entry in _writes per address
+
+    uint64_t _cycle, _head; // current position, newest recorded cycle
+    uint32_t _frame;        // frame the current position is in
+    bool _mid_frame;        // stopped inside _frame
+    bool _recording;        // log writes (not while replaying history)
+    uint64_t _target;       // replay stops before this instruction
+    bool _stopped;          // ... and did
+
+    // execution loop hooks
+    int _frame_pos;
+    uint16_t _store_I; // I before the instruction: memory_inc moves it past what FX55 wrote
+    bool _before(uint16_t opcode);
+    bool _after(uint16_t pc, uint16_t opcode);
+    friend class Chip8;
+
+    void _truncate();
+
+public:
+    Chip8TimeTravel(Chip8 &, int ipf = CHIP8_DEFAULT_IPF, uint64_t interval = TIMETRAVEL_CHECKPOINT_CYCLES);
+
+    void run_frame(uint16_t keys); // live emulation, recorded
+
+    bool seek(uint64_t cycle);   // clamps to head(); false if nothing was recorded yet
+    bool step_back() { return _cycle > 0 && seek(_cycle - 1); }
+    bool step() { return _cycle < _head && seek(_cycle + 1); }
+    int64_t last_write(uint16_t addr, uint64_t before) const; // cycle of the newest write before `before`, -1 = none
+    bool run_back_to_write(uint16_t addr);                   // seek to right before the last write of addr
+
+    uint64_t cycle() const { return _cycle; }
+    uint64_t head() const { return _head; }
+    uint32_t frame() const { return _frame; }
+    size_t checkpoints() const { return _checkpoints.size(); }
+    size_t memory_bytes() const; // history, not counting memory pages shared with the live machine
+};
+
+#include "timetravel.cpp"
@@ -0,0 +1,180 @@
+#include "trace.h"
+
+// ------------------------ writer -------------------------
+TraceWriter::TraceWriter() {
+    _ring = nullptr;
+    _running = false;
+    _written = 0;
+    _file = nullptr;
+    _file_buffer = nullptr;
+}
+
+TraceWriter::~TraceWriter() {
+    close();
+}
+
+bool TraceWriter::open(const char *path, Chip8TraceRing *ring) {
+    close();
+    _file = fopen(path, "wb");
+    if (_file == nullptr) {
+        cerr << "TraceWriter::open could not open " << path << "\n";
+        return false;
+    }
+    _file_buffer = new char[TRACE_WRITE_BUFFER];
+    setvbuf(_file, _file_buffer, _IOFBF, TRACE_WRITE_BUFFER);
+
+    _ring = ring;
+    _ring->tail.store(_ring->head.load(std::memory_order_acquire), std::memory_order_release);
+    uint64_t first = _ring->tail.load(std::memory_order_relaxed);
+    uint8_t header[TRACE_HEADER_SIZE];
+    memcpy(header, TRACE_MAGIC, 8);
+    for (int i = 0; i < 8; ++i)
+        header[8 + i] = (first >> (8 * i)) & 0xFF;
+    fwrite(header, 1, TRACE_HEADER_SIZE, _file);
+
+    _written = 0;
+    _running = true;
+    _writer = std::thread(&TraceWriter::_writer_loop, this);
+    return true;
+}
+
+void TraceWriter::close() {
+    if (_file == nullptr) return;
+    _running = false;
+    if (_writer.joinable()) _writer.join();
+    fclose(_file);
+    _file = nullptr;
+    delete[] _file_buffer;
+    _file_buffer = nullptr;
+}
+
+TraceStats TraceWriter::stats() const {
+    TraceStats s;
+    s.records_written = _written.load(std::memory_order_relaxed);
+    s.stalls = _ring != nullptr ? _ring->stalls.load(std::memory_order_relaxed) : 0;
+    return s;
+}
+
+void TraceWriter::_writer_loop() {
+    uint8_t batch[TRACE_BATCH * TRACE_RECORD_SIZE];
+    for (;;) {
+        uint64_t tail = _ring->tail.load(std::memory_order_relaxed);
+        uint64_t head = _ring->head.load(std::memory_order_acquire);
+        if (tail == head) {
+            if (!_running.load(std::memory_order_acquire)) {
+                // producer may have pushed right before stopping
+                if (_ring->head.load(std::memory_order_acquire) == tail) break;
+                continue;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            continue;
+        }
+
+        uint64_t n = head - tail;
+        if (n > TRACE_BATCH) n = TRACE_BATCH;
+        for (uint64_t i = 0; i < n; ++i) {
+            const Chip8TraceRecord &r = _ring->records[(tail + i) & (CHIP8_TRACE_RING - 1)];
+            uint8_t *p = batch + i * TRACE_RECORD_SIZE;
+            p[0] = r.pc & 0xFF;
+            p[1] = r.pc >> 8;
+            p[2] = r.opcode & 0xFF;
+            p[3] = r.opcode >> 8;
+            p[4] = r.I & 0xFF;
+            p[5] = r.I >> 8;
+            p[6] = r.reg;
+            p[7] = r.value;
+        }
+        _ring->tail.store(tail + n, std::memory_order_release);
+        fwrite(batch, TRACE_RECORD_SIZE, n, _file);
+        _written.fetch_add(n, std::memory_order_relaxed);
+    }
+    fflush(_file);
+}
+
+// ------------------------ reader -------------------------
+TraceReader::TraceReader() {
+    _file = nullptr;
+    _cycle = 0;
+}
+
+TraceReader::~TraceReader() {
+    if (_file != nullptr) fclose(_file);
+}
+
+bool TraceReader::open(const char *path) {
+    _file = fopen(path, "rb");
+    if (_file == nullptr) {
+        cerr << "TraceReader::open could not open " << path << "\n";
+        return false;
+    }
+    uint8_t header[TRACE_HEADER_SIZE];
+    if (fread(header, 1, TRACE_HEADER_SIZE, _file) != TRACE_HEADER_SIZE || memcmp(header, TRACE_MAGIC, 8) != 0) {
+        cerr << "TraceReader::open " << path << " is not a trace\n";
+        fclose(_file);
+        _file = nullptr;
+        return false;
+    }
+    _cycle = 0;
+    for (int i = 0; i < 8; ++i)
+        _cycle |= (uint64_t)header[8 + i] << (8 * i);
+    return true;
+}
+
+bool TraceReader::next(Chip8TraceRecord &r) {
+    uint8_t p[TRACE_RECORD_SIZE];
+    if (_file == nullptr || fread(p, 1, TRACE_RECORD_SIZE, _file) != TRACE_RECORD_SIZE) return false;
+    r.pc = p[0] | (p[1] << 8);
+    r.opcode = p[2] | (p[3] << 8);
+    r.I = p[4] | (p[5] << 8);
+    r.reg = p[6];
+    r.value = p[7];
+    ++_cycle;
+    return true;
+}
+
+// ------------------------ diff -------------------------
+static void trace_print(ostream &out, const char *label, uint64_t cycle, const Chip8TraceRecord &r) {
+    char text[32], line[128];
+    chip8_disassemble(r.opcode, text, sizeof(text));
+    int n = snprintf(line, sizeof(line), "%s %10llu  0x%03X  %04X  %-16s I=0x%03X", label, (unsigned long long)cycle, r.pc, r.opcode, text, r.I);
+    if (r.reg != 0xFF) snprintf(line + n, sizeof(line) - n, " V%X=0x%02X", r.reg, r.value);
+    out << line << "\n";
+}
+
+int64_t chip8_trace_diff(const char *path_a, const char *path_b, ostream &out) {
+    TraceReader a, b;
+    if (!a.open(path_a) || !b.open(path_b)) return -2;
+
+    Chip8TraceRecord ra, rb;
+    bool has_a = true, has_b = true;
+    // skip whichever trace started earlier
+    while (has_a && a.cycle() < b.cycle()) has_a = a.next(ra);
+    while (has_b && b.cycle() < a.cycle()) has_b = b.next(rb);
+
+    Chip8TraceRecord context[TRACE_DIFF_CONTEXT];
+    uint64_t matched = 0;
+    for (;;) {
+        uint64_t cycle = a.cycle();
+        has_a = has_a && a.next(ra);
+        has_b = has_b && b.next(rb);
+        if (!has_a && !has_b) {
+            out << "Traces match (" << matched << " instructions)\n";
+            return -1;
+        }
+        if (has_a && has_b && memcmp(&ra, &rb, sizeof(ra)) == 0) {
+            context[matched % TRACE_DIFF_CONTEXT] = ra;
+            ++matched;
+            continue;
+        }
+
+        out << "Traces diverge at cycle " << cycle << " after " << matched << " matching instructions\n";
+        uint64_t shown = matched < TRACE_DIFF_CONTEXT ? matched : TRACE_DIFF_CONTEXT;
+        for (uint64_t i = matched - shown; i < matched; ++i)
+            trace_print(out, "   ", cycle - matched + i, context[i % TRACE_DIFF_CONTEXT]);
+        if (has_a) trace_print(out, "A: ", cycle, ra);
+        else out << "A:  trace ends\n";
+        if (has_b) trace_print(out, "B: ", cycle, rb);
+        else out << "B:  trace ends\n";
+        return cycle;
+    }
+}
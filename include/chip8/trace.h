@@ -0,0 +1,79 @@
+/* Instruction traces for finding where two runs or two engines diverge.
+
+   Built with CHIP8_TRACE=1, the interpreter pushes one Chip8TraceRecord per
+   executed instruction into the Chip8TraceRing given to Chip8::set_trace().
+   A TraceWriter thread drains the ring into a binary file with large
+   buffered writes, so tracing costs a store per instruction instead of a
+   formatted line on cerr. With run-ahead or netplay the trace also holds the
+   speculative frames, in the order they ran.
+
+   File: "C8TRACE1", first cycle (LE u64), then 8 bytes per instruction:
+         PC (LE u16), opcode (LE u16), I (LE u16), register, value.
+
+   chip8_trace_diff() walks two traces in lockstep and reports the first
+   cycle where they differ, with a few records of context.
+*/
+
+#pragma once
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include "chip8.h"
+#include "disasm.h"
+
+using namespace std;
+
+#define TRACE_MAGIC "C8TRACE1"
+#define TRACE_HEADER_SIZE 16
+#define TRACE_RECORD_SIZE 8
+#define TRACE_WRITE_BUFFER (1 << 20)
+#define TRACE_BATCH 4096 // records per fwrite
+#define TRACE_DIFF_CONTEXT 4
+
+struct TraceStats {
+    uint64_t records_written;
+    uint64_t stalls; // times the interpreter waited for the writer
+};
+
+class TraceWriter {
+    Chip8TraceRing *_ring;
+    std::atomic<bool> _running;
+    std::atomic<uint64_t> _written;
+    std::thread _writer;
+    FILE *_file;
+    char *_file_buffer;
+
+    void _writer_loop();
+
+public:
+    TraceWriter();
+    ~TraceWriter();
+
+    bool open(const char *path, Chip8TraceRing *ring); // records from the ring's current cycle on
+    void close();                                      // drains the ring, joins the writer
+
+    TraceStats stats() const;
+    bool is_open() const { return _file != nullptr; }
+};
+
+class TraceReader {
+    FILE *_file;
+    uint64_t _cycle; // of the next record
+
+public:
+    TraceReader();
+    ~TraceReader();
+
+    bool open(const char *path);
+    bool next(Chip8TraceRecord &);
+    uint64_t cycle() const { return _cycle; }
+};
+
+// Returns the first divergent cycle, -1 if the traces match, -2 if a file could not be read.
+int64_t chip8_trace_diff(const char *path_a, const char *path_b, ostream &out);
+
+#include "trace.cpp"
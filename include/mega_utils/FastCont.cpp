@@ -1,67 +1,117 @@
 #include "FastCont.h"
 
 template <class T, class id_data_type>
-id_data_type FastCont<T, id_data_type>::push_back(T _a) {
-    // FastContElement<T, id_data_type> a(_a, rollingID++);
-
-    if (alloc_size == 0) {
-        alloc_size = 1;
-        p = (FastContElement<T, id_data_type> *)malloc(sizeof(FastContElement<T, id_data_type>));
-    } else if (alloc_size <= _size) {
+void FastCont<T, id_data_type>::grow(uint32_t n) {
+    if (n <= alloc_size) return;
+    if (alloc_size == 0) alloc_size = 1;
+    while (alloc_size < n)
         alloc_size *= 2;
-        p = (FastContElement<T, id_data_type> *)realloc(p, sizeof(FastContElement<T, id_data_type>) * alloc_size);
+    p = (FastContElement<T, id_data_type> *)realloc(p, sizeof(FastContElement<T, id_data_type>) * alloc_size);
+}
+
+template <class T, class id_data_type>
+void FastCont<T, id_data_type>::grow_slots(uint32_t n) {
+    if (n <= slot_count) return;
+    if (n > slot_alloc) {
+        if (slot_alloc == 0) slot_alloc = 1;
+        while (slot_alloc < n)
+            slot_alloc *= 2;
+        slots = (FastContSlot<id_data_type> *)realloc(slots, sizeof(FastContSlot<id_data_type>) * slot_alloc);
     }
+    for (uint32_t i = slot_count; i < n; ++i)
+        slots[i] = {FASTCONT_FREE, 0};
+    slot_count = n;
+}
 
-    (p + _size)->id = rollingID++;
+template <class T, class id_data_type>
+id_data_type FastCont<T, id_data_type>::new_id(uint32_t index) {
+    uint32_t slot = FASTCONT_FREE;
+    while (free_count > 0 && slot == FASTCONT_FREE) {
+        slot = free_slots[--free_count];
+        if (slots[slot].index != FASTCONT_FREE) slot = FASTCONT_FREE; // force_import took it meanwhile
+    }
+    if (slot == FASTCONT_FREE) {
+        while ((uint32_t)rollingID < slot_count && slots[(uint32_t)rollingID].index != FASTCONT_FREE)
+            ++rollingID;
+        slot = (uint32_t)rollingID++;
+        if (slot > slot_mask) throw length_error("FastCont: out of slots, raise FASTCONT_SLOT_BITS");
+        grow_slots(slot + 1);
+    }
+    slots[slot].index = index;
+    return (id_data_type)(((uint64_t)slots[slot].gen << slot_bits) | slot);
+}
+
+template <class T, class id_data_type>
+void FastCont<T, id_data_type>::free_slot(id_data_type id) {
+    uint32_t slot = (uint64_t)id & slot_mask;
+    slots[slot].index = FASTCONT_FREE;
+    slots[slot].gen = (slots[slot].gen + 1) & gen_mask;
+    if (free_count == free_alloc) {
+        free_alloc = free_alloc == 0 ? 16 : free_alloc * 2;
+        free_slots = (uint32_t *)realloc(free_slots, sizeof(uint32_t) * free_alloc);
+    }
+    free_slots[free_count++] = slot;
+}
+
+template <class T, class id_data_type>
+id_data_type FastCont<T, id_data_type>::push_back(T _a) {
+    grow(_size + 1);
+    (p + _size)->id = new_id(_size);
     // (p + _size)->data = _a;
     memcpy(&(p + _size)->data, &_a, sizeof(T));
     // #pragma message("talele memcpy je novi, dela kr dobr zaenkat...")
     ++_size;
 
-    return rollingID - 1;
+    return (p + _size - 1)->id;
 }
 
 template <class T, class id_data_type>
 void FastCont<T, id_data_type>::pop_back() {
     if (_size == 0) return;
     --_size;
+    free_slot((p + _size)->id);
 }
 template <class T, class id_data_type>
 void FastCont<T, id_data_type>::remove_index(uint32_t at) {
     if (at >= _size) return;
-    for (uint32_t i = at + 1; i < _size; ++i)
+    free_slot((p + at)->id);
+    for (uint32_t i = at + 1; i < _size; ++i) {
         *(p + i - 1) = *(p + i);
+        slots[(uint64_t)(p + i - 1)->id & slot_mask].index = i - 1;
+    }
 
     --_size;
 }
 template <class T, class id_data_type>
 void FastCont<T, id_data_type>::remove_id(id_data_type id) {
-    for (uint32_t i = 0; i < _size; ++i) {
-        if ((p + i)->id == id) {
-            remove_index(i);
-        }
+    T *a = at_id(id);
+    if (a == nullptr) return;
+    uint32_t at = (FastContElement<T, id_data_type> *)a - p;
+    free_slot(id);
+    --_size;
+    if (at != _size) {
+        *(p + at) = *(p + _size);
+        slots[(uint64_t)(p + at)->id & slot_mask].index = at;
     }
 }
 template <class T, class id_data_type>
 void FastCont<T, id_data_type>::insert(T a, uint32_t at) {
     if (at > _size) return;
+    grow(_size + 1);
 
-    if (alloc_size == 0) {
-        alloc_size = 1;
-        p = (FastContElement<T, id_data_type> *)malloc(sizeof(FastContElement<T, id_data_type>));
-    } else if (alloc_size <= _size) {
-        alloc_size *= 2;
-        p = (FastContElement<T, id_data_type> *)realloc(p, sizeof(FastContElement<T, id_data_type>) * alloc_size);
+    for (uint32_t i = _size; i > at; --i) {
+        *(p + i) = *(p + i - 1);
+        slots[(uint64_t)(p + i)->id & slot_mask].index = i;
     }
 
-    for (int64_t i = _size - 1; i >= at; --i)
-        *(p + i + 1) = *(p + i);
-
     (p + at)->data = a;
+    (p + at)->id = new_id(at);
     ++_size;
 }
 template <class T, class id_data_type>
 void FastCont<T, id_data_type>::clear() {
+    for (uint32_t i = 0; i < _size; ++i)
+        free_slot((p + i)->id);
     if (p != nullptr)
         free(p);
     p = nullptr;
@@ -76,10 +126,11 @@ T *FastCont<T, id_data_type>::at_index(uint32_t at) {
 
 template <class T, class id_data_type>
 T *FastCont<T, id_data_type>::at_id(id_data_type searchForID) {
-    for (uint32_t i = 0; i < _size; ++i) {
-        if ((p + i)->id == searchForID) {
+    uint64_t slot = (uint64_t)searchForID & slot_mask;
+    if (slot < slot_count) {
+        uint32_t i = slots[slot].index;
+        if (i != FASTCONT_FREE && (p + i)->id == searchForID) // an older generation of the slot is not found
             return &((p + i)->data);
-        }
     }
 #ifdef CONSOLE_LOGGING_ID_NOT_FOUND
     cout << "E: FastCont::at_id\tno ID found!\n";
@@ -104,6 +155,10 @@ void FastCont<T, id_data_type>::reserve_n_spots(uint32_t n) {
 template <class T, class id_data_type>
 void FastCont<T, id_data_type>::reset() {
     rollingID = 0;
+    if (_size == 0) { // nothing can hold an old ID any more: forget the slots
+        slot_count = 0;
+        free_count = 0;
+    }
 }
 
 template <class T, class id_data_type>
@@ -119,12 +174,8 @@ void FastCont<T, id_data_type>::set_memory_leak_safety(bool a) {
 }
 
 template <class T, class id_data_type>
-FastCont<T, id_data_type>::FastCont(bool _memory_leak_safety) {
+FastCont<T, id_data_type>::FastCont(bool _memory_leak_safety) : FastCont() {
     memory_leak_safety = _memory_leak_safety;
-    p = nullptr;
-    rollingID = 0;
-    alloc_size = 0;
-    _size = 0;
 }
 template <class T, class id_data_type>
 FastCont<T, id_data_type>::FastCont() {
@@ -133,17 +184,15 @@ FastCont<T, id_data_type>::FastCont() {
     rollingID = 0;
     alloc_size = 0;
     _size = 0;
+    slots = nullptr;
+    slot_count = slot_alloc = 0;
+    free_slots = nullptr;
+    free_count = free_alloc = 0;
 }
 
 template <class T, class id_data_type>
 template <typename... Args>
-FastCont<T, id_data_type>::FastCont(T a, Args... data) {
-    memory_leak_safety = true;
-    p = nullptr;
-    rollingID = 0;
-    alloc_size = 0;
-    _size = 0;
-
+FastCont<T, id_data_type>::FastCont(T a, Args... data) : FastCont() {
     push_back(a);
     handleInfArgs(data...);
 }
@@ -159,29 +208,28 @@ void FastCont<T, id_data_type>::handleInfArgs() {
 }
 template <class T, class id_data_type>
 FastCont<T, id_data_type>::~FastCont() {
-    if (memory_leak_safety && p != nullptr)
-        free(p);
+    if (memory_leak_safety) {
+        if (p != nullptr) free(p);
+        free(slots);
+        free(free_slots);
+    }
 }
 
 template <class T, class id_data_type>
 void FastCont<T, id_data_type>::force_import(id_data_type id, T _a) {
-    T *ex = at_id(id);
-    if (ex != nullptr) {
-        *ex = _a;
-        return;
-    }
-    if (alloc_size == 0) {
-        alloc_size = 1;
-        p = (FastContElement<T, id_data_type> *)malloc(sizeof(FastContElement<T, id_data_type>));
-    } else if (alloc_size <= _size) {
-        alloc_size *= 2;
-        p = (FastContElement<T, id_data_type> *)realloc(p, sizeof(FastContElement<T, id_data_type>) * alloc_size);
+    uint32_t slot = (uint64_t)id & slot_mask;
+    grow_slots(slot + 1);
+    uint32_t i = slots[slot].index;
+    if (i == FASTCONT_FREE) {
+        grow(_size + 1);
+        i = _size++;
+        slots[slot].index = i;
     }
+    // a different generation in the slot: the exporter removed that one and reused the slot
+    slots[slot].gen = ((uint64_t)id >> slot_bits) & gen_mask;
+    (p + i)->id = id;
+    // (p + i)->data = _a;
+    memcpy(&(p + i)->data, &_a, sizeof(T));
 
-    (p + _size)->id = id;
-    // (p + _size)->data = _a;
-    memcpy(&(p + _size)->data, &_a, sizeof(T));
-    ++_size;
-
-    if (id > rollingID) rollingID = id;
-}
\ No newline at end of file
+    if (slot >= (uint32_t)rollingID) rollingID = slot + 1;
+}
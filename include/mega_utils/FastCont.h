@@ -4,20 +4,51 @@
 #include <iostream>
 using namespace std;
 
+// An ID is (generation << FASTCONT_SLOT_BITS) | slot. The slot table maps a
+// slot to the element's index in the dense array, so at_id and remove_id
+// are O(1); a slot's generation goes up whenever it is freed, so an ID of
+// a removed element stays invalid after its slot is reused (until the
+// generation wraps). The top bit of an ID is never set, so IDs fit an int.
+#ifndef FASTCONT_SLOT_BITS
+#define FASTCONT_SLOT_BITS 20
+#endif
+#define FASTCONT_FREE 0xFFFFFFFF
+
 template <class T, class id_data_type>
 struct FastContElement {
     T data;
     id_data_type id;
 };
 
+template <class id_data_type>
+struct FastContSlot {
+    uint32_t index; // into the dense array, FASTCONT_FREE if unused
+    id_data_type gen;
+};
+
 template <class T, class id_data_type = uint32_t>
 class FastCont {
+    static constexpr int id_bits = sizeof(id_data_type) * 8 - 1;
+    static constexpr int slot_bits = id_bits < FASTCONT_SLOT_BITS ? id_bits : FASTCONT_SLOT_BITS;
+    static constexpr uint64_t slot_mask = ((uint64_t)1 << slot_bits) - 1;
+    static constexpr uint64_t gen_mask = ((uint64_t)1 << (id_bits - slot_bits)) - 1;
+
     uint32_t alloc_size;
-    id_data_type rollingID;
+    id_data_type rollingID; // next never used slot
     FastContElement<T, id_data_type> *p;
     bool memory_leak_safety; // izbriše podatke na destruktorju, privzeto = true
     uint32_t _size;
 
+    FastContSlot<id_data_type> *slots;
+    uint32_t slot_count, slot_alloc;
+    uint32_t *free_slots; // freed slots to reuse, may hold some force_import took since
+    uint32_t free_count, free_alloc;
+
+    void grow(uint32_t n); // room for n elements
+    void grow_slots(uint32_t n);
+    id_data_type new_id(uint32_t index); // takes a slot for the element at index
+    void free_slot(id_data_type id);
+
 public:
     ~FastCont();
     FastCont();
@@ -34,12 +65,12 @@ public:
     id_data_type push_back(T);
     void pop_back();
 
-    void remove_index(uint32_t);
-    void remove_id(id_data_type);
+    void remove_index(uint32_t);  // keeps the order, O(n)
+    void remove_id(id_data_type); // moves the last element into the gap, O(1)
     void insert(T, uint32_t);
 
     void clear(); // izbriše podatke
-    void reset(); // resetira zaporedni ID
+    void reset(); // resetira zaporedni ID (on an empty container IDs start over at 0)
     void reserve_n_spots(uint32_t);
     void set_memory_leak_safety(bool);
 
@@ -50,7 +81,7 @@ public:
     int64_t find_and_return_index(T); // -1 če ne najde
 
     void force_import(id_data_type, T); // nastavi ID in podatke
-    void set_rollingID(id_data_type new_roll) { rollingID = new_roll; }
+    void set_rollingID(id_data_type new_roll) { rollingID = new_roll; } // next fresh slot
 };
 
 #include "FastCont.cpp"
\ No newline at end of file
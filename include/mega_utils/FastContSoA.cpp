@@ -0,0 +1,117 @@
+#include "FastContSoA.h"
+
+template <class T, class id_data_type>
+void FastContSoA<T, id_data_type>::grow(uint32_t n) {
+    if (n <= alloc_size) return;
+    if (alloc_size == 0) alloc_size = 1;
+    while (alloc_size < n)
+        alloc_size *= 2;
+    d = (T *)realloc(d, sizeof(T) * alloc_size);
+    ids = (id_data_type *)realloc(ids, sizeof(id_data_type) * alloc_size);
+}
+
+template <class T, class id_data_type>
+id_data_type FastContSoA<T, id_data_type>::push_back(T a) {
+    grow(_size + 1);
+    memcpy(d + _size, &a, sizeof(T));
+    ids[_size] = rollingID++;
+    ++_size;
+    return rollingID - 1;
+}
+
+template <class T, class id_data_type>
+void FastContSoA<T, id_data_type>::pop_back() {
+    if (_size == 0) return;
+    --_size;
+}
+
+template <class T, class id_data_type>
+void FastContSoA<T, id_data_type>::remove_index(uint32_t at) {
+    if (at >= _size) return;
+    memmove(d + at, d + at + 1, sizeof(T) * (_size - at - 1));
+    memmove(ids + at, ids + at + 1, sizeof(id_data_type) * (_size - at - 1));
+    --_size;
+}
+
+template <class T, class id_data_type>
+void FastContSoA<T, id_data_type>::remove_id(id_data_type id) {
+    for (uint32_t i = 0; i < _size; ++i) {
+        if (ids[i] == id) {
+            remove_index(i);
+            return;
+        }
+    }
+}
+
+template <class T, class id_data_type>
+template <class F>
+uint32_t FastContSoA<T, id_data_type>::remove_if(F f) {
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < _size; ++i) {
+        if (f(d[i])) continue;
+        if (kept != i) {
+            memcpy(d + kept, d + i, sizeof(T));
+            ids[kept] = ids[i];
+        }
+        ++kept;
+    }
+    uint32_t removed = _size - kept;
+    _size = kept;
+    return removed;
+}
+
+template <class T, class id_data_type>
+void FastContSoA<T, id_data_type>::clear() {
+    free(d);
+    free(ids);
+    d = nullptr;
+    ids = nullptr;
+    alloc_size = 0;
+    _size = 0;
+}
+
+template <class T, class id_data_type>
+void FastContSoA<T, id_data_type>::reset() {
+    rollingID = 0;
+}
+
+template <class T, class id_data_type>
+void FastContSoA<T, id_data_type>::reserve_n_spots(uint32_t n) {
+    grow(n);
+}
+
+template <class T, class id_data_type>
+T *FastContSoA<T, id_data_type>::at_index(uint32_t at) {
+    if (at >= _size) throw invalid_argument("\"at\" out of bounds");
+    return d + at;
+}
+
+template <class T, class id_data_type>
+T *FastContSoA<T, id_data_type>::at_id(id_data_type searchForID) {
+    for (uint32_t i = 0; i < _size; ++i) // only the ID array is scanned
+        if (ids[i] == searchForID) return d + i;
+#ifdef CONSOLE_LOGGING_ID_NOT_FOUND
+    cout << "E: FastContSoA::at_id\tno ID found!\n";
+#endif
+    return nullptr;
+}
+
+template <class T, class id_data_type>
+id_data_type FastContSoA<T, id_data_type>::get_id_at_index(uint32_t index) {
+    return ids[index];
+}
+
+template <class T, class id_data_type>
+FastContSoA<T, id_data_type>::FastContSoA() {
+    d = nullptr;
+    ids = nullptr;
+    rollingID = 0;
+    alloc_size = 0;
+    _size = 0;
+}
+
+template <class T, class id_data_type>
+FastContSoA<T, id_data_type>::~FastContSoA() {
+    free(d);
+    free(ids);
+}
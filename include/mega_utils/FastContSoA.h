@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+using namespace std;
+
+// FastCont with the IDs in their own array: data() is a plain contiguous
+// T[size()], so hot loops touch only the data and no per-element at_index()
+// check. Same semantics as FastCont (order kept on removal, rolling IDs,
+// memcpy'd T). Loop with for_each(), drop elements with remove_if() in one
+// pass instead of remove_index() inside the loop.
+template <class T, class id_data_type = uint32_t>
+class FastContSoA {
+    uint32_t alloc_size;
+    id_data_type rollingID;
+    T *d;
+    id_data_type *ids;
+    uint32_t _size;
+
+    void grow(uint32_t n); // makes room for n elements
+
+public:
+    ~FastContSoA();
+    FastContSoA();
+    FastContSoA(const FastContSoA &) = delete;
+    FastContSoA &operator=(const FastContSoA &) = delete;
+
+    uint32_t size() { return _size; };
+    T *data() { return d; }                  // size() elements, valid until the next push/insert
+    const id_data_type *id_data() { return ids; }
+
+    id_data_type push_back(T);
+    void pop_back();
+
+    void remove_index(uint32_t);
+    void remove_id(id_data_type);
+    template <class F>
+    uint32_t remove_if(F); // removes where F(T &) is true; returns how many
+
+    void clear(); // izbriše podatke
+    void reset(); // resetira zaporedni ID
+    void reserve_n_spots(uint32_t);
+
+    T *at_index(uint32_t);
+    T *at_id(id_data_type);
+    id_data_type get_id_at_index(uint32_t);
+
+    template <class F>
+    void for_each(F f) {
+        T *__restrict p = d;
+        for (uint32_t i = 0, n = _size; i < n; ++i)
+            f(p[i]);
+    }
+};
+
+#include "FastContSoA.cpp"
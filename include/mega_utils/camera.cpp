@@ -24,7 +24,7 @@ int Camera::simplyInit(int _w = CAM_DEFAULT_W, int _h = CAM_DEFAULT_H, const cha
         SDL_Quit();
         return -1;
     }
-    assignRenderer(SDL_CreateRenderer(wind, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_TARGETTEXTURE));
+    assignRenderer(SDL_CreateRenderer(wind, -1, flags));
     if (!r) {
         cout << "Error creating renderer: " << SDL_GetError() << endl;
         SDL_DestroyWindow(wind);
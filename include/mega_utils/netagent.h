@@ -7,6 +7,45 @@
 #include <windows.h>
 #include <ws2tcpip.h>
 #include <winsock2.h>
+
+#else // __linux__
+
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <cstring>
+
+// Winsock names used by the implementation, mapped onto BSD sockets
+typedef int SOCKET;
+typedef int DWORD;
+#ifndef TRUE
+#define TRUE 1
+#endif
+#define INVALID_SOCKET -1
+#define SOCKET_ERROR -1
+#define SD_SEND SHUT_WR
+#define WSAEWOULDBLOCK EWOULDBLOCK
+#define closesocket close
+#define ioctlsocket ioctl
+#define ZeroMemory(p, n) memset((p), 0, (n))
+#define MAKEWORD(a, b) ((a) | ((b) << 8))
+struct WSADATA {};
+inline int WSAStartup(int, WSADATA *) {
+    signal(SIGPIPE, SIG_IGN); // send() on a closed socket returns an error, like on Windows
+    return 0;
+}
+inline int WSACleanup() { return 0; }
+inline int WSAGetLastError() { return errno; }
+
+#endif // __linux__
+
 #include <iostream>
 
 #include "FastCont.h"
@@ -30,7 +69,7 @@ public:
     NetClient(std::string);
     NetClient();
     ~NetClient();
-    int init(std::string);
+    int init(std::string, const char * = DEFAULT_PORT);
     void closeConnection();
 
     int getConnectionStatus();
@@ -77,11 +116,13 @@ class NetServer {
 
 public:
     ~NetServer();
-    void init();
+    void init(const char * = DEFAULT_PORT);
 
     int acceptNewClient(); // return: -1 no_new_connection/error,  >= 0 ID of new accepted client
     int recieveData(int);
     int sendData(int, const char *, int);
+    int sendSome(int, const char *, int); // return: bytes sent, 0 if the socket buffer is full, -1 error (connection closed)
+    int clientCount() { return ClientSockets.size(); }
     RecievedData *getLastData(int);
 
     void closeConnection(int);
@@ -108,6 +149,4 @@ public:
 
 #include "netagent_c.cpp"
 #include "netagent_s.cpp"
-#include "netagent_s_udp.cpp"
-
-#endif // __linux__
\ No newline at end of file
+#include "netagent_s_udp.cpp"
\ No newline at end of file
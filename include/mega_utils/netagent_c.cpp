@@ -1,7 +1,7 @@
 #include "netagent.h"
 
 NetClient::NetClient() {};
-int NetClient::init(std::string server) {
+int NetClient::init(std::string server, const char *port) {
     err = 0;
     WSADATA wsaData;
     ConnectSocket = INVALID_SOCKET;
@@ -26,7 +26,7 @@ int NetClient::init(std::string server) {
     hints.ai_protocol = IPPROTO_TCP;
 
     // Resolve the server address and port
-    iResult = getaddrinfo(server.c_str(), DEFAULT_PORT, &hints, &result);
+    iResult = getaddrinfo(server.c_str(), port, &hints, &result);
     if (iResult != 0) {
         std::cout << "getaddrinfo failed with error:" << iResult << std::endl;
         WSACleanup();
@@ -48,8 +48,12 @@ int NetClient::init(std::string server) {
         }
 
         // set timeout to 1sec
-        int ReceiveTimeout = 1000;
-        int e = setsockopt(ConnectSocket, SOL_SOCKET, SO_RCVTIMEO, (char *)&ReceiveTimeout, sizeof(int));
+#ifdef __linux__
+        struct timeval ReceiveTimeout = {1, 0}; // BSD sockets take a timeval, Winsock a DWORD of ms
+#else
+        DWORD ReceiveTimeout = 1000;
+#endif
+        setsockopt(ConnectSocket, SOL_SOCKET, SO_RCVTIMEO, (char *)&ReceiveTimeout, sizeof(ReceiveTimeout));
 
         // Connect to server.
         iResult = connect(ConnectSocket, ptr->ai_addr, (int)ptr->ai_addrlen);
@@ -85,11 +89,9 @@ int NetClient::init(std::string server) {
     std::cout << "ConnectSocket in non-blocking mode\n";
 #endif
 
-    // TCP_NODELAY
-    /*
+    // TCP_NODELAY, like the server's client sockets: netplay sends a few bytes of input per frame
     DWORD tr = TRUE;
     setsockopt(ConnectSocket, IPPROTO_TCP, TCP_NODELAY, (const char *)&tr, sizeof(tr));
-    */
     return 0;
 }
 NetClient::NetClient(std::string server) {
@@ -1,6 +1,6 @@
 #include "netagent.h"
 
-void NetServer::init() {
+void NetServer::init(const char *port) {
     ClientSockets.set_rollingID(10);
     WSADATA wsaData;
     int iResult;
@@ -26,7 +26,7 @@ void NetServer::init() {
     hints.ai_flags = AI_PASSIVE;
 
     // Resolve the server address and port
-    iResult = getaddrinfo(NULL, DEFAULT_PORT, &hints, &result);
+    iResult = getaddrinfo(NULL, port, &hints, &result);
     if (iResult != 0) {
         std::cout << "NetServer::NetServer getaddrinfo failed with error: " << iResult << std::endl;
         WSACleanup();
@@ -142,13 +142,13 @@ int NetServer::recieveData(int clientId) {
     if (s == nullptr)
         return recieveData_NO_CLIENT_ERR;
 
-    int iResult = recv(ClientSockets.at_id(clientId)->socket, ClientSockets.at_id(clientId)->recieved.data, MAX_BUF_LEN, 0);
+    int iResult = recv(s->socket, s->recieved.data, MAX_BUF_LEN, 0);
 
     if (iResult == -1 && WSAGetLastError() == WSAEWOULDBLOCK)
         return recieveData_NO_NEW_DATA;
 
     if (iResult > 0) {
-        ClientSockets.at_id(clientId)->recieved.len = iResult;
+        s->recieved.len = iResult;
         return recieveData_OK; // success
     }
 
@@ -157,10 +157,10 @@ int NetServer::recieveData(int clientId) {
 
     // other errors
     std::cout << "NetServer::recieveData (recv) failed with error: " << WSAGetLastError() << " (socket is from now on closed)" << std::endl;
-    iResult = shutdown(ClientSockets.at_id(clientId)->socket, SD_SEND);
+    iResult = shutdown(s->socket, SD_SEND);
     if (iResult == SOCKET_ERROR) {
         // std::cout << "shutdown for client " << clientId << " failed: " << WSAGetLastError() << std::endl;
-        closesocket(ClientSockets.at_id(clientId)->socket);
+        closesocket(s->socket);
     }
     ClientSockets.remove_id(clientId);
     return recieveData_CONN_CLOSED_BY_CLIENT_ERR;
@@ -177,6 +177,23 @@ int NetServer::sendData(int clientId, const char *data, int len) {
     }
     return 0;
 }
+int NetServer::sendSome(int clientId, const char *data, int len) {
+    ClientConnection *s = ClientSockets.at_id(clientId);
+    if (s == nullptr)
+        return -1;
+
+    int iSendResult = send(s->socket, data, len, 0);
+    if (iSendResult == SOCKET_ERROR) {
+        if (WSAGetLastError() == WSAEWOULDBLOCK)
+            return 0; // try the rest later
+        std::cout << "NetServer::sendSome failed with error: " << WSAGetLastError() << " (socket is from now on closed)" << std::endl;
+        closesocket(s->socket);
+        ClientSockets.remove_id(clientId);
+        return -1;
+    }
+    return iSendResult;
+}
+
 RecievedData *NetServer::getLastData(int clientId) {
     ClientConnection *s = ClientSockets.at_id(clientId);
     if (s == nullptr)
@@ -101,7 +101,7 @@ int NetServerUDP::recieveData(bool *newClient) {
         ntohs(si_other.sin_port);
 
 #ifdef CONSOLE_LOGGING_NETWORKING
-        cout << "new data from " << si_other.sin_addr.S_un.S_addr << ":" << si_other.sin_port << endl;
+        cout << "new data from " << si_other.sin_addr.s_addr << ":" << si_other.sin_port << endl;
 #endif
         return recieveData_OK; // success
     }
@@ -123,7 +123,7 @@ int NetServerUDP::sendData(int clientId, const char *data, int len) {
     struct sockaddr_in si_other;
     si_other.sin_family = AF_INET;
     si_other.sin_port = port;
-    si_other.sin_addr.S_un.S_addr = inet_addr(komu.c_str());
+    si_other.sin_addr.s_addr = inet_addr(komu.c_str());
 
     int iSendResult = sendto(ListenSocket, data, len, 0, (struct sockaddr *)&si_other, sizeof(si_other));
 
@@ -0,0 +1,109 @@
+#include "pacer.h"
+
+static int64_t pacerNow() {
+#ifdef __linux__
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static void pacerSleepUntil(int64_t when) {
+#ifdef __linux__
+    timespec ts;
+    ts.tv_sec = when / 1000000000;
+    ts.tv_nsec = when % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+#else
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(when))));
+#endif
+}
+
+static inline void pacerRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+FramePacer::FramePacer(double hz) {
+    std::fill(late, late + PACER_WINDOW, 0);
+    std::fill(oversleep, oversleep + PACER_WINDOW, 0);
+    frames = 0;
+    missed = 0;
+    spinning = total = 0;
+
+    // calibrate: a few short sleeps show how late this machine wakes up
+    int64_t worst = 0;
+    for (int i = 0; i < 8; ++i) {
+        int64_t target = pacerNow() + 200000;
+        pacerSleepUntil(target);
+        worst = std::max(worst, pacerNow() - target);
+    }
+    margin = std::clamp<int64_t>(worst * 2, PACER_MIN_MARGIN, PACER_MAX_MARGIN);
+
+    setRate(hz);
+}
+
+void FramePacer::setRate(double hz) {
+    period = (int64_t)(1e9 / hz);
+    reset();
+}
+
+void FramePacer::reset() {
+    next = pacerNow() + period;
+    t.interval();
+}
+
+double FramePacer::wait() {
+    int64_t start = pacerNow(), now = start;
+    int64_t wake = next - margin;
+    unsigned slot = frames % PACER_WINDOW;
+    oversleep[slot] = 0;
+    if (wake > now) {
+        pacerSleepUntil(wake);
+        now = pacerNow();
+        oversleep[slot] = now - wake;
+        if (now > next) margin = std::min<int64_t>(std::max(margin * 2, now - wake), PACER_MAX_MARGIN); // woke too late: no waiting for adapt()
+    }
+    int64_t spin = now;
+    while (now < next) {
+        pacerRelax();
+        now = pacerNow();
+    }
+    spinning += now - spin;
+    total += now - start;
+
+    late[slot] = now - next;
+    if (now - next > period) { // a hitch: start over instead of rushing frames to catch up
+        next = now + period;
+        ++missed;
+    } else {
+        next += period;
+    }
+    if (++frames % (PACER_WINDOW / 4) == 0) adapt();
+    return t.interval();
+}
+
+// the margin follows the 99th percentile oversleep, with some headroom
+void FramePacer::adapt() {
+    unsigned n = std::min<unsigned>(frames, PACER_WINDOW);
+    int64_t sorted[PACER_WINDOW];
+    std::copy(oversleep, oversleep + n, sorted);
+    unsigned k = n * 99 / 100;
+    std::nth_element(sorted, sorted + k, sorted + n);
+    margin = std::clamp<int64_t>(sorted[k] + sorted[k] / 4 + 20000, PACER_MIN_MARGIN, PACER_MAX_MARGIN);
+}
+
+double FramePacer::getJitter(double percentile) {
+    unsigned n = std::min<unsigned>(frames, PACER_WINDOW);
+    if (n == 0) return 0.;
+    int64_t sorted[PACER_WINDOW];
+    for (unsigned i = 0; i < n; ++i)
+        sorted[i] = late[i] < 0 ? -late[i] : late[i];
+    unsigned k = std::min<unsigned>((unsigned)(percentile * n), n - 1);
+    std::nth_element(sorted, sorted + k, sorted + n);
+    return sorted[k] * 1e-9;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#ifdef __linux__
+#include <errno.h>
+#include <time.h>
+#endif
+#include "timer.h"
+
+// Frame pacer: wait() returns once per period on an absolute schedule
+// (no drift), independent of the monitor. It sleeps until `margin` before
+// the deadline (clock_nanosleep on Linux) and spins the rest. The margin
+// follows the 99th percentile of how late the OS wakes us, so the spin is
+// as short as the machine allows; a wake-up past the deadline grows it at once.
+
+#define PACER_WINDOW 240           // frames of history for percentiles
+#define PACER_MIN_MARGIN 50000     // [ns]
+#define PACER_MAX_MARGIN 4000000   // [ns]
+
+class FramePacer {
+    int64_t period; // [ns]
+    int64_t next;   // deadline of the coming frame, monotonic [ns]
+    int64_t margin; // sleep until next - margin, spin the rest [ns]
+
+    int64_t late[PACER_WINDOW];      // how far past the deadline wait() returned
+    int64_t oversleep[PACER_WINDOW]; // how far past its target each sleep woke
+    unsigned frames;
+    uint64_t missed;         // frames the schedule was given up for
+    int64_t spinning, total; // [ns], for getSpinShare()
+    Timer t;
+
+    void adapt();
+
+public:
+    FramePacer(double hz = 60.);
+    void setRate(double hz);
+    void reset(); // restart the schedule from now, e.g. after a pause
+
+    double wait(); // blocks until the next frame is due; returns seconds since the last wait() like Timer::interval
+
+    double getJitter(double percentile); // |lateness| at this percentile (0..1) over the last PACER_WINDOW frames [s]
+    double getMargin() { return margin * 1e-9; }
+    double getSpinShare() { return total > 0 ? (double)spinning / total : 0.; } // of the time spent in wait()
+    uint64_t getMissed() { return missed; }
+};
+
+#include "pacer.cpp"
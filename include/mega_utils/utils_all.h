@@ -2,6 +2,7 @@
 #include "basicui.h"
 #include "camera.h"
 #include "FastCont.h"
+#include "FastContSoA.h"
 #include "keyboard.h"
 #include "mouse.h"
 #include "netagent.h"
@@ -10,4 +11,5 @@
 #include "smooth.h"
 #include "sprites.h"
 #include "timer.h"
+#include "pacer.h"
 #include "profiler.h"
@@ -1,5 +1,7 @@
 #pragma once
 #include "FastCont.h"
+#include "FastContSoA.h"
 #include "netagent.h"
 #include "smooth.h"
 #include "timer.h"
+#include "pacer.h"
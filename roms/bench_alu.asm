@@ -0,0 +1,19 @@
+; ALU-heavy benchmark: arithmetic, logic and shifts in a tight loop, no drawing.
+; Build: chip8 --asm roms/bench_alu.asm bench_alu.ch8
+
+start:  LD V0, 0
+        LD V2, 0x5A
+loop:   ADD V0, 1
+        LD V1, V0
+        XOR V1, V2
+        ADD V2, V1
+        SHR V3
+        OR V3, V0
+        SUB V4, V1
+        AND V5, V4
+        SHL V5
+        SUBN V6, V2
+        ADD V7, V6
+        SNE V0, 0
+        ADD V8, 1
+        JP loop
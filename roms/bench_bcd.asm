@@ -0,0 +1,12 @@
+; BCD benchmark: FX33 on a running counter, digits read back and summed.
+
+        LD I, digits
+loop:   ADD V4, 7
+        LD B, V4
+        LD V2, [I]
+        ADD V5, V0
+        ADD V5, V1
+        ADD V5, V2
+        JP loop
+
+digits: DB 0, 0, 0
@@ -0,0 +1,13 @@
+; Call-heavy benchmark: recursion 12 deep, then unwind, forever.
+
+DEFINE depth 12
+
+loop:   LD V1, 0
+        CALL rec
+        JP loop
+
+rec:    ADD V1, 1
+        SE V1, depth
+        CALL rec
+        ADD V2, V1
+        RET
@@ -0,0 +1,19 @@
+; Draw-heavy benchmark: tall sprites swept across the screen, cleared every pass.
+
+start:  CLS
+        LD I, sprite
+        LD V1, 0                ; x
+        LD V2, 0                ; y
+row:    DRW V1, V2, 15
+        ADD V1, 5
+        SE V1, 65
+        JP row
+        LD V1, 0
+        ADD V2, 3
+        SE V2, 33
+        JP row
+        JP start
+
+sprite: DB 0b11111111, 0b10000001, 0b10111101, 0b10100101, 0b10100101
+        DB 0b10111101, 0b10000001, 0b11111111, 0b01111110, 0b00111100
+        DB 0b00011000, 0b00111100, 0b01111110, 0b11111111, 0b10011001
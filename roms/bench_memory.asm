@@ -0,0 +1,22 @@
+; Memory benchmark: FX55/FX65 block moves shuffling 16 bytes between two
+; buffers, rotating the registers on the way.
+
+loop:   LD I, buf_a
+        LD VF, [I]
+        LD I, buf_b
+        LD [I], VF
+        LD I, buf_b + 1
+        LD VE, [I]
+        ADD VE, 1
+        LD I, buf_a
+        LD [I], VE
+        LD I, buf_b
+        LD V7, [I]
+        LD I, buf_a + 8
+        LD [I], V7
+        JP loop
+
+        ORG 0x300
+buf_a:  DB 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16
+        ORG 0x400
+buf_b:  DB 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
@@ -0,0 +1,16 @@
+; Self-modifying benchmark: every pass rewrites the immediate of `patch`, and
+; keeps a counter in a data page so both code and data pages get written.
+
+loop:   LD I, patch + 1
+        LD V0, [I]
+        ADD V0, 1
+        LD [I], V0
+patch:  ADD V1, 0               ; immediate changes every pass
+        LD I, counter
+        LD V0, [I]
+        ADD V0, V1
+        LD [I], V0
+        JP loop
+
+        ORG 0x400
+counter: DB 0
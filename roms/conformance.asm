@@ -0,0 +1,274 @@
+; Conformance ROM for the Chip8 core (VF written last). Ends in `pass` or in
+; `fail` with the number of the failing test in VE, also drawn as two decimal
+; digits. The runner patches the `quirks` byte with the core's CHIP8_QUIRK_*
+; mask; each quirk-dependent test (shifts, where FX55/FX65 leave I, VF after
+; 8XY1..8XY3, BXNN) follows that byte, so 0 means shifts on Vx and I left alone.
+; Run headless with: bin/selftest conformance roms/conformance.asm
+
+MACRO test n                    ; start test n
+        LD VE, n
+ENDM
+
+MACRO expect reg, value         ; fail unless reg == value
+        SE reg, value
+        JP fail
+ENDM
+
+MACRO ifquirk bit               ; the next instruction only runs with this quirk (clobbers VC, VF)
+        LD VC, bit
+        AND VC, VD
+        SE VC, 0
+ENDM
+
+        LD I, quirks            ; VD = quirk mask for the whole run
+        LD V0, [I]
+        LD VD, V0
+
+        test 1                  ; 6XNN, 3XNN
+        LD V1, 0x42
+        expect V1, 0x42
+
+        test 2                  ; 4XNN, 5XY0, 9XY0
+        LD V1, 5
+        SNE V1, 6
+        JP fail
+        LD V2, 5
+        SE V1, V2
+        JP fail
+        LD V2, 6
+        SNE V1, V2
+        JP fail
+
+        test 3                  ; 7XNN wraps and leaves VF alone
+        LD VF, 7
+        LD V1, 0xFF
+        ADD V1, 2
+        expect V1, 1
+        expect VF, 7
+
+        test 4                  ; 8XY0..8XY3
+        LD V1, 0b1100
+        LD V2, 0b1010
+        LD V3, V1
+        OR V3, V2
+        expect V3, 0b1110
+        LD V3, V1
+        AND V3, V2
+        expect V3, 0b1000
+        LD V3, V1
+        XOR V3, V2
+        expect V3, 0b0110
+
+        test 5                  ; 8XY4 carry
+        LD V1, 0xF0
+        LD V2, 0x20
+        ADD V1, V2
+        expect V1, 0x10
+        expect VF, 1
+        ADD V1, V2
+        expect V1, 0x30
+        expect VF, 0
+
+        test 6                  ; 8XY5, 8XY7 borrow
+        LD V1, 5
+        LD V2, 3
+        SUB V1, V2
+        expect V1, 2
+        expect VF, 1
+        SUB V1, V2
+        expect V1, 0xFF
+        expect VF, 0
+        LD V1, 3
+        LD V2, 5
+        SUBN V1, V2
+        expect V1, 2
+        expect VF, 1
+
+        test 7                  ; 8XY6, 8XYE shift Vx, flag out (Vy == Vx: same with shift_vy)
+        LD V1, 5
+        SHR V1, V1
+        expect V1, 2
+        expect VF, 1
+        LD V1, 0x81
+        SHL V1, V1
+        expect V1, 0x02
+        expect VF, 1
+
+        test 8                  ; VF as destination: the flag wins
+        LD VF, 0xFF
+        LD V1, 1
+        ADD VF, V1
+        expect VF, 1
+
+        test 9                  ; 2NNN, 00EE nested
+        LD V3, 0
+        CALL sub_outer
+        expect V3, 3
+
+        test 10                 ; BNNN (jump_vx: BXNN jumps to XNN + VX)
+        LD V3, 0                ; the entry BNNN should land on
+        ifquirk 8
+        LD V3, 8
+        LD V0, 4
+        LD V6, 2
+        JP V0, jump_table       ; B600: X = 6
+jump_back:
+
+        test 11                 ; FX55, FX65 (memory_inc: I ends at I + X + 1)
+        LD I, scratch
+        LD V0, 1
+        LD V1, 2
+        LD V2, 3
+        LD [I], V2
+        LD V0, 0
+        LD V1, 0
+        LD V2, 0
+        LD I, scratch
+        LD V2, [I]
+        expect V0, 1
+        expect V1, 2
+        expect V2, 3
+        LD I, scratch           ; where I was left: a second store overwrites scratch or follows it
+        LD V0, 9
+        LD [I], V0
+        LD V0, 8
+        LD [I], V0
+        LD I, scratch
+        LD V1, [I]
+        LD V3, 8
+        LD V4, 2
+        ifquirk 2
+        LD V3, 9
+        ifquirk 2
+        LD V4, 8
+        expect V0, V3
+        expect V1, V4
+
+        test 12                 ; FX33
+        LD I, scratch
+        LD V3, 254
+        LD B, V3
+        LD V2, [I]
+        expect V0, 2
+        expect V1, 5
+        expect V2, 4
+
+        test 13                 ; FX1E
+        LD I, bytes
+        LD V1, 3
+        ADD I, V1
+        LD V0, [I]
+        expect V0, 40
+
+        test 14                 ; FX29, font in memory
+        LD V1, 0xA
+        LD F, V1
+        LD V1, [I]
+        expect V0, 0xF0
+        expect V1, 0x90
+
+        test 15                 ; CXNN with an empty mask
+        RND V1, 0
+        expect V1, 0
+
+        test 16                 ; DXYN collision
+        CLS
+        LD I, bytes + 4
+        LD V1, 0
+        LD V2, 0
+        DRW V1, V2, 1
+        expect VF, 0
+        DRW V1, V2, 1
+        expect VF, 1
+
+        test 17                 ; self-modifying code
+        LD I, patch
+        LD V0, 0x61
+        LD V1, 0x77
+        LD [I], V1
+patch:  LD V1, 0
+        expect V1, 0x77
+
+        test 18                 ; FX15, FX07 count down to 0
+        LD V1, 3
+        LD DT, V1
+wait:   LD V1, DT
+        SE V1, 0
+        JP wait
+
+        test 19                 ; 8XY1..8XY3 leave VF alone (vf_reset: clear it)
+        LD V4, 7
+        ifquirk 4
+        LD V4, 0
+        LD V1, 0b1100
+        LD V2, 0b1010
+        LD VF, 7
+        OR V1, V2
+        expect VF, V4
+        LD VF, 7
+        AND V1, V2
+        expect VF, V4
+        LD VF, 7
+        XOR V1, V2
+        expect VF, V4
+
+        test 20                 ; 8XY6, 8XYE with Vy != Vx (shift_vy: shift Vy into Vx)
+        LD V3, 0x08
+        LD V4, 0
+        ifquirk 1
+        LD V3, 0x40
+        ifquirk 1
+        LD V4, 1
+        LD V1, 0x10
+        LD V2, 0x81
+        SHR V1, V2
+        expect V1, V3
+        expect VF, V4
+        LD V3, 0x20
+        ifquirk 1
+        LD V3, 0x02
+        LD V1, 0x10
+        SHL V1, V2
+        expect V1, V3
+        expect VF, V4
+
+pass:   JP pass
+
+fail:   CLS
+        LD I, scratch
+        LD B, VE
+        LD V2, [I]
+        LD V3, 0
+        LD V4, 0
+        LD F, V1
+        DRW V3, V4, 5
+        LD V3, 5
+        LD F, V2
+        DRW V3, V4, 5
+fail_loop:
+        JP fail_loop
+
+sub_outer:
+        ADD V3, 1
+        CALL sub_inner
+        ADD V3, 1
+        RET
+sub_inner:
+        ADD V3, 1
+        RET
+
+        ORG 0x600
+jump_table:                     ; V0 = 4 picks the third entry, V6 = 2 the second
+        JP fail
+        JP jump_vx
+        JP jump_nnn
+jump_vx:
+        expect V3, 8
+        JP jump_back
+jump_nnn:
+        expect V3, 0
+        JP jump_back
+
+bytes:  DB 10, 20, 30, 40, 0xFF
+scratch: DB 0, 0, 0, 0
+quirks: DB 0
@@ -0,0 +1,17 @@
+/* Interpreter benchmark suite (chip8/bench.h) as its own program; no SDL needed.
+
+   g++ -std=c++17 -O2 -I include src/bench.cpp -o bin/bench
+   bin/bench [rom dir] [instructions]        JSON on stdout, exit code 1 if a workload failed
+*/
+
+#include <cstdlib>
+#include "chip8/bench.h"
+
+int main(int argc, char *argv[]) {
+    const char *dir = argc > 1 ? argv[1] : "roms";
+    uint64_t instructions = argc > 2 ? strtoull(argv[2], nullptr, 10) : BENCH_DEFAULT_INSTRUCTIONS;
+    vector<BenchResult> results;
+    bool ok = chip8_bench_suite(dir, instructions, results);
+    chip8_bench_json(results, cout);
+    return ok ? 0 : 1;
+}
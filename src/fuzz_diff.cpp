@@ -0,0 +1,38 @@
+/* libFuzzer entry point for the differential tester (chip8/difftest.h).
+
+   clang++ -std=c++17 -O2 -g -fsanitize=fuzzer,address -I include src/fuzz_diff.cpp -o bin/fuzz_diff
+   bin/fuzz_diff -max_len=3584 corpus/          (CHIP8_DIFF_ENGINE=fork to pick the engine)
+
+   The input is the ROM; its first two bytes also seed the keypad, and the
+   high nibble of the second is the quirk mask. A divergence prints the
+   report and aborts, which libFuzzer saves as a crash input.
+*/
+
+#include <cstdlib>
+#include "chip8/difftest.h"
+
+static DiffEngine *reference, *engine;
+
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv) {
+    const char *name = getenv("CHIP8_DIFF_ENGINE");
+    reference = new ReferenceEngine;
+    engine = diff_engine_create(name != nullptr ? name : "debugger");
+    if (engine == nullptr) {
+        cerr << "Unknown engine " << name << ", available: " << diff_engine_names << "\n";
+        exit(1);
+    }
+    cerr.setstate(ios::badbit); // unknown opcodes are expected, don't log them
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (size < 2) return 0;
+    DiffHarness harness(*reference, *engine);
+    harness.set_quirks(data[1] >> 4);
+    DiffResult r = harness.run(data, size, DIFF_DEFAULT_FRAMES, data[0] | (data[1] << 8));
+    if (r.diverged) {
+        harness.report(r, cout);
+        abort();
+    }
+    return 0;
+}
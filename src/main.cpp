@@ -1,20 +1,458 @@
 #include <iostream>
+#include <thread>
+#include <vector>
+#include <unordered_map>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 //#include "mega_utils/utils_all.h"  // EVERYTHING!!!
 #include "mega_utils/utils_sdl2.h"
 #include "mega_utils/utils_misc.h"
+#include "chip8/chip8.h"
+#include "chip8/phosphor.h"
+#include "chip8/terminal.h"
+#include "chip8/capture.h"
+#include "chip8/runahead.h"
+#include "chip8/netplay.h"
+#include "chip8/spectate.h"
+#include "chip8/session_server.h"
+#include "chip8/profile.h"
+#include "chip8/trace.h"
+#include "chip8/cfg.h"
+#include "chip8/assembler.h"
+#include "chip8/catalog.h"
+#include "chip8/quirks.h"
+#include "chip8/telemetry.h"
 
 
 using namespace std;
 #define debug(x) std::cout << #x << " = " << x << std::endl;
 
-int main(int argc, char *argv[]) {
+#define FRAME_TIME (1. / 60.)
+
+// 1 2 3 4 / Q W E R / A S D F / Z X C V  ->  1 2 3 C / 4 5 6 D / 7 8 9 E / A 0 B F
+uint16_t keypad_from_keyboard(Keyboard &keyboard) {
+	static const SDL_Scancode layout[16] = {
+		SDL_SCANCODE_X, SDL_SCANCODE_1, SDL_SCANCODE_2, SDL_SCANCODE_3,
+		SDL_SCANCODE_Q, SDL_SCANCODE_W, SDL_SCANCODE_E, SDL_SCANCODE_A,
+		SDL_SCANCODE_S, SDL_SCANCODE_D, SDL_SCANCODE_Z, SDL_SCANCODE_C,
+		SDL_SCANCODE_4, SDL_SCANCODE_R, SDL_SCANCODE_F, SDL_SCANCODE_V};
+	uint16_t mask = 0;
+	for (int k = 0; k < 16; ++k)
+		if (keyboard.get(layout[k])) mask |= 1 << k;
+	return mask;
+}
+
+// Where the next frame comes from: plain/run-ahead, or netplay (which handles its own prediction)
+struct Emulation {
+	Chip8 chip8;
+	RunAhead runahead;
+	NetplaySession *netplay = nullptr;
+	SpectatorBroadcaster *broadcaster = nullptr;
+	int ipf = CHIP8_DEFAULT_IPF;
+#ifdef __linux__
+	TelemetryWriter *telemetry = nullptr;
+#endif
+
+	Emulation() : runahead(0) {}
+	const uint8_t *step(uint16_t keys) {
+		const uint8_t *display;
+		if (netplay != nullptr) {
+			netplay->advance(keys);
+			display = chip8.get_display_buffer();
+		} else {
+			display = runahead.run_frame(chip8, keys, ipf);
+		}
+		if (broadcaster != nullptr) broadcaster->broadcast(chip8.get_display_buffer()); // viewers get the real frame, not the run-ahead one
+		return display;
+	}
+
+#ifdef __linux__
+	// after each presented frame, for --telemetry
+	void report(double frame_time, const FrameCapture &capture, const InputLatency *latency) {
+		if (telemetry == nullptr) return;
+		TelemetrySample &s = telemetry->sample();
+		s.instructions = chip8.cycles() - runahead.speculative_cycles();
+		++s.frames;
+		s.dropped_frames = capture.stats().frames_dropped;
+		s.ipf = ipf;
+		s.runahead = runahead.frames();
+		if (netplay != nullptr) {
+			NetplayStats ns = netplay->stats();
+			s.rollbacks = ns.rollbacks;
+			s.resimulated = ns.resimulated_frames;
+			s.instructions -= ns.resimulated_cycles;
+		}
+		if (latency != nullptr) {
+			LatencyStats ls = latency->stats();
+			s.latency_avg_us = ls.avg * 1e6;
+			s.latency_max_us = ls.max * 1e6;
+		}
+		telemetry->frame_time(frame_time);
+		telemetry->publish();
+	}
+#endif
+};
+
+// Viewer mode: no emulation, the display comes from a --broadcast instance.
+int run_spectator(const char *server, Phosphor &phosphor) {
+	NetClient client;
+	if (client.init(server, SPECTATE_PORT) != 0) return 1;
+	SpectatorClient spectator(&client);
+
 	Camera cam;
-	cam.simplyInit();
+	cam.simplyInit(CAM_DEFAULT_W, CAM_DEFAULT_H, "Chip-8 spectator");
+	SDL_Texture *screen = SDL_CreateTexture(cam.r, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, CHIP8_DISPLAY_WIDTH, CHIP8_DISPLAY_HEIGHT);
+
+	bool loop = true;
+	while (loop && spectator.connected()) {
+		SDL_Event event;
+		while (SDL_PollEvent(&event)) {
+			if (event.type == SDL_QUIT)
+				loop = false;
+		}
+		spectator.poll();
 
+		SDL_SetRenderDrawColor(cam.r, 0, 0, 0, 255);
+		SDL_RenderClear(cam.r);
+		phosphor.update(spectator.get_display_buffer());
+		void *pixels;
+		int pitch;
+		if (SDL_LockTexture(screen, NULL, &pixels, &pitch) == 0) {
+			phosphor.expand_argb(pixels, pitch);
+			SDL_UnlockTexture(screen);
+		}
+		SDL_RenderCopy(cam.r, screen, NULL, NULL);
+		SDL_RenderPresent(cam.r);
+	}
+	SDL_DestroyTexture(screen);
+	return 0;
+}
+
+bool read_file(const char *path, vector<uint8_t> &data) {
+	FILE *f = fopen(path, "rb");
+	if (f == nullptr) {
+		cerr << "Could not open " << path << "\n";
+		return false;
+	}
+	uint8_t buf[4096];
+	size_t n;
+	data.clear();
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+		data.insert(data.end(), buf, buf + n);
+	fclose(f);
+	return true;
+}
+
+// --disasm prints the annotated listing, --cfg the graph in DOT
+int run_cfg(const char *path, bool dot) {
+	vector<uint8_t> rom;
+	if (!read_file(path, rom)) return 1;
+	Chip8CFG cfg;
 	Timer t;
+	cfg.analyze(rom.data(), rom.size());
+	double dt = t.getTime();
+
+	if (dot) {
+		cfg.write_dot(cout);
+		return 0;
+	}
+	cfg.write_listing(cout);
+	int code = 0, data = 0;
+	for (int a = 0; a < CHIP8_MEMORY_SIZE; ++a) {
+		code += cfg.code_map()[a] == CFG_CODE;
+		data += cfg.code_map()[a] == CFG_DATA;
+	}
+	cout << "\n" << rom.size() << " bytes: " << code << " instructions, " << data << " data bytes, " << cfg.blocks().size() << " blocks, "
+		 << cfg.unresolved_jumps() << " unresolved BNNN, analyzed in " << dt * 1e6 << " us\n";
+	return 0;
+}
+
+// --quirks auto (default) picks them from the ROM, anything else is a quirk list or "none"
+bool apply_quirks(Chip8 &chip8, const char *rom_path, const char *spec) {
+	uint32_t q;
+	if (strcmp(spec, "auto") != 0) {
+		if (!chip8_parse_quirks(spec, q)) {
+			cerr << "--quirks: expected auto, none or a list of " << chip8_quirk_names(CHIP8_QUIRK_ALL) << "\n";
+			return false;
+		}
+		chip8.set_quirks(q);
+		return true;
+	}
+	vector<uint8_t> rom;
+	if (!read_file(rom_path, rom)) return false;
+	QuirkGuess g = chip8_detect_quirks(rom.data(), rom.size());
+	chip8.set_quirks(g.quirks);
+	cout << "Quirks: " << chip8_quirk_names(g.quirks) << " (" << chip8_variant_name(g.variant) << ", confidence "
+		 << (int)(g.confidence * 100) << "%: " << g.reasons << ")\n";
+	if (g.unsupported) cout << "Warning: this ROM uses opcodes this interpreter does not implement\n";
+	return true;
+}
+
+// --asm in.asm out.ch8
+int run_asm(const char *in, const char *out) {
+	Chip8Assembler as;
+	vector<uint8_t> rom;
+	Timer t;
+	if (!as.assemble_file(in, rom)) {
+		as.print_errors(cerr, in);
+		return 1;
+	}
+	double dt = t.getTime();
+	FILE *f = fopen(out, "wb");
+	if (f == nullptr || fwrite(rom.data(), 1, rom.size(), f) != rom.size()) {
+		cerr << "Could not write " << out << "\n";
+		if (f != nullptr) fclose(f);
+		return 1;
+	}
+	fclose(f);
+	cout << out << ": " << rom.size() << " bytes, assembled in " << dt * 1e6 << " us\n";
+	return 0;
+}
+
+#ifdef __linux__
+// --catalog dir [profiles]: lists the ROMs under dir, the index lives in dir/.c8index
+int run_catalog(const char *dir, const char *database) {
+	RomCatalog catalog;
+	if (database != nullptr && !catalog.load_database(database)) return 1;
+	string index = string(dir) + "/.c8index";
+	catalog.load_index(index.c_str());
+	catalog.scan(dir);
+	catalog.save_index(index.c_str());
+
+	char hex[41];
+	for (const RomEntry &e : catalog.entries()) {
+		chip8_sha1_hex(e.sha1, hex);
+		cout << hex << "  " << (e.known ? chip8_variant_name(e.profile.variant) : "?") << "  " << e.path;
+		if (e.known && !e.profile.title.empty()) cout << "  (" << e.profile.title << ")";
+		cout << "\n";
+	}
+	CatalogStats s = catalog.stats();
+	cout << s.files << " ROMs, " << s.hashed << " hashed (" << s.bytes_hashed / 1024 << " KB), " << s.cached
+		 << " from the index, " << s.seconds * 1000. << " ms\n";
+	return 0;
+}
+
+int run_session_server(int workers) {
+	SessionServer server(workers);
+	if (!server.init(SESSION_PORT)) return 1;
+	cout << "Hosting Chip-8 sessions on port " << SESSION_PORT << "\n";
+
+	thread report([&server]() {
+		for (;;) {
+			this_thread::sleep_for(chrono::seconds(5));
+			SessionStats s = server.stats();
+			cout << "sessions " << s.connections << " (" << s.active << " active), frames " << s.frames << ", dropped " << s.dropped << ", sent " << s.bytes_sent / 1024 << " KB, worst tick " << s.worst_tick * 1000. << " ms\n";
+		}
+	});
+	report.detach();
+	server.run();
+	return 0;
+}
+#endif
+
+void print_trace_stats(TraceWriter &trace) {
+	if (!trace.is_open()) return;
+	trace.close();
+	TraceStats s = trace.stats();
+	cout << "Trace: " << s.records_written << " instructions written, interpreter waited " << s.stalls << " times\n";
+}
+
+void print_capture_stats(FrameCapture &capture) {
+	if (!capture.is_open()) return;
+	capture.close();
+	CaptureStats s = capture.stats();
+	cout << "Capture: " << s.frames_written << " frames written, " << s.frames_dropped << " dropped, max queue depth " << s.max_queue_depth << "/" << CAPTURE_QUEUE_LEN << "\n";
+}
+
+#ifdef __linux__
+int run_terminal(Emulation &emu, TerminalMode mode, FrameCapture &capture) {
+	TerminalRenderer term(mode);
+	term.init();
+
+	FramePacer pacer(1. / FRAME_TIME);
+	bool quit = false;
+	while (!quit) {
+		const uint8_t *display = emu.step(term.poll_keys(&quit));
+
+		term.render(display, CHIP8_DISPLAY_WIDTH, CHIP8_DISPLAY_HEIGHT);
+		capture.push(display);
+
+		emu.report(pacer.wait(), capture, nullptr);
+	}
+	return 0;
+}
+#endif
+
+#ifdef __linux__
+// --top [seconds]: every instance publishing --telemetry, refreshed like top
+int run_top(double interval) {
+	struct Prev {
+		uint64_t instructions, frames;
+	};
+	unordered_map<string, Prev> prev;
+	for (;;) {
+		cout << "\x1b[H\x1b[2J"
+			 << "      PID  FRAMES/S    MIPS  IPF  DROPPED  LAT avg/max ms  WORST ms  ROLLBACKS  frame time <1 <2 <4 <8 <16 <32 ... ms\n";
+		vector<string> names = chip8_telemetry_list();
+		for (const string &name : names) {
+			TelemetryReader reader;
+			TelemetrySample s;
+			if (!reader.open(name.c_str())) continue;
+			if (!reader.alive()) {
+				printf("%9llu  dead, rm /dev/shm%s\n", (unsigned long long)reader.pid(), name.c_str());
+				continue;
+			}
+			if (!reader.read(s)) continue;
+			Prev &p = prev[name];
+			double fps = p.frames != 0 ? (s.frames - p.frames) / interval : 0.;
+			double mips = p.frames != 0 ? (s.instructions - p.instructions) / interval / 1e6 : 0.;
+			p = {s.instructions, s.frames};
+			printf("%9llu  %8.1f  %6.2f  %3llu  %7llu  %6.1f/%-7.1f  %8.1f  %9llu  ", (unsigned long long)reader.pid(), fps, mips,
+				   (unsigned long long)s.ipf, (unsigned long long)s.dropped_frames, s.latency_avg_us / 1000., s.latency_max_us / 1000.,
+				   s.frame_time_max_us / 1000., (unsigned long long)s.rollbacks);
+			for (int k = 0; k < TELEMETRY_BUCKETS; ++k)
+				printf(" %llu", (unsigned long long)s.frame_time[k]);
+			printf("\n");
+		}
+		if (names.empty()) cout << "no instances (start one with --telemetry)\n";
+		cout.flush();
+		this_thread::sleep_for(chrono::duration<double>(interval));
+	}
+	return 0;
+}
+#endif
+
+int main(int argc, char *argv[]) {
+	Emulation emu;
+	Chip8 &chip8 = emu.chip8;
+	NetServer server;
+	NetClient client;
+	NetplaySession netplay(chip8);
+	bool host = false;
+	const char *join = nullptr;
+	NetServer spectate_server;
+	SpectatorBroadcaster broadcaster(&spectate_server);
+	const char *spectate = nullptr;
+	Phosphor phosphor(CHIP8_DISPLAY_WIDTH, CHIP8_DISPLAY_HEIGHT); // decay 0 + rise 255 = plain on/off
+	bool terminal = false;
+	bool braille = false;
+	FrameCapture capture;
+	Chip8Profile profile;
+	bool profiling = false;
+	TraceWriter trace;
+	static Chip8TraceRing trace_ring; // 512 KB, keep it off the stack
+#ifdef __linux__
+	TelemetryWriter telemetry;
+#endif
+	const char *rom_path = nullptr;
+	const char *quirks = "auto";
+	double pace = 0.; // Hz, 0 = one frame per vsync
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--phosphor") == 0) {
+			phosphor.set_decay(.8);
+			phosphor.set_rise(160);
+		} else if (strcmp(argv[i], "--terminal") == 0) {
+			terminal = true;
+		} else if (strcmp(argv[i], "--braille") == 0) {
+			terminal = braille = true;
+		} else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			const char *path = argv[++i];
+			size_t len = strlen(path);
+			CaptureFormat format = (len > 4 && strcmp(path + len - 4, ".y4m") == 0) ? CAPTURE_Y4M : CAPTURE_RAW_RGB;
+			capture.open(path, format, CHIP8_DISPLAY_WIDTH, CHIP8_DISPLAY_HEIGHT, 4);
+		} else if (strcmp(argv[i], "--runahead") == 0 && i + 1 < argc) {
+			emu.runahead.set_frames(atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--pace") == 0) { // a fixed emulation rate whatever the monitor refresh; the renderer runs without vsync
+			pace = (i + 1 < argc && argv[i + 1][0] != '-') ? atof(argv[++i]) : 1. / FRAME_TIME;
+		} else if (strcmp(argv[i], "--ipf") == 0 && i + 1 < argc) {
+			emu.ipf = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--quirks") == 0 && i + 1 < argc) {
+			quirks = argv[++i];
+		} else if (strcmp(argv[i], "--profile") == 0) {
+			chip8.set_profile(&profile);
+			profiling = true;
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			if (!chip8_tracing) cout << "--trace: built without CHIP8_TRACE=1, the trace will be empty\n";
+			if (trace.open(argv[++i], &trace_ring)) chip8.set_trace(&trace_ring);
+		} else if (strcmp(argv[i], "--trace-diff") == 0 && i + 2 < argc) {
+			int64_t cycle = chip8_trace_diff(argv[i + 1], argv[i + 2], cout);
+			return cycle == -1 ? 0 : 1;
+		} else if (strcmp(argv[i], "--host") == 0) {
+			host = true;
+		} else if (strcmp(argv[i], "--join") == 0 && i + 1 < argc) {
+			join = argv[++i];
+		} else if (strcmp(argv[i], "--broadcast") == 0) {
+			spectate_server.init(SPECTATE_PORT);
+			emu.broadcaster = &broadcaster;
+		} else if (strcmp(argv[i], "--spectate") == 0 && i + 1 < argc) {
+			spectate = argv[++i];
+#ifdef __linux__
+		} else if (strcmp(argv[i], "--server") == 0) {
+			int workers = (i + 1 < argc && argv[i + 1][0] != '-') ? atoi(argv[++i]) : 0;
+			return run_session_server(workers);
+		} else if (strcmp(argv[i], "--loadgen") == 0 && i + 4 < argc) {
+			const char *ip = argv[i + 1];
+			return session_loadgen(ip, atoi(argv[i + 2]), atoi(argv[i + 3]), atoi(argv[i + 4]));
+#endif
+		} else if (strcmp(argv[i], "--disasm") == 0 && i + 1 < argc) {
+			return run_cfg(argv[i + 1], false);
+		} else if (strcmp(argv[i], "--cfg") == 0 && i + 1 < argc) {
+			return run_cfg(argv[i + 1], true);
+		} else if (strcmp(argv[i], "--asm") == 0 && i + 2 < argc) {
+			return run_asm(argv[i + 1], argv[i + 2]);
+#ifdef __linux__
+		} else if (strcmp(argv[i], "--telemetry") == 0) {
+			if (telemetry.open()) emu.telemetry = &telemetry;
+		} else if (strcmp(argv[i], "--top") == 0) {
+			double interval = (i + 1 < argc && argv[i + 1][0] != '-') ? atof(argv[++i]) : 1.;
+			return run_top(interval > 0. ? interval : 1.);
+		} else if (strcmp(argv[i], "--catalog") == 0 && i + 1 < argc) {
+			return run_catalog(argv[i + 1], i + 2 < argc ? argv[i + 2] : nullptr);
+#endif
+		} else if (argv[i][0] != '-') {
+			if (!chip8.load_rom(argv[i])) return 1;
+			rom_path = argv[i];
+			chip8.start_execution();
+		}
+	}
+	if (rom_path != nullptr && !apply_quirks(chip8, rom_path, quirks)) return 1;
+
+	if (spectate != nullptr)
+		return run_spectator(spectate, phosphor);
+
+	if (host) {
+		server.init();
+		cout << "Waiting for player 2 on port " << DEFAULT_PORT << "...\n";
+		int id;
+		while ((id = server.acceptNewClient()) < 0)
+			this_thread::sleep_for(chrono::milliseconds(10));
+		netplay.host(&server, id);
+		emu.netplay = &netplay;
+	} else if (join != nullptr) {
+		if (client.init(join) != 0) return 1;
+		netplay.join(&client);
+		emu.netplay = &netplay;
+	}
+
+#ifdef __linux__
+	if (terminal) {
+		int ret = run_terminal(emu, braille ? TERMINAL_BRAILLE : TERMINAL_HALF_BLOCK, capture);
+		print_capture_stats(capture);
+		print_trace_stats(trace);
+		if (profiling) chip8_profile_report(profile, chip8.memory(), cout);
+		return ret;
+	}
+#endif
+
+	Camera cam;
+	cam.simplyInit(CAM_DEFAULT_W, CAM_DEFAULT_H, "Simply Good", nullptr, pace > 0. ? CAM_DEFAULT_FLAGS & ~SDL_RENDERER_PRESENTVSYNC : CAM_DEFAULT_FLAGS); // the pacer sets the rate, not the monitor
+	SDL_Texture *screen = SDL_CreateTexture(cam.r, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, CHIP8_DISPLAY_WIDTH, CHIP8_DISPLAY_HEIGHT);
+
+	Timer t, title_timer;
+	FramePacer pacer(pace > 0. ? pace : 1. / FRAME_TIME);
 	Keyboard keyboard;
+	InputLatency latency;
+	uint8_t shown[CHIP8_DISPLAY_BUFFER_SIZE] = {0};
 	bool loop = true;
 	while (loop) {
 		SDL_Event event;
@@ -23,14 +461,49 @@ int main(int argc, char *argv[]) {
 			if (event.type == SDL_QUIT)
 				loop = false;
 		}
+		uint16_t keys = keypad_from_keyboard(keyboard);
+		latency.on_input(keys, shown);
+		const uint8_t *display = emu.step(keys);
+		memcpy(shown, display, CHIP8_DISPLAY_BUFFER_SIZE);
 
 		double dt = t.interval();
 
 		SDL_SetRenderDrawColor(cam.r, 0, 0, 0, 255);
 		SDL_RenderClear(cam.r);
 
+		phosphor.update(display);
+		void *pixels;
+		int pitch;
+		if (SDL_LockTexture(screen, NULL, &pixels, &pitch) == 0) {
+			phosphor.expand_argb(pixels, pitch);
+			SDL_UnlockTexture(screen);
+		}
+		SDL_RenderCopy(cam.r, screen, NULL, NULL);
+		capture.push(display);
 
 		SDL_RenderPresent(cam.r);
+		latency.on_present(display);
+		if (pace > 0.) pacer.wait();
+#ifdef __linux__
+		emu.report(dt, capture, &latency);
+#endif
+
+		if (title_timer.getTime() > 1.) {
+			title_timer.interval();
+			LatencyStats ls = latency.stats();
+			char title[256];
+			int n = snprintf(title, sizeof(title), "Chip-8 | run-ahead %d | input latency avg %.1f ms, max %.1f ms", emu.runahead.frames(), ls.avg * 1000., ls.max * 1000.);
+			if (pace > 0.) n += snprintf(title + n, sizeof(title) - n, " | %.3f Hz, jitter p99 %.2f ms, spin %.0f%%", pace, pacer.getJitter(.99) * 1000., pacer.getSpinShare() * 100.);
+			if (emu.netplay != nullptr) {
+				NetplayStats ns = netplay.stats();
+				snprintf(title + n, sizeof(title) - n, " | rollbacks %.1f/s, resim %.1f frames/s%s", ns.rollbacks_per_sec, ns.resimulated_per_sec, netplay.connected() ? "" : " | DISCONNECTED");
+			}
+			SDL_SetWindowTitle(cam.wind, title);
+		}
 	}
+	SDL_DestroyTexture(screen);
+	print_capture_stats(capture);
+	print_trace_stats(trace);
+	if (profiling) chip8_profile_report(profile, chip8.memory(), cout);
 	return 0;
-}
\ No newline at end of file
+}
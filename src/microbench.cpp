@@ -0,0 +1,275 @@
+/* Micro-benchmarks for the emulator's building blocks; no SDL needed.
+
+   g++ -std=c++17 -O2 -I include src/microbench.cpp -o bin/microbench -lpthread
+   bin/microbench fork | debug | timetravel | fastcont [n] | asm | coro [machines]
+
+   coro needs -std=c++20. fork and timetravel also check what they measure
+   and return 1 if it is wrong.
+*/
+
+#include <cstdlib>
+#include <vector>
+#include "mega_utils/timer.h"
+#include "mega_utils/FastCont.h"
+#include "mega_utils/FastContSoA.h"
+#include "chip8/chip8.h"
+#include "chip8/debugger.h"
+#include "chip8/timetravel.h"
+#include "chip8/assembler.h"
+#include "chip8/coroutine.h"
+
+// Forks per second and memory held by 1000 live forks, before and after each fork runs a frame of BCD stores.
+int fork_bench() {
+    static const uint8_t rom[] = {
+        0xA3, 0x00, // I = 0x300
+        0x71, 0x01, // loop: V1 += 1
+        0xF1, 0x33, //   BCD V1
+        0x12, 0x02, // goto loop
+    };
+    const int live = 1000, rounds = 200;
+
+    Chip8 parent;
+    parent.load_rom(rom, sizeof(rom));
+    parent.start_execution();
+    parent.run_frame();
+
+    vector<Chip8> forks;
+    forks.reserve(live);
+    Timer t;
+    for (int r = 0; r < rounds; ++r) {
+        forks.clear();
+        for (int i = 0; i < live; ++i)
+            forks.push_back(parent.fork());
+    }
+    double dt = t.getTime();
+    double shared_kb = (live * sizeof(Chip8) + (Chip8Memory::live_pages - CHIP8_PAGES) * sizeof(Chip8Page)) / 1024.;
+    for (Chip8 &f : forks) f.run_frame();
+    double written_kb = (live * sizeof(Chip8) + (Chip8Memory::live_pages - CHIP8_PAGES) * sizeof(Chip8Page)) / 1024.;
+
+    vector<Chip8Snapshot> snaps(live); // the copy-everything alternative
+    t.interval();
+    for (int r = 0; r < rounds; ++r)
+        for (int i = 0; i < live; ++i)
+            parent.save_state(snaps[i]);
+    double dt_copy = t.getTime();
+    double flat_kb = live * sizeof(Chip8Snapshot) / 1024.;
+
+    // whole-page writes onto shared pages must still XOR out the old bytes
+    bool hash_ok = true;
+    snaps[0].memory[0x300] ^= 0xFF;
+    Chip8 loaded = parent.fork(), reloaded = parent.fork();
+    loaded.load_state(snaps[0]);
+    reloaded.load_rom(rom, sizeof(rom) - 2);
+    hash_ok &= loaded.state_hash() == loaded.full_state_hash();
+    hash_ok &= reloaded.state_hash() == reloaded.full_state_hash();
+
+    cout << "fork: " << live * rounds / dt / 1e6 << " M forks/s (save_state " << live * rounds / dt_copy / 1e6 << " M/s)\n"
+         << live << " live forks: " << shared_kb << " KB shared, " << written_kb << " KB after one frame each (snapshots: " << flat_kb << " KB)\n"
+         << "state hash after load_state/load_rom on a fork: " << (hash_ok ? "in sync" : "OUT OF SYNC") << "\n";
+    return hash_ok ? 0 : 1;
+}
+
+// Instructions per second of the production loop against the debugger's instantiation of it.
+int debug_bench() {
+    static const uint8_t rom[] = {
+        0xA3, 0x00, // I = 0x300
+        0x71, 0x01, // loop: V1 += 1
+        0x82, 0x14, //   V2 += V1
+        0xF1, 0x33, //   BCD V1
+        0x60, 0x00, //   V0 = 0
+        0xD0, 0x05, //   draw 5 rows at (V0, V0)
+        0x12, 0x02, // goto loop
+    };
+    const int ipf = 1000, frames = 20000;
+
+    auto measure = [&](auto run) {
+        Chip8 c;
+        c.load_rom(rom, sizeof(rom));
+        c.start_execution();
+        Timer t;
+        run(c);
+        return (double)ipf * frames / t.getTime() / 1e6;
+    };
+    double plain = measure([&](Chip8 &c) {
+        for (int f = 0; f < frames; ++f) c.run_frame(ipf);
+    });
+    double debug_idle = measure([&](Chip8 &c) {
+        Chip8Debugger d(c, ipf);
+        d.cont(frames);
+    });
+    double debug_armed = measure([&](Chip8 &c) {
+        Chip8Debugger d(c, ipf);
+        for (int a = 0x400; a < 0x800; a += 2) d.set_breakpoint(a); // never reached
+        d.set_watchpoint(0x400, 0x100);
+        d.add_condition({0xE, DEBUG_EQUALS, 0x42});
+        d.cont(frames);
+    });
+
+    cout << "run_frame:                  " << plain << " M instructions/s\n"
+         << "debugger, nothing set:      " << debug_idle << " M instructions/s\n"
+         << "debugger, bp + watch + cond: " << debug_armed << " M instructions/s\n";
+    return 0;
+}
+
+// Records an hour of a ROM that reads keys, draws random sprites and stores BCD, then seeks around in it.
+int timetravel_bench() {
+    static const uint8_t rom[] = {
+        0xA3, 0x00, // loop: I = 0x300
+        0xC1, 0x3F, //   V1 = rand & 63
+        0xC2, 0x1F, //   V2 = rand & 31
+        0xD1, 0x25, //   draw at (V1, V2)
+        0xE1, 0xA1, //   skip if key (V1 & 15) not pressed
+        0x74, 0x01, //     V4 += 1
+        0xF4, 0x33, //   BCD V4 at 0x300
+        0x12, 0x00, // goto loop
+    };
+    const uint32_t frames = 60 * 60 * 60, seeks = 200;
+
+    Chip8 chip8;
+    chip8.load_rom(rom, sizeof(rom));
+    chip8.start_execution();
+    uint32_t host_frames = 0; // a seek must not take the host's handler away
+    chip8.set_event_handler([](void *user, uint32_t) { ++*(uint32_t *)user; }, &host_frames, CHIP8_EVENT_FRAME);
+    Chip8TimeTravel tt(chip8);
+    Timer t;
+    uint16_t keys = 0;
+    for (uint32_t f = 0; f < frames; ++f) {
+        if (rand() % 30 == 0) keys = rand() & 0xFFFF;
+        tt.run_frame(keys);
+    }
+    double record = t.getTime();
+    uint64_t head_hash = chip8.state_hash();
+
+    double worst = 0, total = 0;
+    bool same = true;
+    for (uint32_t i = 0; i < seeks; ++i) {
+        uint64_t target = ((uint64_t)rand() << 16 ^ rand()) % tt.head();
+        t.interval();
+        tt.seek(target);
+        double dt = t.getTime();
+        uint64_t h = chip8.state_hash();
+        tt.seek(target / 2); // come back to it from the other side
+        tt.seek(target);
+        same &= h == chip8.state_hash();
+        if (i % 4 == 0) {
+            t.interval();
+            tt.run_back_to_write(0x302);
+            dt = max(dt, t.getTime());
+        }
+        worst = max(worst, dt);
+        total += dt;
+    }
+    tt.seek(tt.head());
+    same &= chip8.state_hash() == head_hash;
+    chip8.run_frame();
+    bool handler = host_frames == 1;
+
+    cout << "time travel: " << frames << " frames (" << tt.head() << " instructions) recorded in " << record << " s, "
+         << tt.checkpoints() << " checkpoints, " << (tt.memory_bytes() + Chip8Memory::live_pages * sizeof(Chip8Page)) / (1024. * 1024.) << " MB\n"
+         << "seek: avg " << total / seeks * 1000. << " ms, worst " << worst * 1000. << " ms -> " << (same ? "replays match" : "REPLAY DIVERGED")
+         << ", " << (handler ? "event handler kept" : "EVENT HANDLER LOST") << "\n";
+    return same && handler ? 0 : 1;
+}
+
+// asm: how many random programs per second the assembler turns out
+int asm_random_bench() {
+    const int programs = 10000;
+    Chip8Assembler as;
+    string source;
+    vector<uint8_t> rom;
+    uint32_t seed = 0x1234567;
+    size_t bytes = 0;
+    Timer t;
+    for (int i = 0; i < programs; ++i) {
+        chip8_random_source(seed, 100, source);
+        if (!as.assemble(source, rom)) {
+            as.print_errors(cerr, "random");
+            return 1;
+        }
+        bytes += rom.size();
+    }
+    double dt = t.getTime();
+    cout << programs << " random programs (" << bytes / programs << " bytes each) in " << dt << " s, "
+         << programs / dt << " programs/s\n";
+    return 0;
+}
+
+// fastcont [n]: particle-style update over FastCont (at_index loop) and
+// FastContSoA (for_each), then culling 1% of them (remove_index vs remove_if)
+struct BenchParticle {
+    double x, y, vx, vy, life; // the doubles Particle (particles.h) updates
+};
+
+int fastcont_bench(uint32_t n) {
+    const int passes = 100;
+    const double dt = 1. / 60.;
+    FastCont<BenchParticle> aos;
+    FastContSoA<BenchParticle> soa;
+    aos.reserve_n_spots(n);
+    soa.reserve_n_spots(n);
+    for (uint32_t i = 0; i < n; ++i) {
+        BenchParticle p = {0., 0., (double)(i % 7), (double)(i % 5), 1. + (i % 100) * passes * dt};
+        aos.push_back(p);
+        soa.push_back(p);
+    }
+
+    Timer t;
+    for (int k = 0; k < passes; ++k)
+        for (uint32_t i = 0; i < aos.size(); ++i) {
+            BenchParticle *p = aos.at_index(i);
+            p->x += p->vx * dt;
+            p->y += p->vy * dt;
+            p->life -= dt;
+        }
+    double aos_time = t.interval();
+    for (int k = 0; k < passes; ++k)
+        soa.for_each([dt](BenchParticle &p) {
+            p.x += p.vx * dt;
+            p.y += p.vy * dt;
+            p.life -= dt;
+        });
+    double soa_time = t.interval();
+    if (memcmp(aos.at_index(n - 1), soa.at_index(n - 1), sizeof(BenchParticle)) != 0) {
+        cout << "fastcont bench: layouts disagree\n";
+        return 1;
+    }
+
+    // remove_index() inside the loop moves the tail once per removal: kept to 100k elements
+    uint32_t m = n < 100000 ? n : 100000;
+    while (aos.size() > m)
+        aos.pop_back();
+    t.interval();
+    uint32_t removed = 0;
+    for (uint32_t i = 0; i < aos.size(); ++i)
+        if (aos.at_index(i)->life <= 0.) {
+            aos.remove_index(i--);
+            ++removed;
+        }
+    double aos_cull = t.interval();
+    uint32_t removed_soa = soa.remove_if([](BenchParticle &p) { return p.life <= 0.; });
+    double soa_cull = t.interval();
+
+    cout << n << " elements, " << sizeof(BenchParticle) << " B each (FastCont element " << sizeof(FastContElement<BenchParticle, uint32_t>) << " B)\n"
+         << "  update  FastCont " << aos_time / passes * 1e3 << " ms/pass, FastContSoA " << soa_time / passes * 1e3 << " ms/pass ("
+         << aos_time / soa_time << "x)\n"
+         << "  cull    FastCont " << aos_cull * 1e3 << " ms for " << removed << " of " << m << ", FastContSoA " << soa_cull * 1e3
+         << " ms for " << removed_soa << " of " << n << "\n";
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *what = argc > 1 ? argv[1] : "";
+    if (strcmp(what, "fork") == 0) return fork_bench();
+    if (strcmp(what, "debug") == 0) return debug_bench();
+    if (strcmp(what, "timetravel") == 0) return timetravel_bench();
+    if (strcmp(what, "fastcont") == 0) return fastcont_bench(argc > 2 ? strtoul(argv[2], nullptr, 10) : 1000000);
+    if (strcmp(what, "asm") == 0) return asm_random_bench();
+#ifdef CHIP8_COROUTINES
+    if (strcmp(what, "coro") == 0) {
+        chip8_coroutine_bench(argc > 2 ? atoi(argv[2]) : 64, 3600, cout);
+        return 0;
+    }
+#endif
+    cerr << "usage: " << argv[0] << " fork | debug | timetravel | fastcont [n] | asm | coro [machines]\n";
+    return 1;
+}
@@ -0,0 +1,407 @@
+/* Self-tests that need no SDL: netplay over loopback, the differential
+   tester, the conformance ROM, the checked-in ROMs against their sources
+   and FastCont against a std::map model.
+
+   g++ -std=c++17 -O2 -I include src/selftest.cpp -o bin/selftest -lpthread
+   bin/selftest                                            all of them, exit code 1 if any fails
+   bin/selftest netplay
+   bin/selftest difftest engine [--quirks list] [roms...]  random programs without ROMs
+   bin/selftest conformance file.asm [quirks]              every quirk mask without one
+   bin/selftest roms [dir]                                 each .ch8 in dir equals its assembled .asm
+   bin/selftest fastcont [operations]
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <dirent.h>
+#include <map>
+#include <thread>
+#include <vector>
+#include "mega_utils/timer.h"
+#include "mega_utils/netagent.h"
+#include "mega_utils/FastCont.h"
+#include "chip8/chip8.h"
+#include "chip8/netplay.h"
+#include "chip8/difftest.h"
+#include "chip8/assembler.h"
+#include "chip8/quirks.h"
+
+static bool read_file(const char *path, vector<uint8_t> &data) {
+    FILE *f = fopen(path, "rb");
+    if (f == nullptr) {
+        cerr << "Could not open " << path << "\n";
+        return false;
+    }
+    uint8_t buf[4096];
+    size_t n;
+    data.clear();
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        data.insert(data.end(), buf, buf + n);
+    fclose(f);
+    return true;
+}
+
+// Two sessions talking over 127.0.0.1 with random inputs; their states must match once all input is confirmed.
+int netplay_selftest() {
+    static const uint8_t rom[] = {
+        0x62, 0x0F, // V2 = 0x0F
+        0x60, 0x00, // V0 = 0
+        0xE0, 0xA1, // loop: skip if key V0 not pressed
+        0x71, 0x01, //   V1 += 1
+        0x70, 0x01, // V0 += 1
+        0x80, 0x22, // V0 &= V2
+        0xA3, 0x00, // I = 0x300
+        0xF1, 0x33, // BCD V1
+        0x12, 0x04, // goto loop
+    };
+    const uint32_t frames = 1200;
+
+    NetServer server;
+    server.init();
+    NetClient client("127.0.0.1");
+    int client_id = -1;
+    for (int tries = 0; client_id < 0 && tries < 1000; ++tries) {
+        client_id = server.acceptNewClient();
+        if (client_id < 0) this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    if (client_id < 0) {
+        cout << "netplay selftest: loopback connection failed\n";
+        return 1;
+    }
+
+    Chip8 a, b;
+    a.load_rom(rom, sizeof(rom));
+    b.load_rom(rom, sizeof(rom));
+    a.start_execution();
+    b.start_execution();
+    NetplaySession host(a), guest(b);
+    host.host(&server, client_id);
+    guest.join(&client);
+
+    uint16_t keys_a = 0, keys_b = 0;
+    Timer t;
+    while (host.frame() < frames || guest.frame() < frames) {
+        if (rand() % 8 == 0) keys_a = 1 << (rand() % 16);
+        if (rand() % 8 == 0) keys_b = 1 << (rand() % 16);
+        if (host.frame() < frames && rand() % 4) host.advance(keys_a);   // uneven pacing forces prediction
+        if (guest.frame() < frames && rand() % 4) guest.advance(keys_b);
+    }
+    while (host.confirmed_frame() < frames || guest.confirmed_frame() < frames) {
+        host.sync();
+        guest.sync();
+    }
+    double dt = t.getTime();
+
+    Chip8Snapshot sa, sb;
+    a.save_state(sa);
+    b.save_state(sb);
+    bool same = memcmp(&sa, &sb, sizeof(Chip8Snapshot)) == 0;
+    NetplayStats hs = host.stats(), gs = guest.stats();
+    cout << "netplay selftest: " << frames << " frames in " << dt * 1000. << " ms, "
+         << "host " << hs.rollbacks << " rollbacks / " << hs.resimulated_frames << " resimulated (max " << hs.max_rollback << "), "
+         << "guest " << gs.rollbacks << " rollbacks / " << gs.resimulated_frames << " resimulated (max " << gs.max_rollback << ") -> "
+         << (same ? "states match" : "STATES DIVERGED") << "\n";
+    return same ? 0 : 1;
+}
+
+// Runs `engine` against the reference on the given ROMs, or on random ones if there are none.
+int run_difftest(const char *engine_name, uint32_t quirks, char **roms, int rom_count) {
+    DiffEngine *engine = diff_engine_create(engine_name);
+    if (engine == nullptr) {
+        cout << "Unknown engine " << engine_name << ", available: " << diff_engine_names << "\n";
+        return 1;
+    }
+    ReferenceEngine reference;
+    DiffHarness harness(reference, *engine);
+    harness.set_quirks(quirks);
+    cerr.setstate(ios::badbit); // random programs hit unknown opcodes all the time
+
+    int failures = 0;
+    Timer t;
+    if (rom_count > 0) {
+        for (int i = 0; i < rom_count; ++i) {
+            vector<uint8_t> rom;
+            if (!read_file(roms[i], rom)) continue;
+            DiffResult r = harness.run(rom.data(), rom.size(), 60 * 60);
+            cout << roms[i] << ": ";
+            harness.report(r, cout);
+            failures += r.diverged;
+        }
+    } else {
+        const int programs = 10000;
+        uint32_t seed = 0x1234567;
+        uint8_t rom[256];
+        for (int i = 0; i < programs; ++i) {
+            diff_random_rom(seed, rom, sizeof(rom));
+            DiffResult r = harness.run(rom, sizeof(rom), DIFF_DEFAULT_FRAMES, seed);
+            if (r.diverged) {
+                cout << "random program " << i << ": ";
+                harness.report(r, cout);
+                ++failures;
+            }
+        }
+        cout << programs << " random programs (quirks: " << chip8_quirk_names(quirks) << "), " << failures << " divergent, " << t.getTime() << " s\n";
+    }
+    cerr.clear();
+    delete engine;
+    return failures ? 1 : 0;
+}
+
+// roms [dir]: every .asm with a .ch8 next to it must assemble to exactly that
+// .ch8, so a source edit without a rebuild (and a stale profiles.txt SHA-1) shows
+int run_rom_check(const char *dir) {
+    DIR *d = opendir(dir);
+    if (d == nullptr) {
+        cerr << "Could not open " << dir << "\n";
+        return 1;
+    }
+    int checked = 0, failures = 0;
+    dirent *de;
+    while ((de = readdir(d)) != nullptr) {
+        string name = de->d_name;
+        if (name.size() < 5 || name.compare(name.size() - 4, 4, ".asm") != 0) continue;
+        string source = string(dir) + "/" + name, binary = source.substr(0, source.size() - 4) + ".ch8";
+        FILE *f = fopen(binary.c_str(), "rb");
+        if (f == nullptr) continue; // not checked in
+        fclose(f);
+
+        Chip8Assembler as;
+        vector<uint8_t> rom, built;
+        if (!as.assemble_file(source.c_str(), rom)) {
+            as.print_errors(cerr, source.c_str());
+            ++failures;
+            continue;
+        }
+        read_file(binary.c_str(), built);
+        ++checked;
+        if (rom != built) {
+            cout << binary << " is stale: " << source << " assembles to " << rom.size() << " bytes, the file has " << built.size() << "\n";
+            ++failures;
+        }
+    }
+    closedir(d);
+    cout << checked << " ROMs in " << dir << " checked against their sources, " << failures << " stale\n";
+    return failures ? 1 : 0;
+}
+
+// fastcont [operations]: random operations on a FastCont and on a model of
+// it (std::map from ID to value plus the dense order), compared as they go.
+// The model spells out the semantics: remove_id moves the last element into
+// the gap, remove_index and insert keep the order, force_import overwrites
+// whatever holds the ID's slot (any generation) or appends, IDs of removed
+// elements are neither found nor handed out again, and reset() on an empty
+// container starts IDs over.
+int fastcont_selftest(uint32_t operations) {
+    const uint32_t slot_mask = (1u << FASTCONT_SLOT_BITS) - 1;
+    FastCont<uint32_t> fc;
+    map<uint32_t, uint32_t> model; // ID -> value
+    vector<uint32_t> order;        // IDs in dense order
+    vector<uint32_t> dead;         // recently removed IDs
+    uint32_t seed = 0x2545F491, value = 0;
+    auto next = [&]() {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    };
+    auto forget = [&](uint32_t id) {
+        model.erase(id);
+        dead.push_back(id);
+        if (dead.size() > 256) dead.erase(dead.begin()); // long before a generation wraps
+    };
+
+    Timer t;
+    for (uint32_t op = 0; op < operations; ++op) {
+        uint32_t r = next(), size = order.size();
+        const char *what = nullptr;
+        switch (r % 16) {
+            case 0: case 1: case 2: case 3: case 4: case 5: { // push_back
+                uint32_t id = fc.push_back(++value);
+                if (model.count(id) || find(dead.begin(), dead.end(), id) != dead.end()) what = "push_back reused an ID";
+                model[id] = value;
+                order.push_back(id);
+                break;
+            }
+            case 6: // pop_back
+                fc.pop_back();
+                if (size) {
+                    forget(order.back());
+                    order.pop_back();
+                }
+                break;
+            case 7: { // remove_index
+                uint32_t at = size ? next() % (size + 1) : 0; // sometimes out of range
+                fc.remove_index(at);
+                if (at < size) {
+                    forget(order[at]);
+                    order.erase(order.begin() + at);
+                }
+                break;
+            }
+            case 8: case 9: case 10: { // remove_id, live or stale
+                uint32_t id = size && (next() & 3) ? order[next() % size] : (dead.empty() ? 0 : dead[next() % dead.size()]);
+                fc.remove_id(id);
+                if (model.count(id)) {
+                    size_t at = find(order.begin(), order.end(), id) - order.begin();
+                    order[at] = order.back();
+                    order.pop_back();
+                    forget(id);
+                }
+                break;
+            }
+            case 11: { // insert
+                uint32_t at = next() % (size + 2); // size + 1 is out of range
+                fc.insert(++value, at);
+                if (at <= size) {
+                    uint32_t id = fc.get_id_at_index(at);
+                    if (model.count(id) || find(dead.begin(), dead.end(), id) != dead.end()) what = "insert reused an ID";
+                    model[id] = value;
+                    order.insert(order.begin() + at, id);
+                }
+                break;
+            }
+            case 12: { // force_import: a live ID, a removed one, or one on a fresh slot
+                uint32_t id, kind = next() % 3;
+                if (kind == 0 && size) id = order[next() % size];
+                else if (kind == 1 && !dead.empty()) id = dead[next() % dead.size()];
+                else id = (next() % 4) << FASTCONT_SLOT_BITS | (next() % 4096);
+                fc.force_import(id, ++value);
+                auto same_slot = [&](uint32_t o) { return (o & slot_mask) == (id & slot_mask); };
+                dead.erase(remove_if(dead.begin(), dead.end(), same_slot), dead.end()); // the slot's generation is the importer's now
+                auto it = find_if(order.begin(), order.end(), same_slot);
+                if (it != order.end()) {
+                    model.erase(*it);
+                    *it = id;
+                } else {
+                    order.push_back(id);
+                }
+                model[id] = value;
+                break;
+            }
+            case 13: // stale and live lookups
+                for (uint32_t id : dead)
+                    if ((fc.at_id(id) != nullptr) != (model.count(id) != 0)) what = "at_id found a removed ID";
+                break;
+            case 14: // reset
+                if (next() % 8 == 0) {
+                    fc.reset();
+                    if (size == 0) dead.clear(); // old IDs come back
+                }
+                break;
+            case 15: // clear, rarely, so the container also gets big
+                if (next() % 64 == 0) {
+                    fc.clear();
+                    for (uint32_t id : order)
+                        forget(id);
+                    order.clear();
+                }
+                break;
+        }
+
+        if (what == nullptr && fc.size() != order.size()) what = "size differs";
+        if (what == nullptr && (op % 64 == 0 || op + 1 == operations)) {
+            for (uint32_t i = 0; i < order.size() && what == nullptr; ++i) {
+                uint32_t id = order[i], *at = fc.at_id(id);
+                if (fc.get_id_at_index(i) != id) what = "ID at index differs";
+                else if (*fc.at_index(i) != model[id]) what = "value at index differs";
+                else if (at == nullptr || *at != model[id]) what = "at_id differs";
+            }
+        }
+        if (what != nullptr) {
+            cout << "fastcont selftest: operation " << op << " (" << r % 16 << "): " << what << "\n";
+            return 1;
+        }
+    }
+    cout << "fastcont selftest: " << operations << " operations, " << order.size() << " elements at the end, " << t.getTime() << " s -> model matches\n";
+    return 0;
+}
+
+// conformance file.asm: assembles, runs headless until the program spins on
+// a self-jump, and checks that it spins at `pass`; VE holds the failed test.
+// The mask goes to the core and into the ROM's `quirks` byte, if it has one.
+int run_conformance(const char *path, uint32_t quirks) {
+    Chip8Assembler as;
+    vector<uint8_t> rom;
+    int pass, quirks_at;
+    if (!as.assemble_file(path, rom)) {
+        as.print_errors(cerr, path);
+        return 1;
+    }
+    if (!as.symbol("pass", pass)) {
+        cerr << path << " needs a `pass` label\n";
+        return 1;
+    }
+    if (as.symbol("quirks", quirks_at)) rom[quirks_at - CHIP8_PC_OFFSET] = quirks;
+    else if (quirks != 0) {
+        cerr << path << " needs a `quirks` byte to run with quirks\n";
+        return 1;
+    }
+    Chip8 chip8;
+    chip8.set_quirks(quirks);
+    chip8.load_rom(rom.data(), rom.size());
+    chip8.start_execution();
+    Chip8Snapshot *s = new Chip8Snapshot;
+    int frames = 0;
+    for (; frames < 60 * 10; ++frames) {
+        chip8.run_frame();
+        chip8.save_state(*s);
+        uint16_t op = chip8.memory()[s->PC] << 8 | chip8.memory()[s->PC + 1];
+        if (op == (0x1000 | s->PC) || !chip8.is_running()) break;
+    }
+    int code = 1;
+    cout << path << " (quirks: " << chip8_quirk_names(quirks) << "): ";
+    if (s->PC == pass) {
+        cout << "pass after " << frames + 1 << " frames\n";
+        code = 0;
+    } else if (frames < 60 * 10 && chip8.is_running())
+        cout << "test " << (int)s->V[0xE] << " failed\n";
+    else
+        cout << "stuck at 0x" << hex << s->PC << dec << "\n";
+    delete s;
+    return code;
+}
+
+// every quirk combination
+int run_conformance_all(const char *path) {
+    int failed = 0;
+    for (uint32_t q = 0; q <= CHIP8_QUIRK_ALL; ++q)
+        failed += run_conformance(path, q);
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *what = argc > 1 ? argv[1] : "";
+    if (strcmp(what, "netplay") == 0) return netplay_selftest();
+    uint32_t quirks = 0;
+    if (strcmp(what, "difftest") == 0 && argc > 2) {
+        int first = 3;
+        if (argc > 4 && strcmp(argv[3], "--quirks") == 0) {
+            if (!chip8_parse_quirks(argv[4], quirks)) {
+                cerr << "--quirks: expected none or a list of " << chip8_quirk_names(CHIP8_QUIRK_ALL) << "\n";
+                return 1;
+            }
+            first = 5;
+        }
+        return run_difftest(argv[2], quirks, argv + first, argc - first);
+    }
+    if (strcmp(what, "roms") == 0) return run_rom_check(argc > 2 ? argv[2] : "roms");
+    if (strcmp(what, "fastcont") == 0) return fastcont_selftest(argc > 2 ? strtoul(argv[2], nullptr, 10) : 200000);
+    if (strcmp(what, "conformance") == 0 && argc == 3) return run_conformance_all(argv[2]);
+    if (strcmp(what, "conformance") == 0 && argc == 4 && chip8_parse_quirks(argv[3], quirks)) return run_conformance(argv[2], quirks);
+    if (argc > 1) {
+        cerr << "usage: " << argv[0] << " [netplay | difftest engine [--quirks list] [roms...] | conformance file.asm [quirks] | roms [dir] | fastcont [operations]]\n";
+        return 1;
+    }
+
+    int failed = 0;
+    failed += netplay_selftest();
+    failed += run_difftest("debugger", 0, nullptr, 0);
+    failed += run_difftest("fork", 0, nullptr, 0);
+    failed += run_difftest("debugger", CHIP8_QUIRK_ALL, nullptr, 0);
+    failed += run_difftest("fork", CHIP8_QUIRK_ALL, nullptr, 0);
+    failed += run_conformance_all("roms/conformance.asm");
+    failed += run_rom_check("roms");
+    failed += fastcont_selftest(200000);
+    cout << (failed ? "SELFTEST FAILED\n" : "selftest passed\n");
+    return failed ? 1 : 0;
+}